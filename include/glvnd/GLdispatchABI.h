@@ -106,6 +106,38 @@ enum {
     __GLDISPATCH_STUB_LOONGARCH64,
 };
 
+/*!
+ * How the dispatch stubs find the current dispatch table.
+ *
+ * Unlike the stub type, this doesn't affect entrypoint rewriting. It's only
+ * reported by libGLdispatch for diagnostics.
+ */
+enum {
+    /*!
+     * The stubs are written in C.
+     */
+    __GLDISPATCH_STUB_MODE_C,
+
+    /*!
+     * The stubs call into libGLdispatch to look up the thread's dispatch
+     * table, using thread-specific data.
+     */
+    __GLDISPATCH_STUB_MODE_TSD,
+
+    /*!
+     * The stubs read the dispatch table from a TLS variable in the static TLS
+     * block (the initial-exec model).
+     */
+    __GLDISPATCH_STUB_MODE_TLS,
+
+    /*!
+     * The stubs find the TLS variable through a TLS descriptor, which also
+     * works if the library was loaded after startup and didn't get space in
+     * the static TLS block.
+     */
+    __GLDISPATCH_STUB_MODE_TLSDESC,
+};
+
 /*!
  * A callback function called by the vendor library to fetch the address of an
  * entrypoint.
@@ -82,7 +82,7 @@ extern "C" {
  * will still work.
  */
 #define EGL_VENDOR_ABI_MAJOR_VERSION ((uint32_t) 0)
-#define EGL_VENDOR_ABI_MINOR_VERSION ((uint32_t) 2)
+#define EGL_VENDOR_ABI_MINOR_VERSION ((uint32_t) 6)
 #define EGL_VENDOR_ABI_VERSION ((EGL_VENDOR_ABI_MAJOR_VERSION << 16) | EGL_VENDOR_ABI_MINOR_VERSION)
 static inline uint32_t EGL_VENDOR_ABI_GET_MAJOR_VERSION(uint32_t version)
 {
@@ -388,6 +388,10 @@ typedef struct __EGLapiImportsRec {
      * This function is optional. If it's \c NULL, then libGLdispatch will
      * simply ignore it.
      *
+     * libGLdispatch calls this at most once on each thread while the vendor
+     * library owns the entrypoints: the first time that thread calls a
+     * window-system function after the vendor library patched them.
+     *
      * \note This function may be called concurrently from multiple threads.
      */
     void (*patchThreadAttach)(void);
@@ -416,6 +420,92 @@ typedef struct __EGLapiImportsRec {
      * \return Either a platform type enum or EGL_NONE.
      */
     EGLenum (* findNativeDisplayPlatform) (void *native_display);
+
+    /*!
+     * (OPTIONAL) Looks up a range of core GL functions in a single call.
+     *
+     * If the vendor library provides this function, then libglvnd will call
+     * it instead of calling \c getProcAddress for each function when it fills
+     * in the vendor's GL dispatch table.
+     *
+     * Both \p procNames and \p procs are indexed by dispatch table slot. The
+     * vendor library must fill in \c procs[first] through
+     * \c procs[first+count-1], storing NULL for any function that it doesn't
+     * support. Each entry must be the same as what \c getProcAddress would
+     * return for that name.
+     *
+     * The \p procNames array stays the same for as long as libglvnd is loaded,
+     * and existing entries never change, so the vendor library can compare
+     * the pointer against a previous call and copy cached results.
+     *
+     * This was added in version 0.3 of the ABI.
+     *
+     * \param procNames The name of each dispatch table slot.
+     * \param first The first slot to fill in.
+     * \param count The number of slots to fill in.
+     * \param[out] procs Receives the function for each slot.
+     * \return EGL_TRUE if the vendor library filled in \p procs, or
+     * EGL_FALSE to make libglvnd call \c getProcAddress instead.
+     */
+    EGLBoolean (* getProcAddresses) (const char * const *procNames,
+                                     int first, int count, void **procs);
+
+    /*!
+     * (OPTIONAL) Called instead of \c initiatePatch when libglvnd switches
+     * back to entrypoints that this vendor library patched earlier.
+     *
+     * If the vendor library provides this function, then libglvnd keeps a
+     * copy of the patched entrypoints after calling \c releasePatch, so that
+     * making a context from the same vendor current again doesn't have to
+     * patch anything. In that case, the vendor library must keep everything
+     * that its patched entrypoints depend on until it's unloaded.
+     *
+     * If this is NULL, then libglvnd calls \c initiatePatch every time.
+     *
+     * This was added in version 0.4 of the ABI.
+     */
+    void (* reusePatch) (void);
+
+    /*!
+     * (OPTIONAL) Set this to EGL_TRUE if the vendor library's GL functions
+     * don't depend on which of its contexts is current.
+     *
+     * That is, every function that \c getProcAddress returns must work for
+     * any of the vendor's contexts.
+     *
+     * If the vendor library sets this but doesn't provide \c initiatePatch,
+     * then libglvnd can patch the entrypoints itself to jump straight to
+     * those functions, skipping the dispatch table. Unlike entrypoints that
+     * a vendor patches itself, they're restored once no thread has a current
+     * context, so a thread without a current context normally won't call
+     * the vendor's functions. While another thread still has one of the
+     * vendor's contexts current, though, the entrypoints stay patched for
+     * every thread, just as they would with \c initiatePatch.
+     *
+     * This was added in version 0.5 of the ABI.
+     */
+    EGLBoolean contextIndependentDispatch;
+
+    /*!
+     * (OPTIONAL) Called instead of \c initiatePatch to patch the entrypoints
+     * while other threads already have current contexts from this vendor
+     * library.
+     *
+     * The parameters are the same as \c initiatePatch. The vendor library's
+     * writes go into a copy of the entrypoints, and libglvnd switches each
+     * patched entrypoint over to the new code atomically after this returns.
+     * The other threads can start running the patched entrypoints at any
+     * point after that without calling \c patchThreadAttach first, so the
+     * patched code must not depend on any per-thread setup.
+     *
+     * If this is NULL, then libglvnd only patches the entrypoints when no
+     * other thread has a current context.
+     *
+     * This was added in version 0.6 of the ABI.
+     */
+    GLboolean (*initiatePatchConcurrent)(int type,
+                                         int stubSize,
+                                         DispatchPatchLookupStubOffset lookupStubOffset);
 } __EGLapiImports;
 
 /*****************************************************************************/
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#if !defined(__LIB_GL_LAYER_ABI_H)
+#define __LIB_GL_LAYER_ABI_H
+
+#include <stdint.h>
+#include <GL/gl.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*!
+ * \defgroup gllayerabi GL dispatch layer ABI
+ *
+ * A layer is a library that libGLdispatch loads between the application and
+ * the vendor library. A layer can provide its own function for any GL
+ * function, and it passes calls on by calling the same slot in the table for
+ * the next layer down.
+ *
+ * Layers are listed in JSON manifest files, using the same format as the EGL
+ * vendor files, but with a "layer" object instead of an "ICD" object:
+ *
+ * \code
+ * {
+ *     "file_format_version" : "1.0.0",
+ *     "layer" : {
+ *         "library_path" : "libMyGLLayer.so"
+ *     }
+ * }
+ * \endcode
+ *
+ * libGLdispatch reads the manifests named by the __GLVND_LAYER_FILENAMES
+ * environment variable, or else every manifest in the directories named by
+ * __GLVND_LAYER_DIRS, sorted by filename. Both are colon-separated lists, and
+ * the first layer is the closest to the application.
+ *
+ * The chain of layers is built once for each vendor's dispatch table, and
+ * made current along with that table, so any layer's functions are called
+ * directly from the dispatch stubs. While any layers are loaded,
+ * libGLdispatch won't let vendor libraries patch the entrypoints.
+ *
+ * @{
+ */
+
+/*!
+ * Current version of the ABI.
+ *
+ * This version number contains a major number in the high-order 16 bits, and
+ * a minor version number in the low-order 16 bits.
+ */
+#define GL_LAYER_ABI_MAJOR_VERSION ((uint32_t) 0)
+#define GL_LAYER_ABI_MINOR_VERSION ((uint32_t) 0)
+#define GL_LAYER_ABI_VERSION ((GL_LAYER_ABI_MAJOR_VERSION << 16) | GL_LAYER_ABI_MINOR_VERSION)
+static inline uint32_t GL_LAYER_ABI_GET_MAJOR_VERSION(uint32_t version)
+{
+    return version >> 16;
+}
+static inline uint32_t GL_LAYER_ABI_GET_MINOR_VERSION(uint32_t version)
+{
+    return version & 0xFFFF;
+}
+
+/*!
+ * The functions that a layer provides to libGLdispatch.
+ */
+typedef struct __GLlayerImportsRec {
+    /*!
+     * Returns the layer's function for a GL function, or NULL to pass calls
+     * straight through to the next layer.
+     *
+     * This is called once for each dispatch table slot of each vendor's
+     * dispatch table. The slot number never changes for a given function
+     * name, so the layer can save it and use it to index the table from
+     * \c setNextTable.
+     *
+     * \param procName The name of the function.
+     * \param slot The dispatch table slot for the function.
+     * \param param The value of \c param in this struct.
+     */
+    void * (* getProcAddress) (const char *procName, int slot, void *param);
+
+    /*!
+     * Tells the layer which table to call through in the current thread.
+     *
+     * This is called whenever a context is made current, before any calls
+     * can reach the layer. The layer would typically store the table in a
+     * thread-local variable. The table is valid until the next call to
+     * \c setNextTable in the same thread.
+     *
+     * \param next The dispatch table for the next layer down, indexed by the
+     *      slot numbers from \c getProcAddress.
+     * \param param The value of \c param in this struct.
+     */
+    void (* setNextTable) (void * const *next, void *param);
+
+    /*!
+     * Called before the layer is unloaded. This is optional.
+     */
+    void (* teardown) (void *param);
+
+    /*!
+     * A pointer that's passed to each of the callbacks above.
+     */
+    void *param;
+} __GLlayerImports;
+
+#define __GL_LAYER_MAIN_PROTO_NAME "__gl_layer_Main"
+
+typedef GLboolean (* __PFNGLLAYERMAINPROC) (uint32_t version,
+        __GLlayerImports *imports);
+
+/*!
+ * Layer libraries must export a function called __gl_layer_Main() with the
+ * following prototype.
+ *
+ * \param[in] version The ABI version. The upper 16 bits contains the major
+ * version number, and the lower 16 bits contains the minor version number.
+ *
+ * \param[out] imports The function table that the layer should fill in. The
+ * layer must assign \c getProcAddress and \c setNextTable.
+ *
+ * \return True on success. If the layer does not support the requested ABI
+ * version or if some other error occurs, then it should return False.
+ */
+GLboolean __gl_layer_Main(uint32_t version, __GLlayerImports *imports);
+
+/*!
+ * @}
+ */
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* __LIB_GL_LAYER_ABI_H */
@@ -1151,6 +1151,27 @@ static __eglMustCastToProperFunctionPointerType GetCachedProcAddress(const char
     return NULL;
 }
 
+/*
+ * Checks whether any vendor library supports a GL function.
+ *
+ * All of the vendor libraries are loaded up front, so if none of them
+ * supports a function, then it's safe to return NULL from eglGetProcAddress
+ * instead of using up a dispatch stub for it.
+ */
+static void *ProbeGLFunction(const char *procName, void *param)
+{
+    struct glvnd_list *vendorList = __eglLoadVendors();
+    __EGLvendorInfo *vendor;
+
+    glvnd_list_for_each_entry(vendor, vendorList, entry) {
+        void *addr = vendor->eglvc.getProcAddress(procName);
+        if (addr != NULL) {
+            return addr;
+        }
+    }
+    return NULL;
+}
+
 PUBLIC __eglMustCastToProperFunctionPointerType EGLAPIENTRY eglGetProcAddress(const char *procName)
 {
     __eglMustCastToProperFunctionPointerType addr = NULL;
@@ -1174,7 +1195,7 @@ PUBLIC __eglMustCastToProperFunctionPointerType EGLAPIENTRY eglGetProcAddress(co
     if (procName[0] == 'e' && procName[1] == 'g' && procName[2] == 'l') {
         addr = __eglGetEGLDispatchAddress(procName);
     } else if (procName[0] == 'g' && procName[1] == 'l') {
-        addr = __glDispatchGetProcAddress(procName);
+        addr = __glDispatchProbeProcAddress(procName, ProbeGLFunction, NULL);
     } else {
         addr = NULL;
     }
@@ -1263,6 +1284,16 @@ int AtomicDecrementClampAtZero(int volatile *val)
 
 static void __eglResetOnFork(void);
 
+/*
+ * The fork generation (see glvndGetForkGeneration) that we last recovered
+ * from, and the one that a thread last started recovering from. The first is
+ * only updated once recovery is finished, so the common case in CheckFork is
+ * a single load and compare.
+ */
+static int volatile forkGenerationChecked;
+static int volatile forkGenerationSeen;
+static int volatile threadsInForkCheck;
+
 /*
  * Perform checks that need to occur when entering any EGL entrypoint.
  * Currently, this only detects whether a fork occurred since the last
@@ -1270,33 +1301,35 @@ static void __eglResetOnFork(void);
  */
 void CheckFork(void)
 {
-    volatile static int g_threadsInCheck = 0;
-    volatile static int g_lastPid = -1;
+    int gen = glvndGetForkGeneration();
+    int lastGen;
 
-    int lastPid;
-    int pid = getpid();
+    if (gen == forkGenerationChecked) {
+        return;
+    }
 
-    AtomicIncrement(&g_threadsInCheck);
+    AtomicIncrement(&threadsInForkCheck);
 
-    lastPid = AtomicSwap(&g_lastPid, pid);
+    lastGen = AtomicSwap(&forkGenerationSeen, gen);
 
-    if ((lastPid != -1) &&
-        (lastPid != pid)) {
+    if (lastGen != gen) {
 
         DBG_PRINTF(0, "Fork detected\n");
 
         __eglResetOnFork();
 
-        // Force g_threadsInCheck to 0 to unblock other threads waiting here.
-        g_threadsInCheck = 0;
+        forkGenerationChecked = gen;
+
+        // Force threadsInForkCheck to 0 to unblock other threads waiting here.
+        threadsInForkCheck = 0;
     } else {
-        AtomicDecrementClampAtZero(&g_threadsInCheck);
-        while (g_threadsInCheck > 0) {
+        AtomicDecrementClampAtZero(&threadsInForkCheck);
+        while (threadsInForkCheck > 0) {
             // Wait for other threads to finish checking for a fork.
             //
-            // If a fork happens while g_threadsInCheck > 0 the _first_ thread
+            // If a fork happens while threadsInForkCheck > 0 the _first_ thread
             // to enter __eglThreadInitialize() will see the fork, handle it, and force
-            // g_threadsInCheck to 0, unblocking any other threads stuck here.
+            // threadsInForkCheck to 0, unblocking any other threads stuck here.
             sched_yield();
         }
     }
@@ -1361,7 +1394,8 @@ void _init(void)
     __eglCurrentInit();
     __eglInitVendors();
 
-    /* TODO install fork handlers using __register_atfork */
+    glvndSetupForkHandler();
+    forkGenerationChecked = forkGenerationSeen = glvndGetForkGeneration();
 
     DBG_PRINTF(0, "Loading EGL...\n");
 
@@ -8,6 +8,7 @@ static void OnThreadDestroyed(void *data);
 
 static __EGLThreadAPIState *CreateThreadState(void);
 static void DestroyThreadState(__EGLThreadAPIState *threadState);
+static void SetCurrentThreadState(__EGLThreadAPIState *threadState);
 
 /**
  * A list of current __EGLdispatchThreadState structures. This is used so that we can
@@ -18,6 +19,21 @@ static struct glvnd_list currentThreadStateList;
 static glvnd_mutex_t currentStateListMutex = PTHREAD_MUTEX_INITIALIZER;
 static glvnd_key_t threadStateKey;
 
+#if defined(GLDISPATCH_USE_TLS)
+/**
+ * A copy of the current thread's value for threadStateKey, so that
+ * __eglGetCurrentThreadAPIState doesn't need to call pthread_getspecific.
+ *
+ * The pthread key still holds the same pointer, so that OnThreadDestroyed
+ * gets called when the thread exits.
+ */
+static __thread __EGLThreadAPIState *currentThreadState
+#if (defined(__GLIBC__) || defined(__FreeBSD__)) && !defined(GLDISPATCH_RUNTIME_STUBS)
+    __attribute__((tls_model("initial-exec")))
+#endif
+    ;
+#endif
+
 EGLenum __eglQueryAPI(void)
 {
     __EGLThreadAPIState *state = __eglGetCurrentThreadAPIState(EGL_FALSE);
@@ -91,7 +107,7 @@ void __eglCurrentTeardown(EGLBoolean doReset)
         __eglDestroyAPIState(apiState);
     }
 
-    __glvndPthreadFuncs.setspecific(threadStateKey, NULL);
+    SetCurrentThreadState(NULL);
     while (!glvnd_list_is_empty(&currentThreadStateList)) {
         __EGLThreadAPIState *threadState = glvnd_list_first_entry(
                 &currentThreadStateList, __EGLThreadAPIState, entry);
@@ -123,13 +139,25 @@ __EGLThreadAPIState *CreateThreadState(void)
     glvnd_list_add(&threadState->entry, &currentThreadStateList);
     __glvndPthreadFuncs.mutex_unlock(&currentStateListMutex);
 
-    __glvndPthreadFuncs.setspecific(threadStateKey, threadState);
+    SetCurrentThreadState(threadState);
     return threadState;
 }
 
+void SetCurrentThreadState(__EGLThreadAPIState *threadState)
+{
+#if defined(GLDISPATCH_USE_TLS)
+    currentThreadState = threadState;
+#endif
+    __glvndPthreadFuncs.setspecific(threadStateKey, threadState);
+}
+
 __EGLThreadAPIState *__eglGetCurrentThreadAPIState(EGLBoolean create)
 {
+#if defined(GLDISPATCH_USE_TLS)
+    __EGLThreadAPIState *threadState = currentThreadState;
+#else
     __EGLThreadAPIState *threadState = (__EGLThreadAPIState *) __glvndPthreadFuncs.getspecific(threadStateKey);
+#endif
     if (threadState == NULL && create) {
         threadState = CreateThreadState();
     }
@@ -149,9 +177,9 @@ void DestroyThreadState(__EGLThreadAPIState *threadState)
 
 void __eglDestroyCurrentThreadAPIState(void)
 {
-    __EGLThreadAPIState *threadState = __glvndPthreadFuncs.getspecific(threadStateKey);
+    __EGLThreadAPIState *threadState = __eglGetCurrentThreadAPIState(EGL_FALSE);
     if (threadState != NULL) {
-        __glvndPthreadFuncs.setspecific(threadStateKey, NULL);
+        SetCurrentThreadState(NULL);
         DestroyThreadState(threadState);
     }
 }
@@ -159,6 +187,9 @@ void __eglDestroyCurrentThreadAPIState(void)
 void OnThreadDestroyed(void *data)
 {
     __EGLThreadAPIState *threadState = (__EGLThreadAPIState *) data;
+#if defined(GLDISPATCH_USE_TLS)
+    currentThreadState = NULL;
+#endif
     DestroyThreadState(threadState);
 }
 
@@ -2,20 +2,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <dlfcn.h>
 #include <string.h>
 #include <unistd.h>
-#include <fnmatch.h>
-#include <dirent.h>
 
 #include "glvnd_pthread.h"
 #include "libeglcurrent.h"
 #include "libeglmapping.h"
 #include "utils_misc.h"
 #include "glvnd_list.h"
-#include "cJSON.h"
+#include "config_files.h"
 #include "egldispatchstubs.h"
 
 #define FILE_FORMAT_VERSION_MAJOR 1
@@ -25,9 +21,7 @@ static void LoadVendors(void);
 static void TeardownVendor(__EGLvendorInfo *vendor);
 static __EGLvendorInfo *LoadVendor(const char *filename, const char *jsonPath);
 
-static void LoadVendorsFromConfigDir(const char *dirName);
-static __EGLvendorInfo *LoadVendorFromConfigFile(const char *filename);
-static cJSON *ReadJSONFile(const char *filename);
+static void LoadVendorFromConfigFile(const char *filename);
 
 static glvnd_once_t loadVendorsOnceControl = GLVND_ONCE_INIT;
 static struct glvnd_list __eglVendorList;
@@ -65,70 +59,12 @@ void LoadVendors(void)
     tokens = SplitString(env, NULL, ":");
     if (tokens != NULL) {
         for (i=0; tokens[i] != NULL; i++) {
-            LoadVendorsFromConfigDir(tokens[i]);
+            ForEachConfigFile(tokens[i], LoadVendorFromConfigFile);
         }
         free(tokens);
     }
 }
 
-static int ScandirFilter(const struct dirent *ent)
-{
-#if defined(HAVE_DIRENT_DTYPE)
-    // Ignore the entry if we know that it's not a regular file or symlink.
-    if (ent->d_type != DT_REG && ent->d_type != DT_LNK && ent->d_type != DT_UNKNOWN) {
-        return 0;
-    }
-#endif
-
-    // Otherwise, select any JSON files.
-    if (fnmatch("*.json", ent->d_name, 0) == 0) {
-        return 1;
-    } else {
-        return 0;
-    }
-}
-
-static int CompareFilenames(const struct dirent **ent1, const struct dirent **ent2)
-{
-    return strcmp((*ent1)->d_name, (*ent2)->d_name);
-}
-
-void LoadVendorsFromConfigDir(const char *dirName)
-{
-    struct dirent **entries = NULL;
-    size_t dirnameLen;
-    const char *pathSep;
-    int count;
-    int i;
-
-    count = scandir(dirName, &entries, ScandirFilter, CompareFilenames);
-    if (count <= 0) {
-        return;
-    }
-
-    // Check if dirName ends with a "/" character. If it doesn't, then we need
-    // to add one when we construct the full file paths below.
-    dirnameLen = strlen(dirName);
-    if (dirnameLen > 0 && dirName[dirnameLen - 1] != '/') {
-        pathSep = "/";
-    } else {
-        pathSep = "";
-    }
-
-    for (i=0; i<count; i++) {
-        char *path = NULL;
-        if (glvnd_asprintf(&path, "%s%s%s", dirName, pathSep, entries[i]->d_name) > 0) {
-            LoadVendorFromConfigFile(path);
-            free(path);
-        } else {
-            fprintf(stderr, "ERROR: Could not allocate vendor library path name\n");
-        }
-        free(entries[i]);
-    }
-
-    free(entries);
-}
-
 void __eglInitVendors(void)
 {
     glvnd_list_init(&__eglVendorList);
@@ -270,37 +206,18 @@ static void *VendorGetProcAddressCallback(const char *procName, void *param)
     return vendor->eglvc.getProcAddress(procName);
 }
 
-static EGLBoolean CheckFormatVersion(const char *versionStr)
+static GLboolean VendorGetProcAddressesCallback(const char * const *procNames,
+        int first, int count, void **procs, void *param)
 {
-    int major, minor, rev;
-    int len;
-
-    major = minor = rev = -1;
-    len = sscanf(versionStr, "%d.%d.%d", &major, &minor, &rev);
-    if (len < 1) {
-        return EGL_FALSE;
-    }
-    if (len < 2) {
-        minor = 0;
-    }
-    if (len < 3) {
-        rev = 0;
-    }
-    if (major != FILE_FORMAT_VERSION_MAJOR) {
-        return EGL_FALSE;
-    }
-
-    // The minor version number will be incremented if we ever add an optional
-    // value to the JSON format that libEGL has to pay attention to. That is,
-    // an older vendor library will still work, but a vendor library with a
-    // newer format than this library understands should fail.
-    if (minor > FILE_FORMAT_VERSION_MINOR) {
-        return EGL_FALSE;
+    __EGLvendorInfo *vendor = (__EGLvendorInfo *) param;
+    if (vendor->eglvc.getProcAddresses != NULL) {
+        return !!vendor->eglvc.getProcAddresses(procNames, first, count, procs);
+    } else {
+        return GL_FALSE;
     }
-    return EGL_TRUE;
 }
 
-static __EGLvendorInfo *LoadVendorFromConfigFile(const char *filename)
+static void LoadVendorFromConfigFile(const char *filename)
 {
     __EGLvendorInfo *vendor = NULL;
     cJSON *root;
@@ -317,7 +234,8 @@ static __EGLvendorInfo *LoadVendorFromConfigFile(const char *filename)
     if (node == NULL || node->type != cJSON_String) {
         goto done;
     }
-    if (!CheckFormatVersion(node->valuestring)) {
+    if (!CheckConfigFormatVersion(node->valuestring,
+                FILE_FORMAT_VERSION_MAJOR, FILE_FORMAT_VERSION_MINOR)) {
         goto done;
     }
 
@@ -340,45 +258,6 @@ done:
     if (vendor != NULL) {
         glvnd_list_append(&vendor->entry, &__eglVendorList);
     }
-    return vendor;
-}
-
-static cJSON *ReadJSONFile(const char *filename)
-{
-    FILE *in = NULL;
-    char *buf = NULL;
-    cJSON *root = NULL;
-    struct stat st;
-
-    in = fopen(filename, "r");
-    if (in == NULL) {
-        goto done;
-    }
-
-    if (fstat(fileno(in), &st) != 0) {
-        goto done;
-    }
-
-    buf = (char *) malloc(st.st_size + 1);
-    if (buf == NULL) {
-        goto done;
-    }
-
-    if (fread(buf, st.st_size, 1, in) != 1) {
-        goto done;
-    }
-    buf[st.st_size] = '\0';
-
-    root = cJSON_Parse(buf);
-
-done:
-    if (in != NULL) {
-        fclose(in);
-    }
-    if (buf != NULL) {
-        free(buf);
-    }
-    return root;
 }
 
 static void CheckVendorExtensionString(__EGLvendorInfo *vendor, const char *str)
@@ -556,6 +435,14 @@ static __EGLvendorInfo *LoadVendor(const char *filename, const char *jsonPath)
         vendor->patchCallbacks.initiatePatch = vendor->eglvc.initiatePatch;
         vendor->patchCallbacks.releasePatch = vendor->eglvc.releasePatch;
         vendor->patchCallbacks.threadAttach = vendor->eglvc.patchThreadAttach;
+        vendor->patchCallbacks.reusePatch = vendor->eglvc.reusePatch;
+        vendor->patchCallbacks.initiatePatchConcurrent = vendor->eglvc.initiatePatchConcurrent;
+        vendor->patchSupported = EGL_TRUE;
+    } else if (vendor->eglvc.contextIndependentDispatch) {
+        // Let libGLdispatch patch the entrypoints itself. Each vendor still
+        // gets its own copy of the callbacks, since libGLdispatch tells
+        // vendors apart by the pointer.
+        vendor->patchCallbacks = *__glDispatchGetDirectPatchCallbacks();
         vendor->patchSupported = EGL_TRUE;
     }
 
@@ -573,7 +460,8 @@ static __EGLvendorInfo *LoadVendor(const char *filename, const char *jsonPath)
     assert(vendor->vendorID >= 0);
 
     // TODO: Allow per-context dispatch tables?
-    vendor->glDispatch = __glDispatchCreateTable(VendorGetProcAddressCallback, vendor);
+    vendor->glDispatch = __glDispatchCreateTableBulk(VendorGetProcAddressCallback,
+            VendorGetProcAddressesCallback, vendor);
     if (!vendor->glDispatch) {
         goto fail;
     }
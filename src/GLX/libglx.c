@@ -35,6 +35,7 @@
 #include "libglxabipriv.h"
 #include "libglxmapping.h"
 #include "libglxcurrent.h"
+#include "libglxcontextmap.h"
 #include "utils_misc.h"
 #include "trace.h"
 #include "GL/glxproto.h"
@@ -70,6 +71,11 @@ static glvnd_mutex_t clientStringLock = GLVND_MUTEX_INITIALIZER;
 struct __GLXcontextInfoRec {
     GLXContext context;
     __GLXvendorInfo *vendor;
+
+    /**
+     * The number of threads that have this context current, plus any
+     * references from a glXMakeCurrent call that's still in progress.
+     */
     int currentCount;
     Bool deleted;
     UT_hash_handle hh;
@@ -90,6 +96,10 @@ static __GLXcontextInfo *glxContextHash = NULL;
  * the life of the structure. Thus, it's safe to access them for the current
  * thread's current context without having to take the \c glxContextHashLock
  * mutex.
+ *
+ * This mutex is never held while calling into a vendor library. Instead,
+ * glXMakeCurrent adds a reference to a context before it calls into the
+ * vendor, so that the __GLXcontextInfo struct stays valid without the lock.
  */
 static glvnd_mutex_t glxContextHashLock;
 
@@ -109,8 +119,11 @@ static void DestroyThreadState(__GLXThreadState *threadState);
  * If the old context was flagged for deletion and is no longer current to any
  * thread, then it will also remove the context from the context hashtable.
  *
- * \note glxContextHashLock must be locked before calling this
- * function.
+ * This takes the \c glxContextHashLock mutex, so the caller must not call
+ * it while holding that mutex.
+ *
+ * This is also used to add or remove the temporary references from
+ * \c AcquireContextInfo.
  *
  * \param[in] newCtxInfo The new context to make current, or \c NULL to just
  * release the current context.
@@ -119,6 +132,19 @@ static void DestroyThreadState(__GLXThreadState *threadState);
  */
 static void UpdateCurrentContext(__GLXcontextInfo *newCtxInfo, __GLXcontextInfo *oldCtxInfo);
 
+/**
+ * Looks up a context and adds a reference to it.
+ *
+ * The reference keeps the __GLXcontextInfo struct valid without holding the
+ * \c glxContextHashLock mutex, even if another thread calls
+ * glXDestroyContext. The caller must release it with
+ * \c UpdateCurrentContext(NULL, ctxInfo).
+ *
+ * \param context The context to look up.
+ * \return The context info, or NULL if \p context isn't a valid context.
+ */
+static __GLXcontextInfo *AcquireContextInfo(GLXContext context);
+
 /**
  * Removes and frees an entry from the glxContextHash table.
  *
@@ -624,9 +650,7 @@ void __glXDisplayClosed(__GLXdisplayInfo *dpyInfo)
         // Clear out the current context, but don't call into the vendor
         // library or do anything that might require a valid display.
         __glDispatchLoseCurrent();
-        __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
         UpdateCurrentContext(NULL, threadState->currentContext);
-        __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
         DestroyThreadState(threadState);
     }
 
@@ -647,9 +671,7 @@ static void ThreadDestroyed(__GLdispatchThreadState *threadState)
     __GLXThreadState *glxState = (__GLXThreadState *) threadState;
 
     // Clear out the current context.
-    __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
     UpdateCurrentContext(NULL, glxState->currentContext);
-    __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
 
     // Free the thread state struct.
     DestroyThreadState(glxState);
@@ -717,6 +739,13 @@ int __glXAddVendorContextMapping(Display *dpy, GLXContext context, __GLXvendorIn
         ctxInfo->vendor = vendor;
         ctxInfo->currentCount = 0;
         ctxInfo->deleted = False;
+#if GLX_USE_CONTEXT_MAP
+        if (__glXContextMapAdd(context, vendor) != 0) {
+            free(ctxInfo);
+            __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
+            return -1;
+        }
+#endif
         HASH_ADD_PTR(glxContextHash, context, ctxInfo);
     } else {
         if (ctxInfo->vendor != vendor) {
@@ -731,6 +760,9 @@ int __glXAddVendorContextMapping(Display *dpy, GLXContext context, __GLXvendorIn
 
 __GLXvendorInfo *__glXVendorFromContext(GLXContext context)
 {
+#if GLX_USE_CONTEXT_MAP
+    return __glXContextMapLookup(context);
+#else
     __GLXcontextInfo *ctxInfo;
     __GLXvendorInfo *vendor = NULL;
 
@@ -742,11 +774,15 @@ __GLXvendorInfo *__glXVendorFromContext(GLXContext context)
     __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
 
     return vendor;
+#endif
 }
 
 static void FreeContextInfo(__GLXcontextInfo *ctx)
 {
     if (ctx != NULL) {
+#if GLX_USE_CONTEXT_MAP
+        __glXContextMapRemove(ctx->context);
+#endif
         HASH_DELETE(hh, glxContextHash, ctx);
         free(ctx);
     }
@@ -757,6 +793,7 @@ static void UpdateCurrentContext(__GLXcontextInfo *newCtxInfo, __GLXcontextInfo
     if (newCtxInfo == oldCtxInfo) {
         return;
     }
+    __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
     if (newCtxInfo != NULL) {
         newCtxInfo->currentCount++;
     }
@@ -765,6 +802,21 @@ static void UpdateCurrentContext(__GLXcontextInfo *newCtxInfo, __GLXcontextInfo
         oldCtxInfo->currentCount--;
         CheckContextDeleted(oldCtxInfo);
     }
+    __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
+}
+
+static __GLXcontextInfo *AcquireContextInfo(GLXContext context)
+{
+    __GLXcontextInfo *ctxInfo;
+
+    __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
+    HASH_FIND_PTR(glxContextHash, &context, ctxInfo);
+    if (ctxInfo != NULL) {
+        ctxInfo->currentCount++;
+    }
+    __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
+
+    return ctxInfo;
 }
 
 static void CheckContextDeleted(__GLXcontextInfo *ctx)
@@ -1010,20 +1062,17 @@ static Bool CommonMakeCurrent(Display *dpy, GLXDrawable draw,
         return True;
     }
 
-    __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
-
     if (context != NULL) {
         // Look up the new display. This will ensure that we keep track of it
         // and get a callback when it's closed.
         if (__glXLookupDisplay(dpy) == NULL) {
-            __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
             return False;
         }
 
-        HASH_FIND_PTR(glxContextHash, &context, newCtxInfo);
+        // Add a reference to the new context, so that it stays valid while
+        // we call into the vendor library below.
+        newCtxInfo = AcquireContextInfo(context);
         if (newCtxInfo == NULL) {
-            __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
-
             /*
              * We can run into this corner case if a GLX client calls
              * glXDestroyContext() on a current context, loses current to this
@@ -1082,31 +1131,45 @@ static Bool CommonMakeCurrent(Display *dpy, GLXDrawable draw,
          * the new context current.
          */
 
-        // First, check to see if calling InternalLoseCurrent is going to
-        // destroy the old context.
-        Bool canRestoreOldContext = True;
-        if (oldCtxInfo->deleted && oldCtxInfo->currentCount == 1) {
-            canRestoreOldContext = False;
-        }
+        // Add a reference to the old context, too, so that it stays valid if
+        // we have to restore it.
+        UpdateCurrentContext(oldCtxInfo, NULL);
+
         ret = InternalLoseCurrent();
 
         if (ret) {
             ret = InternalMakeCurrentDispatch(dpy, draw, read, newCtxInfo, callerOpcode,
                     newVendor);
-            if (!ret && canRestoreOldContext) {
-                /*
-                 * Try to restore the old context. Note that this can fail if
-                 * the old context was marked for deletion. If that happens,
-                 * then we'll end up with no current context instead, but we
-                 * should at least still be in a consistent state.
-                 */
-                InternalMakeCurrentDispatch(oldDpy, oldDraw, oldRead, oldCtxInfo,
-                        callerOpcode, oldVendor);
+            if (!ret) {
+                // If the old context was marked for deletion and it isn't
+                // current to any other thread, then releasing it destroyed it,
+                // so we can't restore it.
+                Bool canRestoreOldContext;
+
+                __glvndPthreadFuncs.mutex_lock(&glxContextHashLock);
+                canRestoreOldContext = !(oldCtxInfo->deleted && oldCtxInfo->currentCount == 1);
+                __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
+
+                if (canRestoreOldContext) {
+                    /*
+                     * Try to restore the old context. Note that this can fail if
+                     * the old context was marked for deletion. If that happens,
+                     * then we'll end up with no current context instead, but we
+                     * should at least still be in a consistent state.
+                     */
+                    InternalMakeCurrentDispatch(oldDpy, oldDraw, oldRead, oldCtxInfo,
+                            callerOpcode, oldVendor);
+                }
             }
         }
+
+        UpdateCurrentContext(NULL, oldCtxInfo);
     }
 
-    __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
+    // Release the reference from AcquireContextInfo.
+    if (newCtxInfo != NULL) {
+        UpdateCurrentContext(NULL, newCtxInfo);
+    }
     return ret;
 }
 
@@ -1917,39 +1980,51 @@ int AtomicDecrementClampAtZero(int volatile *val)
 
 static void __glXResetOnFork(void);
 
+/*
+ * The fork generation (see glvndGetForkGeneration) that we last recovered
+ * from, and the one that a thread last started recovering from. The first is
+ * only updated once recovery is finished, so the common case in CheckFork is
+ * a single load and compare.
+ */
+static int volatile forkGenerationChecked;
+static int volatile forkGenerationSeen;
+static int volatile threadsInForkCheck;
+
 /*!
  * Checks to see if a fork occurred since the last GLX entrypoint was called,
  * and performs recovery if needed.
  */
 static void CheckFork(void)
 {
-    volatile static int g_threadsInCheck = 0;
-    volatile static int g_lastPid = -1;
+    int gen = glvndGetForkGeneration();
+    int lastGen;
 
-    int lastPid;
-    int pid = getpid();
+    if (gen == forkGenerationChecked) {
+        return;
+    }
 
-    AtomicIncrement(&g_threadsInCheck);
+    AtomicIncrement(&threadsInForkCheck);
 
-    lastPid = AtomicSwap(&g_lastPid, pid);
+    lastGen = AtomicSwap(&forkGenerationSeen, gen);
 
-    if ((lastPid != -1) &&
-        (lastPid != pid)) {
+    if (lastGen != gen) {
 
         DBG_PRINTF(0, "Fork detected\n");
 
         __glXResetOnFork();
 
-        // Force g_threadsInCheck to 0 to unblock other threads waiting here.
-        g_threadsInCheck = 0;
+        forkGenerationChecked = gen;
+
+        // Force threadsInForkCheck to 0 to unblock other threads waiting here.
+        threadsInForkCheck = 0;
     } else {
-        AtomicDecrementClampAtZero(&g_threadsInCheck);
-        while (g_threadsInCheck > 0) {
+        AtomicDecrementClampAtZero(&threadsInForkCheck);
+        while (threadsInForkCheck > 0) {
             // Wait for other threads to finish checking for a fork.
             //
-            // If a fork happens while g_threadsInCheck > 0 the _first_ thread
+            // If a fork happens while threadsInForkCheck > 0 the _first_ thread
             // to enter __glXThreadInitialize() will see the fork, handle it, and force
-            // g_threadsInCheck to 0, unblocking any other threads stuck here.
+            // threadsInForkCheck to 0, unblocking any other threads stuck here.
             sched_yield();
         }
     }
@@ -1983,6 +2058,9 @@ static void __glXAPITeardown(Bool doReset)
         __glvndPthreadFuncs.rwlock_init(&__glXProcAddressHash.lock, NULL);
         __glvndPthreadFuncs.mutex_init(&currentThreadStateListMutex, NULL);
 
+#if GLX_USE_CONTEXT_MAP
+        __glXContextMapTeardown(True);
+#endif
         HASH_ITER(hh, glxContextHash, currContext, currContextTemp) {
             currContext->currentCount = 0;
             CheckContextDeleted(currContext);
@@ -1992,17 +2070,19 @@ static void __glXAPITeardown(Bool doReset)
                          __glXProcAddressHash, NULL, NULL, False);
 
         /*
-         * It's possible that another thread could be blocked in a
-         * glXMakeCurrent call here, especially if an Xlib I/O error occurred.
-         * In that case, the other thead will be holding the context hash lock,
-         * so we'd deadlock if we tried to wait for it here. Instead, clean up
-         * if the lock is available, but don't try to wait if it isn't.
+         * It's possible that another thread could be holding the context hash
+         * lock here, if it's still running while the process exits. Clean up
+         * if the lock is available, but don't try to wait for it if it
+         * isn't.
          */
         if (__glvndPthreadFuncs.mutex_trylock(&glxContextHashLock) == 0) {
             HASH_ITER(hh, glxContextHash, currContext, currContextTemp) {
                 FreeContextInfo(currContext);
             }
             assert(glxContextHash == NULL);
+#if GLX_USE_CONTEXT_MAP
+            __glXContextMapTeardown(False);
+#endif
             __glvndPthreadFuncs.mutex_unlock(&glxContextHashLock);
         }
     }
@@ -2068,8 +2148,6 @@ void __attribute__ ((constructor)) __glXInit(void)
 void _init(void)
 #endif
 {
-    glvnd_mutexattr_t mutexAttribs;
-
     if (__glDispatchGetABIVersion() != GLDISPATCH_ABI_VERSION) {
         fprintf(stderr, "libGLdispatch ABI version is incompatible with libGLX.\n");
         abort();
@@ -2083,17 +2161,10 @@ void _init(void)
     glvnd_list_init(&currentThreadStateList);
 
     /*
-     * glxContextHashLock must be a recursive mutex, because we'll have it
-     * locked when we call into the vendor library's glXMakeCurrent
-     * implementation. If the vendor library generates an X error, then that
-     * will often result in a call to exit. In that case, the teardown code
-     * will try to lock the mutex again so that it can clean up the current
-     * context list.
+     * glxContextHashLock is only held for short critical sections that don't
+     * call into a vendor library or Xlib, so it doesn't need to be recursive.
      */
-    __glvndPthreadFuncs.mutexattr_init(&mutexAttribs);
-    __glvndPthreadFuncs.mutexattr_settype(&mutexAttribs, PTHREAD_MUTEX_RECURSIVE);
-    __glvndPthreadFuncs.mutex_init(&glxContextHashLock, &mutexAttribs);
-    __glvndPthreadFuncs.mutexattr_destroy(&mutexAttribs);
+    __glvndPthreadFuncs.mutex_init(&glxContextHashLock, NULL);
 
     __glXMappingInit();
 
@@ -2109,7 +2180,8 @@ void _init(void)
         }
     }
 
-    /* TODO install fork handlers using __register_atfork */
+    glvndSetupForkHandler();
+    forkGenerationChecked = forkGenerationSeen = glvndGetForkGeneration();
 
     DBG_PRINTF(0, "Loading GLX...\n");
 
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include "libglxcontextmap.h"
+
+#if GLX_USE_CONTEXT_MAP
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/*
+ * The map is an open-addressed hashtable with linear probing.
+ *
+ * Each slot only ever goes from empty, to holding a context, to deleted. The
+ * vendor is written before the context, so a reader that finds a context in
+ * a slot will always find the right vendor with it. Deleted slots are never
+ * reused. Instead, once too many slots are in use, the writer copies the live
+ * entries into a new table and replaces the old one.
+ *
+ * A reader might still be looking at the old table, so the writer can't free
+ * it right away. Every lookup increments a reader count before it loads the
+ * table pointer, and decrements it when it's done. There are two sets of
+ * counts, and the writer switches which set new lookups use after it
+ * replaces the table. Once every count in the old set drops to zero, no
+ * lookup can still have a pointer to the old table, so it can be freed.
+ *
+ * A lookup checks the epoch again after it increments its count. If the
+ * writer switched sets in between, then the writer might already be done
+ * waiting on that set, and a second resize would only wait on the other
+ * one. So in that case, the lookup backs out and tries again with the new
+ * set.
+ *
+ * The counts are spread across several cache lines, so that threads doing
+ * lookups at the same time don't all write to the same one.
+ */
+
+#define CONTEXT_MAP_DELETED ((GLXContext) (uintptr_t) 1)
+
+#define CONTEXT_MAP_MIN_SIZE 16
+
+#define CONTEXT_MAP_READER_SLOTS 16
+
+#define CONTEXT_MAP_CACHE_LINE_SIZE 64
+
+/*
+ * The stress test defines this to pause a lookup at a given point, so that
+ * it can make the writer replace the table in between.
+ */
+#if !defined(CONTEXT_MAP_TEST_HOOK)
+#define CONTEXT_MAP_TEST_HOOK(point)
+#endif
+#define CONTEXT_MAP_HOOK_LOADED_EPOCH 0
+#define CONTEXT_MAP_HOOK_LOADED_TABLE 1
+
+typedef struct __GLXcontextMapEntryRec {
+    GLXContext context;
+    __GLXvendorInfo *vendor;
+} __GLXcontextMapEntry;
+
+typedef struct __GLXcontextMapTableRec {
+    size_t mask;
+
+    /// The number of slots that are either live or deleted.
+    size_t used;
+
+    /// The number of live entries.
+    size_t count;
+
+    __GLXcontextMapEntry entries[];
+} __GLXcontextMapTable;
+
+typedef struct __GLXcontextMapReaderCountRec {
+    int count;
+    char padding[CONTEXT_MAP_CACHE_LINE_SIZE - sizeof(int)];
+} __GLXcontextMapReaderCount;
+
+static __GLXcontextMapTable *contextMapTable = NULL;
+
+static __GLXcontextMapReaderCount contextMapReaders[2][CONTEXT_MAP_READER_SLOTS];
+static int contextMapReaderEpoch = 0;
+
+#if defined(GLDISPATCH_USE_TLS)
+static __thread int contextMapReaderSlot = -1;
+static int contextMapNextReaderSlot = 0;
+#endif
+
+static inline size_t HashContext(GLXContext context)
+{
+    uintptr_t h = (uintptr_t) context;
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return (size_t) h;
+}
+
+/**
+ * Returns which reader count the current thread should use.
+ */
+static inline int GetReaderSlot(void)
+{
+#if defined(GLDISPATCH_USE_TLS)
+    if (contextMapReaderSlot < 0) {
+        contextMapReaderSlot = __atomic_fetch_add(&contextMapNextReaderSlot, 1,
+                __ATOMIC_RELAXED) % CONTEXT_MAP_READER_SLOTS;
+    }
+    return contextMapReaderSlot;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Finds the slot for a context in a table.
+ *
+ * \return The slot index, or -1 if the context isn't in the table.
+ */
+static ssize_t FindSlot(const __GLXcontextMapTable *table, GLXContext context)
+{
+    size_t i = HashContext(context) & table->mask;
+
+    while (1) {
+        GLXContext key = __atomic_load_n(&table->entries[i].context, __ATOMIC_ACQUIRE);
+        if (key == context) {
+            return i;
+        } else if (key == NULL) {
+            return -1;
+        }
+        i = (i + 1) & table->mask;
+    }
+}
+
+/**
+ * Adds an entry to a table. The table must have at least one empty slot.
+ */
+static void InsertEntry(__GLXcontextMapTable *table, GLXContext context,
+        __GLXvendorInfo *vendor)
+{
+    size_t i = HashContext(context) & table->mask;
+
+    while (table->entries[i].context != NULL) {
+        i = (i + 1) & table->mask;
+    }
+
+    table->entries[i].vendor = vendor;
+    __atomic_store_n(&table->entries[i].context, context, __ATOMIC_RELEASE);
+    table->used++;
+    table->count++;
+}
+
+/**
+ * Waits until no lookup can still be using a table that's been replaced.
+ *
+ * The caller must have already stored the new table pointer.
+ */
+static void WaitForReaders(void)
+{
+    int oldEpoch = contextMapReaderEpoch;
+    int i;
+
+    __atomic_store_n(&contextMapReaderEpoch, !oldEpoch, __ATOMIC_SEQ_CST);
+
+    for (i=0; i<CONTEXT_MAP_READER_SLOTS; i++) {
+        while (__atomic_load_n(&contextMapReaders[oldEpoch][i].count, __ATOMIC_SEQ_CST) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Replaces the current table with a new one that has room for at least
+ * \p minCount entries.
+ */
+static int ResizeTable(size_t minCount)
+{
+    __GLXcontextMapTable *oldTable = contextMapTable;
+    __GLXcontextMapTable *newTable;
+    size_t size = CONTEXT_MAP_MIN_SIZE;
+    size_t i;
+
+    // Leave the new table at most 1/4 full, so that we don't have to replace
+    // it again right away.
+    while (size < minCount * 4) {
+        size *= 2;
+    }
+
+    newTable = calloc(1, sizeof(__GLXcontextMapTable)
+            + size * sizeof(__GLXcontextMapEntry));
+    if (newTable == NULL) {
+        return -1;
+    }
+    newTable->mask = size - 1;
+
+    if (oldTable != NULL) {
+        for (i=0; i<=oldTable->mask; i++) {
+            GLXContext context = oldTable->entries[i].context;
+            if (context != NULL && context != CONTEXT_MAP_DELETED) {
+                InsertEntry(newTable, context, oldTable->entries[i].vendor);
+            }
+        }
+    }
+
+    __atomic_store_n(&contextMapTable, newTable, __ATOMIC_SEQ_CST);
+
+    if (oldTable != NULL) {
+        WaitForReaders();
+        free(oldTable);
+    }
+    return 0;
+}
+
+int __glXContextMapAdd(GLXContext context, __GLXvendorInfo *vendor)
+{
+    __GLXcontextMapTable *table = contextMapTable;
+
+    assert(context != NULL && context != CONTEXT_MAP_DELETED);
+
+    // Keep at least 1/4 of the slots empty, so that probing stays short.
+    if (table == NULL || (table->used + 1) * 4 > (table->mask + 1) * 3) {
+        if (ResizeTable((table != NULL ? table->count : 0) + 1) != 0) {
+            return -1;
+        }
+        table = contextMapTable;
+    }
+
+    assert(FindSlot(table, context) < 0);
+    InsertEntry(table, context, vendor);
+    return 0;
+}
+
+void __glXContextMapRemove(GLXContext context)
+{
+    __GLXcontextMapTable *table = contextMapTable;
+    ssize_t slot;
+
+    if (table == NULL || context == NULL || context == CONTEXT_MAP_DELETED) {
+        return;
+    }
+
+    slot = FindSlot(table, context);
+    if (slot >= 0) {
+        __atomic_store_n(&table->entries[slot].context, CONTEXT_MAP_DELETED,
+                __ATOMIC_RELEASE);
+        table->count--;
+    }
+}
+
+__GLXvendorInfo *__glXContextMapLookup(GLXContext context)
+{
+    __GLXcontextMapTable *table;
+    __GLXvendorInfo *vendor = NULL;
+    int slot, epoch;
+
+    if (context == NULL || context == CONTEXT_MAP_DELETED) {
+        return NULL;
+    }
+
+    slot = GetReaderSlot();
+    while (1) {
+        epoch = __atomic_load_n(&contextMapReaderEpoch, __ATOMIC_SEQ_CST);
+        CONTEXT_MAP_TEST_HOOK(CONTEXT_MAP_HOOK_LOADED_EPOCH);
+        __atomic_fetch_add(&contextMapReaders[epoch][slot].count, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&contextMapReaderEpoch, __ATOMIC_SEQ_CST) == epoch) {
+            break;
+        }
+        __atomic_fetch_sub(&contextMapReaders[epoch][slot].count, 1, __ATOMIC_RELEASE);
+    }
+
+    table = __atomic_load_n(&contextMapTable, __ATOMIC_SEQ_CST);
+    CONTEXT_MAP_TEST_HOOK(CONTEXT_MAP_HOOK_LOADED_TABLE);
+    if (table != NULL) {
+        ssize_t i = FindSlot(table, context);
+        if (i >= 0) {
+            vendor = table->entries[i].vendor;
+        }
+    }
+
+    __atomic_fetch_sub(&contextMapReaders[epoch][slot].count, 1, __ATOMIC_RELEASE);
+    return vendor;
+}
+
+void __glXContextMapTeardown(Bool doReset)
+{
+    // This is only called after a fork, when the other threads are gone, or
+    // when libGLX is unloaded, so nothing can be in the middle of a lookup.
+    memset(contextMapReaders, 0, sizeof(contextMapReaders));
+
+    if (!doReset) {
+        free(contextMapTable);
+        contextMapTable = NULL;
+    }
+}
+
+#endif // GLX_USE_CONTEXT_MAP
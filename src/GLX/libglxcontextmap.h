@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#if !defined(__LIB_GLX_CONTEXT_MAP_H)
+#define __LIB_GLX_CONTEXT_MAP_H
+
+/**
+ * \file
+ *
+ * A map from GLXContext handles to vendors that can be read without taking a
+ * lock.
+ *
+ * libGLX keeps the same mapping in its glxContextHash table, along with the
+ * rest of the context bookkeeping. This is just a copy of the context and
+ * vendor fields, so that __glXVendorFromContext doesn't have to take
+ * glxContextHashLock.
+ *
+ * Only one thread at a time may modify the map, so the caller must hold
+ * glxContextHashLock to add or remove an entry. Lookups don't need any lock.
+ *
+ * This needs atomic intrinsics. Without them, \c GLX_USE_CONTEXT_MAP is zero,
+ * and libGLX looks up contexts in glxContextHash instead.
+ */
+
+#include "libglxmapping.h"
+
+#if defined(HAVE_SYNC_INTRINSICS)
+#define GLX_USE_CONTEXT_MAP 1
+#else
+#define GLX_USE_CONTEXT_MAP 0
+#endif
+
+#if GLX_USE_CONTEXT_MAP
+
+/**
+ * Adds a context to the map.
+ *
+ * The context must not already be in the map.
+ *
+ * \return Zero on success, or -1 if we couldn't allocate memory.
+ */
+int __glXContextMapAdd(GLXContext context, __GLXvendorInfo *vendor);
+
+/**
+ * Removes a context from the map.
+ */
+void __glXContextMapRemove(GLXContext context);
+
+/**
+ * Returns the vendor for a context, or NULL if the context isn't in the map.
+ *
+ * This is safe to call at any time without holding any lock.
+ */
+__GLXvendorInfo *__glXContextMapLookup(GLXContext context);
+
+/**
+ * Frees the map, or resets it after a fork.
+ *
+ * After a fork, the current thread is the only one left, so this just resets
+ * the counts of in-progress lookups from the other threads. The entries
+ * themselves are still valid.
+ */
+void __glXContextMapTeardown(Bool doReset);
+
+#endif // GLX_USE_CONTEXT_MAP
+
+#endif // __LIB_GLX_CONTEXT_MAP_H
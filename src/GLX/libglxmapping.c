@@ -28,6 +28,7 @@
 #include <pthread.h>
 #include <dlfcn.h>
 #include <string.h>
+#include <time.h>
 
 #if defined(HASH_DEBUG)
 # include <stdio.h>
@@ -125,6 +126,7 @@ static const __GLXapiExports glxExportsTable = {
     .addVendorDrawableMapping = __glXAddVendorDrawableMapping,
     .removeVendorDrawableMapping = __glXRemoveVendorDrawableMapping,
     .vendorFromDrawable = __glXVendorFromDrawable,
+    .prefetchDrawableVendors = __glXPrefetchDrawableVendors,
 };
 
 /*!
@@ -380,6 +382,18 @@ static void *VendorGetProcAddressCallback(const char *procName, void *param)
     return vendor->glxvc->getProcAddress((const GLubyte *) procName);
 }
 
+static GLboolean VendorGetProcAddressesCallback(const char * const *procNames,
+        int first, int count, void **procs, void *param)
+{
+    __GLXvendorInfo *vendor = (__GLXvendorInfo *) param;
+    if (vendor->glxvc->getProcAddresses != NULL) {
+        return !!vendor->glxvc->getProcAddresses((const GLubyte * const *) procNames,
+                first, count, procs);
+    } else {
+        return GL_FALSE;
+    }
+}
+
 __GLXvendorInfo *__glXLookupVendorByName(const char *vendorName)
 {
     __GLXvendorNameHash *pEntry = NULL;
@@ -441,8 +455,9 @@ __GLXvendorInfo *__glXLookupVendorByName(const char *vendorName)
             assert(vendor->vendorID >= 0);
 
             vendor->glDispatch = (__GLdispatchTable *)
-                __glDispatchCreateTable(
+                __glDispatchCreateTableBulk(
                     VendorGetProcAddressCallback,
+                    VendorGetProcAddressesCallback,
                     vendor
                 );
             if (!vendor->glDispatch) {
@@ -483,6 +498,14 @@ __GLXvendorInfo *__glXLookupVendorByName(const char *vendorName)
                 pEntry->patchCallbacks.initiatePatch = pEntry->imports.initiatePatch;
                 pEntry->patchCallbacks.releasePatch = pEntry->imports.releasePatch;
                 pEntry->patchCallbacks.threadAttach = pEntry->imports.patchThreadAttach;
+                pEntry->patchCallbacks.reusePatch = pEntry->imports.reusePatch;
+                pEntry->patchCallbacks.initiatePatchConcurrent = pEntry->imports.initiatePatchConcurrent;
+                pEntry->vendor.patchCallbacks = &pEntry->patchCallbacks;
+            } else if (pEntry->imports.contextIndependentDispatch) {
+                // Let libGLdispatch patch the entrypoints itself. Each vendor
+                // still gets its own copy of the callbacks, since
+                // libGLdispatch tells vendors apart by the pointer.
+                pEntry->patchCallbacks = *__glDispatchGetDirectPatchCallbacks();
                 pEntry->vendor.patchCallbacks = &pEntry->patchCallbacks;
             }
 
@@ -884,9 +907,57 @@ __GLXvendorInfo *__glXVendorFromFBConfig(Display *dpy, GLXFBConfig config)
  */
 
 
+static unsigned long GetTimeMS(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static __GLXbadXIDCacheEntry *GetBadXIDCacheEntry(__GLXdisplayInfo *dpyInfo, XID xid)
+{
+    return &dpyInfo->badXIDCache[xid & (GLX_BAD_XID_CACHE_SIZE - 1)];
+}
+
+/*!
+ * Checks whether the server recently reported that an XID isn't a drawable.
+ *
+ * The caller must hold the xidVendorHash lock.
+ */
+static Bool IsBadXIDCached(__GLXdisplayInfo *dpyInfo, XID xid)
+{
+    const __GLXbadXIDCacheEntry *entry = GetBadXIDCacheEntry(dpyInfo, xid);
+
+    if (xid == None || entry->xid != xid) {
+        return False;
+    }
+    return ((long) (entry->expires - GetTimeMS()) > 0);
+}
+
+/*!
+ * Records that an XID isn't a drawable. This replaces whatever XID was in
+ * the same slot before.
+ */
+static void AddBadXID(__GLXdisplayInfo *dpyInfo, XID xid)
+{
+    __GLXbadXIDCacheEntry *entry;
+
+    if (xid == None) {
+        return;
+    }
+
+    LKDHASH_WRLOCK(dpyInfo->xidVendorHash);
+    entry = GetBadXIDCacheEntry(dpyInfo, xid);
+    entry->xid = xid;
+    entry->expires = GetTimeMS() + GLX_BAD_XID_CACHE_TIMEOUT;
+    LKDHASH_UNLOCK(dpyInfo->xidVendorHash);
+}
+
 static int AddVendorXIDMapping(Display *dpy, __GLXdisplayInfo *dpyInfo, XID xid, __GLXvendorInfo *vendor)
 {
     __GLXvendorXIDMappingHash *pEntry = NULL;
+    __GLXbadXIDCacheEntry *badEntry;
 
     if (xid == None) {
         return 0;
@@ -909,6 +980,12 @@ static int AddVendorXIDMapping(Display *dpy, __GLXdisplayInfo *dpyInfo, XID xid,
         pEntry->xid = xid;
         pEntry->vendor = vendor;
         HASH_ADD(hh, _LH(dpyInfo->xidVendorHash), xid, sizeof(xid), pEntry);
+
+        // If the XID was a bad drawable before, then it isn't anymore.
+        badEntry = GetBadXIDCacheEntry(dpyInfo, xid);
+        if (badEntry->xid == xid) {
+            badEntry->xid = None;
+        }
     } else {
         // Like GLXContext and GLXFBConfig handles, any GLXDrawables must map
         // to a single vendor library.
@@ -949,6 +1026,7 @@ static void VendorFromXID(Display *dpy, __GLXdisplayInfo *dpyInfo, XID xid,
 {
     __GLXvendorXIDMappingHash *pEntry;
     __GLXvendorInfo *vendor = NULL;
+    Bool knownBad = False;
 
     LKDHASH_RDLOCK(dpyInfo->xidVendorHash);
 
@@ -956,20 +1034,25 @@ static void VendorFromXID(Display *dpy, __GLXdisplayInfo *dpyInfo, XID xid,
 
     if (pEntry) {
         vendor = pEntry->vendor;
-        LKDHASH_UNLOCK(dpyInfo->xidVendorHash);
     } else {
-        LKDHASH_UNLOCK(dpyInfo->xidVendorHash);
+        knownBad = IsBadXIDCached(dpyInfo, xid);
+    }
+    LKDHASH_UNLOCK(dpyInfo->xidVendorHash);
 
-        if (dpyInfo->libglvndExtensionSupported) {
-            int screen = __glXGetDrawableScreen(dpyInfo, xid);
-            if (screen >= 0 && screen < ScreenCount(dpy)) {
-                vendor = __glXLookupVendorByScreen(dpy, screen);
-                if (vendor != NULL) {
-                    // Note that if this fails, it's not necessarily a problem.
-                    // We can just query it again next time.
-                    AddVendorXIDMapping(dpy, dpyInfo, xid, vendor);
-                }
+    if (pEntry == NULL && !knownBad && dpyInfo->libglvndExtensionSupported) {
+        int screen = __glXGetDrawableScreen(dpyInfo, xid);
+        if (screen >= 0 && screen < ScreenCount(dpy)) {
+            vendor = __glXLookupVendorByScreen(dpy, screen);
+            if (vendor != NULL) {
+                // Note that if this fails, it's not necessarily a problem.
+                // We can just query it again next time.
+                AddVendorXIDMapping(dpy, dpyInfo, xid, vendor);
             }
+        } else if (screen == GLX_SCREEN_BAD_DRAWABLE) {
+            // The server doesn't know about this drawable, so remember that
+            // for a while instead of asking again on every call. Any other
+            // error might not happen again, so don't cache those.
+            AddBadXID(dpyInfo, xid);
         }
     }
 
@@ -1017,6 +1100,67 @@ __GLXvendorInfo *__glXVendorFromDrawable(Display *dpy, GLXDrawable drawable)
     return vendor;
 }
 
+void __glXPrefetchDrawableVendors(Display *dpy, const GLXDrawable *drawables, int count)
+{
+    __GLXdisplayInfo *dpyInfo;
+    GLXDrawable *missing;
+    int *screens;
+    int numMissing = 0;
+    int i;
+
+    if (drawables == NULL || count <= 0) {
+        return;
+    }
+
+    __glXThreadInitialize();
+
+    dpyInfo = __glXLookupDisplay(dpy);
+    if (dpyInfo == NULL || !dpyInfo->libglvndExtensionSupported) {
+        // Without GLX_EXT_libglvnd, every drawable maps to the same vendor,
+        // so there's nothing to look up.
+        return;
+    }
+
+    missing = malloc(count * (sizeof(GLXDrawable) + sizeof(int)));
+    if (missing == NULL) {
+        return;
+    }
+    screens = (int *) (missing + count);
+
+    // Figure out which drawables we don't already know about.
+    LKDHASH_RDLOCK(dpyInfo->xidVendorHash);
+    for (i=0; i<count; i++) {
+        __GLXvendorXIDMappingHash *pEntry;
+        XID xid = drawables[i];
+
+        if (xid == None || IsBadXIDCached(dpyInfo, xid)) {
+            continue;
+        }
+        HASH_FIND(hh, _LH(dpyInfo->xidVendorHash), &xid, sizeof(xid), pEntry);
+        if (pEntry == NULL) {
+            missing[numMissing++] = xid;
+        }
+    }
+    LKDHASH_UNLOCK(dpyInfo->xidVendorHash);
+
+    if (numMissing > 0) {
+        __glXGetDrawableScreens(dpyInfo, missing, numMissing, screens);
+
+        for (i=0; i<numMissing; i++) {
+            if (screens[i] >= 0 && screens[i] < ScreenCount(dpy)) {
+                __GLXvendorInfo *vendor = __glXLookupVendorByScreen(dpy, screens[i]);
+                if (vendor != NULL) {
+                    AddVendorXIDMapping(dpy, dpyInfo, missing[i], vendor);
+                }
+            } else if (screens[i] == GLX_SCREEN_BAD_DRAWABLE) {
+                AddBadXID(dpyInfo, missing[i]);
+            }
+        }
+    }
+
+    free(missing);
+}
+
 void __glXMappingInit(void)
 {
     int i;
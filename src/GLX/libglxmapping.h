@@ -53,6 +53,26 @@ struct __GLXvendorInfoRec {
 
 typedef struct __GLXvendorXIDMappingHashRec __GLXvendorXIDMappingHash;
 
+/*!
+ * The number of entries in the per-display cache of unknown drawables.
+ *
+ * This must be a power of two.
+ */
+#define GLX_BAD_XID_CACHE_SIZE 64
+
+/*!
+ * How long (in milliseconds) to remember that an XID isn't a valid drawable.
+ *
+ * libGLX can't tell when another client creates a drawable, so this keeps a
+ * reused XID from getting stuck as invalid.
+ */
+#define GLX_BAD_XID_CACHE_TIMEOUT 1000
+
+typedef struct __GLXbadXIDCacheEntryRec {
+    XID xid;
+    unsigned long expires;
+} __GLXbadXIDCacheEntry;
+
 /*!
  * Structure containing per-display information.
  */
@@ -71,6 +91,15 @@ typedef struct __GLXdisplayInfoRec {
 
     DEFINE_LKDHASH(__GLXvendorXIDMappingHash, xidVendorHash);
 
+    /**
+     * XIDs that the server recently reported as not being drawables, so that
+     * we don't send another request every time someone uses one.
+     *
+     * This is indexed by the low-order bits of the XID, and it's protected
+     * by the same lock as \c xidVendorHash.
+     */
+    __GLXbadXIDCacheEntry badXIDCache[GLX_BAD_XID_CACHE_SIZE];
+
     /// True if the server supports the GLX extension.
     Bool glxSupported;
 
@@ -114,6 +143,7 @@ __GLXvendorInfo *__glXVendorFromFBConfig(Display *dpy, GLXFBConfig config);
 int __glXAddVendorDrawableMapping(Display *dpy, GLXDrawable drawable, __GLXvendorInfo *vendor);
 void __glXRemoveVendorDrawableMapping(Display *dpy, GLXDrawable drawable);
 __GLXvendorInfo *__glXVendorFromDrawable(Display *dpy, GLXDrawable drawable);
+void __glXPrefetchDrawableVendors(Display *dpy, const GLXDrawable *drawables, int count);
 
 __GLXextFuncPtr __glXGetGLXDispatchAddress(const GLubyte *procName);
 
@@ -121,6 +121,25 @@ char *__glXQueryServerString(__GLXdisplayInfo *dpyInfo, int screen, int name)
 
     return ret;
 }
+
+/*!
+ * Finds the GLX_SCREEN value in a list of drawable attributes.
+ *
+ * If the server didn't send a screen number, then it doesn't support
+ * GLX_EXT_libglvnd, so we'll use screen 0 for everything.
+ */
+static int FindScreenAttrib(const int *attribs, unsigned int numAttribs)
+{
+    unsigned int i;
+
+    for (i=0; i<numAttribs; i++) {
+        if (attribs[i * 2] == GLX_SCREEN) {
+            return attribs[i * 2 + 1];
+        }
+    }
+    return 0;
+}
+
 int __glXGetDrawableScreen(__GLXdisplayInfo *dpyInfo, GLXDrawable drawable)
 {
     Display *dpy = dpyInfo->dpy;
@@ -150,20 +169,144 @@ int __glXGetDrawableScreen(__GLXdisplayInfo *dpyInfo, GLXDrawable drawable)
 
     if (st == Success) {
         int screen = 0;
-        unsigned int i;
 
         if (attribs != NULL) {
-            for (i=0; i<rep.numAttribs; i++) {
-                if (attribs[i * 2] == GLX_SCREEN) {
-                    screen = attribs[i * 2 + 1];
-                    break;
-                }
-            }
+            screen = FindScreenAttrib(attribs, rep.numAttribs);
             free(attribs);
         }
         return screen;
+    } else if (st == dpyInfo->glxFirstError + GLXBadDrawable) {
+        return GLX_SCREEN_BAD_DRAWABLE;
     } else {
         return -1;
     }
 }
 
+typedef struct {
+    __GLXdisplayInfo *dpyInfo;
+    unsigned long firstSequence;
+    unsigned long lastSequence;
+    int *screens;
+} GetDrawableScreensState;
+
+/*!
+ * An async handler for the GLXGetDrawableAttributes requests sent by
+ * \c __glXGetDrawableScreens.
+ *
+ * This records the screen number from each reply. Errors are swallowed, and
+ * the screen for that drawable is set to \c GLX_SCREEN_BAD_DRAWABLE for a
+ * GLXBadDrawable error, or -1 for anything else.
+ */
+static Bool GetDrawableScreensHandler(Display *dpy, xReply *rep,
+        char *buf, int len, XPointer data)
+{
+    GetDrawableScreensState *state = (GetDrawableScreensState *) data;
+    unsigned long seq = dpy->last_request_read;
+    int index;
+
+    // The sequence numbers can wrap around in the middle of the batch, so
+    // compare the offsets from the first one instead.
+    if (seq - state->firstSequence > state->lastSequence - state->firstSequence) {
+        return False;
+    }
+    index = (int) (seq - state->firstSequence);
+
+    if (rep->generic.type == X_Error) {
+        if (rep->error.majorCode != state->dpyInfo->glxMajorOpcode) {
+            return False;
+        }
+        if (rep->error.errorCode == state->dpyInfo->glxFirstError + GLXBadDrawable) {
+            state->screens[index] = GLX_SCREEN_BAD_DRAWABLE;
+        } else {
+            state->screens[index] = -1;
+        }
+    } else {
+        const xGLXGetDrawableAttributesReply *repl =
+            (const xGLXGetDrawableAttributesReply *) rep;
+        int length = repl->length * 4;
+        int screen = 0;
+
+        if (length > 0) {
+            int *attribs = malloc(length);
+            _XGetAsyncData(dpy, (char *) attribs, buf, len,
+                    sz_xGLXGetDrawableAttributesReply,
+                    attribs != NULL ? length : 0, length);
+            if (attribs != NULL) {
+                unsigned int numAttribs = repl->numAttribs;
+                if (numAttribs > (unsigned int) (length / 8)) {
+                    numAttribs = length / 8;
+                }
+                screen = FindScreenAttrib(attribs, numAttribs);
+                free(attribs);
+            } else {
+                screen = -1;
+            }
+        }
+        state->screens[index] = screen;
+    }
+    return True;
+}
+
+void __glXGetDrawableScreens(__GLXdisplayInfo *dpyInfo,
+        const GLXDrawable *drawables, int count, int *screens)
+{
+    Display *dpy = dpyInfo->dpy;
+    GetDrawableScreensState state;
+    _XAsyncHandler async;
+    xGetInputFocusReply rep;
+    xReq *syncReq;
+    int i;
+
+    if (count <= 0) {
+        return;
+    }
+    if (!dpyInfo->glxSupported) {
+        for (i=0; i<count; i++) {
+            screens[i] = (drawables[i] != None ? 0 : -1);
+        }
+        return;
+    }
+
+    for (i=0; i<count; i++) {
+        screens[i] = -1;
+    }
+
+    LockDisplay(dpy);
+
+    // Send all of the requests first, and then wait for the replies with a
+    // single round trip. Each reply or error is picked up by the async
+    // handler as it comes in.
+    state.dpyInfo = dpyInfo;
+    state.screens = screens;
+    // Each request takes the next sequence number, so we know the whole
+    // range up front, in case a reply comes in while we're still sending.
+    state.firstSequence = dpy->request + 1;
+    state.lastSequence = state.firstSequence + (count - 1);
+
+    async.next = dpy->async_handlers;
+    async.handler = GetDrawableScreensHandler;
+    async.data = (XPointer) &state;
+    dpy->async_handlers = &async;
+
+    for (i=0; i<count; i++) {
+        xGLXGetDrawableAttributesReq *req;
+
+        GetReq(GLXGetDrawableAttributes, req);
+        req->reqType = dpyInfo->glxMajorOpcode;
+        req->glxCode = X_GLXGetDrawableAttributes;
+        req->drawable = drawables[i];
+    }
+    assert(state.lastSequence == dpy->request);
+
+    // This is the same thing that XSync does: Any replies to the earlier
+    // requests are guaranteed to arrive before this one.
+    GetEmptyReq(GetInputFocus, syncReq);
+    (void) syncReq;
+    _XReply(dpy, (xReply *) &rep, 0, xTrue);
+
+    DeqAsyncHandler(dpy, &async);
+
+    UnlockDisplay(dpy);
+    SyncHandle();
+}
+
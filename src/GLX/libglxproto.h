@@ -38,6 +38,14 @@
 
 #define GLX_EXT_LIBGLVND_NAME "GLX_EXT_libglvnd"
 
+/*!
+ * The screen number that \c __glXGetDrawableScreen and
+ * \c __glXGetDrawableScreens return if the server sent back a GLXBadDrawable
+ * error. Unlike any other error, that means the drawable doesn't exist, so
+ * there's no point in asking again.
+ */
+#define GLX_SCREEN_BAD_DRAWABLE (-2)
+
 /*!
  * Sends a glXQueryServerString request. If an error occurs, then it will
  * return \c NULL, but won't call the X error handler.
@@ -60,8 +68,25 @@ char *__glXQueryServerString(__GLXdisplayInfo *dpyInfo, int screen, int name);
  *
  * \param dpyInfo The display connection.
  * \param drawable The drawable to query.
- * \return The screen number for the drawable, or -1 on error.
+ * \return The screen number for the drawable, \c GLX_SCREEN_BAD_DRAWABLE if
+ * the server says that the drawable is invalid, or -1 on any other error.
  */
 int __glXGetDrawableScreen(__GLXdisplayInfo *dpyInfo, GLXDrawable drawable);
 
+/*!
+ * Looks up the screen numbers for several drawables at once.
+ *
+ * This is the same as calling \c __glXGetDrawableScreen for each drawable,
+ * except that it sends all of the requests before waiting for any replies,
+ * so it only takes a single round trip.
+ *
+ * \param dpyInfo The display connection.
+ * \param drawables The drawables to query.
+ * \param count The number of drawables.
+ * \param[out] screens Returns the screen number for each drawable, or
+ * \c GLX_SCREEN_BAD_DRAWABLE or -1, the same as \c __glXGetDrawableScreen.
+ */
+void __glXGetDrawableScreens(__GLXdisplayInfo *dpyInfo,
+        const GLXDrawable *drawables, int count, int *screens);
+
 #endif // LIBGLXPROTO_H
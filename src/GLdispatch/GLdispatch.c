@@ -26,28 +26,30 @@
 #include <string.h>
 #include <pthread.h>
 #include <dlfcn.h>
+#include <unistd.h>
 
 #include "trace.h"
 #include "glvnd_list.h"
 #include "GLdispatch.h"
 #include "GLdispatchPrivate.h"
 #include "stub.h"
+#include "trampoline.h"
+#include "call_counts.h"
+#include "direct_patch.h"
+#include "layers.h"
+#include "proc_cache.h"
 #include "glvnd_pthread.h"
 #include "app_error_check.h"
+#include "uthash.h"
 
 /*
- * Global current dispatch table list. We need this to fix up all current
- * dispatch tables whenever GetProcAddress() is called on a new function.
+ * Global dispatch table list. We need this to fix up all current dispatch
+ * tables whenever GetProcAddress() is called on a new function. A table is
+ * current if its currentThreads count is non-zero.
+ *
  * Accesses to this need to be protected by the dispatch lock.
  */
-static struct glvnd_list currentDispatchList;
-
-/**
- * A linked list of __GLdispatchThreadStatePrivate structs that we've
- * allocated. This is used to make sure that we clean up if we get unloaded
- * while a thread is still current.
- */
-static struct glvnd_list threadStatePrivateList;
+static struct glvnd_list dispatchTableList;
 
 /*
  * Number of clients using GLdispatch.
@@ -55,15 +57,21 @@ static struct glvnd_list threadStatePrivateList;
 static int clientRefcount;
 
 /*
- * The number of current contexts that GLdispatch is aware of
+ * The number of current contexts that GLdispatch is aware of. This is updated
+ * with atomic operations, since MakeCurrent and LoseCurrent don't always take
+ * the dispatch lock.
  */
-static int numCurrentContexts;
+static int volatile numCurrentContexts;
 
 /**
- * Private data for each API state.
+ * Private data for each thread.
+ *
+ * Each thread that calls into libGLdispatch gets one of these structs, which
+ * stays assigned to that thread until the thread terminates. When a thread
+ * terminates, the struct is released and can be reused by another thread.
  */
 typedef struct __GLdispatchThreadStatePrivateRec {
-    /// A pointer back to the API state.
+    /// A pointer back to the API state, or NULL if the thread isn't current.
     __GLdispatchThreadState *threadState;
 
     /// ID of the current vendor for this state
@@ -72,9 +80,32 @@ typedef struct __GLdispatchThreadStatePrivateRec {
     /// The current (high-level) __GLdispatch table
     __GLdispatchTable *dispatch;
 
-    struct glvnd_list entry;
+    /// Non-zero if this struct is assigned to a thread.
+    int volatile inUse;
+
+    /// Non-zero once __glDispatchCheckMultithreaded has seen this thread.
+    int threadChecked;
+
+    /// The value of stubPatchGeneration when this thread last called
+    /// threadAttach, or when it was first checked.
+    unsigned long attachedPatchGeneration;
+
+    /// The next struct in threadStatePrivateList.
+    struct __GLdispatchThreadStatePrivateRec *next;
 } __GLdispatchThreadStatePrivate;
 
+/**
+ * A list of every __GLdispatchThreadStatePrivate struct that we've allocated.
+ *
+ * New structs are pushed onto the front of the list with a compare-and-swap,
+ * and nothing is removed from the list until GLdispatch is torn down, so
+ * threads can walk the list without taking the dispatch lock. This is used to
+ * recycle the structs from terminated threads, to reset the other threads'
+ * state after a fork, and to make sure that we clean up if we get unloaded
+ * while a thread is still current.
+ */
+static __GLdispatchThreadStatePrivate * volatile threadStatePrivateList;
+
 /*
  * List of valid extension procs which have been assigned prototypes. At make
  * current time, if the new context's generation is out-of-date, we iterate
@@ -110,13 +141,45 @@ static GLint64 dispatchStubListGeneration;
 static int firstUnusedVendorID = 1;
 
 /**
- * The key used to store the __GLdispatchThreadState for the current thread.
+ * The key used to store the __GLdispatchThreadStatePrivate for the current
+ * thread.
  */
 static glvnd_key_t threadContextKey;
 
-static void SetCurrentThreadState(__GLdispatchThreadState *threadState);
+#if defined(GLDISPATCH_USE_TLS)
+/**
+ * A copy of the current thread's value for threadContextKey, so that looking
+ * up the current thread's state doesn't need a call to pthread_getspecific.
+ *
+ * The pthread key still holds the same pointer, so that ThreadDestroyed gets
+ * called when the thread exits.
+ *
+ * __glDispatchFini frees every private struct, but it can only clear the
+ * calling thread's copy. The generation number is compared against
+ * threadPrivateGeneration so that the other threads' copies don't leave a
+ * dangling pointer if GLdispatch gets initialized again.
+ */
+typedef struct __GLdispatchThreadPrivateTLSRec {
+    __GLdispatchThreadStatePrivate *priv;
+    unsigned int generation;
+} __GLdispatchThreadPrivateTLS;
+
+static __thread __GLdispatchThreadPrivateTLS threadPrivateTLS
+#if (defined(__GLIBC__) || defined(__FreeBSD__)) && !defined(GLDISPATCH_RUNTIME_STUBS)
+    __attribute__((tls_model("initial-exec")))
+#endif
+    ;
+
+static unsigned int threadPrivateGeneration = 1;
+#endif // defined(GLDISPATCH_USE_TLS)
+
 static void ThreadDestroyed(void *data);
-static int RegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks);
+static __GLdispatchThreadStatePrivate *GetCurrentThreadPrivate(void);
+static void SetCurrentThreadPrivate(__GLdispatchThreadStatePrivate *priv);
+static int RegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks,
+        size_t size);
+static mapi_func ResolveLazySlot(int slot);
+static mapi_func CountSlot(int slot);
 
 
 /*
@@ -131,6 +194,102 @@ static int stubOwnerVendorID;
  */
 static const __GLdispatchPatchCallbacks *stubCurrentPatchCb;
 
+/*
+ * Set while PatchEntrypoints is deciding whether to change the current set of
+ * patch callbacks. While this is set, MakeCurrent can't rely on
+ * stubCurrentPatchCb or stubOwnerVendorID without taking the dispatch lock.
+ */
+static int volatile stubPatchPending;
+
+/*
+ * Incremented every time that the entrypoints are patched or restored.
+ *
+ * __glDispatchCheckMultithreaded compares this against the value it saw the
+ * last time that it called threadAttach on each thread. The callback pointer
+ * alone isn't enough, since if the entrypoints go from vendor A to vendor B
+ * and back to A, then A needs another threadAttach call for the new patch.
+ */
+static unsigned long volatile stubPatchGeneration;
+
+/*
+ * Set if the entrypoints are patched with the generic patcher's callbacks.
+ * The functions that those jump to might not work without a current context,
+ * so LoseCurrent checks this to decide whether to restore the entrypoints.
+ */
+static int volatile stubDirectPatched;
+
+/*
+ * If this is set, then new dispatch tables are filled in with resolver
+ * trampolines instead of calling the vendor's getProcAddress callback for
+ * every function up front. Each trampoline looks up its function on the first
+ * call and stores it in the table. This is set from the
+ * __GLVND_LAZY_DISPATCH_TABLE environment variable.
+ */
+static GLboolean lazyDispatchTable;
+
+/*
+ * If this is set, then when a new stub is generated, any dispatch tables that
+ * are current get a resolver trampoline in the new slot, instead of looking
+ * up the function right away. This is set whenever trampolines are supported.
+ */
+static GLboolean lazyNewStubs;
+
+/*
+ * If this is set, then MakeCurrent installs a wrapper table of counting
+ * trampolines in front of each vendor's dispatch table. This is set from the
+ * __GLVND_CALL_COUNTS_FILE environment variable, which also names the file
+ * that the counts are written to.
+ */
+static GLboolean countCalls;
+
+/*
+ * The number of layers that were loaded from the __GLVND_LAYER_FILENAMES or
+ * __GLVND_LAYER_DIRS manifests. This only changes in __glDispatchInit and
+ * __glDispatchFini.
+ */
+static int numLayers;
+
+/*
+ * The name of each dispatch table slot, indexed by slot. This is handed to a
+ * vendor's getProcAddresses callback, so that it can fill in a whole table in
+ * one call. It's grown and filled in as new stubs are generated. Accesses to
+ * this need to be protected by the dispatch lock.
+ */
+static const char **procNameList;
+static int procNameListCount;
+static int procNameListCapacity;
+
+/*
+ * A buffer for a vendor's getProcAddresses callback to fill in, indexed by
+ * slot. It has the same capacity as procNameList. The results are copied into
+ * the dispatch table afterward, so that we don't write to any slots that don't
+ * change. Accesses to this need to be protected by the dispatch lock.
+ */
+static void **procAddressList;
+
+/*
+ * The directory for the on-disk cache of vendor functions, or NULL if the cache
+ * is disabled. This is set from the __GLVND_PROC_CACHE_DIR environment
+ * variable.
+ */
+static char *procCacheDir;
+
+/*
+ * A function name that __glDispatchProbeProcAddress found no vendor support
+ * for.
+ */
+typedef struct __GLdispatchUnknownProcRec {
+    char *name;
+    UT_hash_handle hh;
+} __GLdispatchUnknownProc;
+
+/*
+ * The names that __glDispatchProbeProcAddress found no vendor support for, so
+ * that it doesn't have to ask the vendors again. Accesses to this need to be
+ * protected by the dispatch lock.
+ */
+static __GLdispatchUnknownProc *unknownProcHash;
+
 static glvnd_thread_t firstThreadId = GLVND_THREAD_NULL_INIT;
 static int isMultiThreaded = 0;
 
@@ -158,11 +317,51 @@ static inline void UnlockDispatch(void)
 
 #define CheckDispatchLocked() assert(dispatchLock.isLocked)
 
+/*
+ * If we have atomic intrinsics, then the common cases of MakeCurrent and
+ * LoseCurrent only touch per-thread data and a few atomic counters. Otherwise,
+ * everything falls back to the dispatch lock.
+ */
+#if defined(HAVE_SYNC_INTRINSICS)
+#define USE_LOCKLESS_MAKE_CURRENT 1
+#else
+#define USE_LOCKLESS_MAKE_CURRENT 0
+#endif
+
+/**
+ * Atomically adds \p delta to \p val and returns the new value. This also acts
+ * as a full memory barrier.
+ *
+ * Without atomic intrinsics, the caller must hold the dispatch lock.
+ */
+static inline int DispatchAtomicAdd(int volatile *val, int delta)
+{
+#if USE_LOCKLESS_MAKE_CURRENT
+    return __sync_add_and_fetch(val, delta);
+#else
+    CheckDispatchLocked();
+    *val += delta;
+    return *val;
+#endif
+}
+
+static inline void DispatchMemoryBarrier(void)
+{
+#if USE_LOCKLESS_MAKE_CURRENT
+    __sync_synchronize();
+#endif
+}
+
 int __glDispatchGetABIVersion(void)
 {
     return GLDISPATCH_ABI_VERSION;
 }
 
+int __glDispatchGetStubMode(void)
+{
+    return _glapi_get_stub_mode();
+}
+
 #if defined(USE_ATTRIBUTE_CONSTRUCTOR)
 void __attribute__ ((constructor)) __glDispatchOnLoadInit(void)
 #else
@@ -186,6 +385,8 @@ void _fini(void)
 
 void __glDispatchInit(void)
 {
+    const char *cacheDirStr;
+
     LockDispatch();
 
     if (clientRefcount == 0) {
@@ -194,12 +395,45 @@ void __glDispatchInit(void)
         __glvndPthreadFuncs.key_create(&threadContextKey, ThreadDestroyed);
 
         glvnd_list_init(&extProcList);
-        glvnd_list_init(&currentDispatchList);
+        glvnd_list_init(&dispatchTableList);
         glvnd_list_init(&dispatchStubList);
-        glvnd_list_init(&threadStatePrivateList);
+        threadStatePrivateList = NULL;
 
         // Register GLdispatch's static entrypoints for rewriting
-        localDispatchStubId = RegisterStubCallbacks(stub_get_patch_callbacks());
+        localDispatchStubId = RegisterStubCallbacks(stub_get_patch_callbacks(),
+                sizeof(__GLdispatchStubPatchCallbacks));
+
+        // Don't let the environment pick a directory for a setuid or setgid
+        // process to write to or to load function addresses from.
+        if (getuid() == geteuid() && getgid() == getegid()) {
+            cacheDirStr = getenv("__GLVND_PROC_CACHE_DIR");
+            if (cacheDirStr != NULL && cacheDirStr[0] != '\0') {
+                procCacheDir = strdup(cacheDirStr);
+            }
+        }
+
+        if (trampoline_supported()) {
+            char *lazyStr = getenv("__GLVND_LAZY_DISPATCH_TABLE");
+            char *countsStr = NULL;
+
+            // Don't let the environment pick a file for a setuid or setgid
+            // process to write to.
+            if (getuid() == geteuid() && getgid() == getegid()) {
+                countsStr = getenv("__GLVND_CALL_COUNTS_FILE");
+            }
+            trampoline_set_hook(ResolveLazySlot);
+            lazyNewStubs = GL_TRUE;
+            if (lazyStr != NULL && atoi(lazyStr)) {
+                lazyDispatchTable = GL_TRUE;
+            }
+            if (countsStr != NULL && countsStr[0] != '\0'
+                    && CallCountsInit(countsStr, _glapi_get_dispatch_table_size())) {
+                trampoline_set_count_hook(CountSlot);
+                countCalls = GL_TRUE;
+            }
+        }
+
+        numLayers = LayersInit();
     }
 
     clientRefcount++;
@@ -223,22 +457,233 @@ static void noop_func(void)
 }
 
 static void DispatchCurrentRef(__GLdispatchTable *dispatch)
+{
+    DispatchAtomicAdd(&dispatch->currentThreads, 1);
+}
+
+static void DispatchCurrentUnref(__GLdispatchTable *dispatch)
+{
+    int count = DispatchAtomicAdd(&dispatch->currentThreads, -1);
+    assert(count >= 0);
+    (void) count;
+}
+
+/*
+ * Returns the list of slot names, filled in up to \p count.
+ */
+static const char * const *GetProcNameList(int count)
 {
     CheckDispatchLocked();
-    dispatch->currentThreads++;
-    if (dispatch->currentThreads == 1) {
-        glvnd_list_add(&dispatch->entry, &currentDispatchList);
+
+    if (procNameListCapacity < count) {
+        // The list is only used while the dispatch lock is held, so it's
+        // safe to move it.
+        int capacity = (procNameListCapacity > 0 ? procNameListCapacity : count);
+        const char **list;
+        void **addrs;
+
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        list = (const char **) realloc(procNameList, capacity * sizeof(const char *));
+        if (list == NULL) {
+            return NULL;
+        }
+        procNameList = list;
+
+        addrs = (void **) realloc(procAddressList, capacity * sizeof(void *));
+        if (addrs == NULL) {
+            return NULL;
+        }
+        procAddressList = addrs;
+        procNameListCapacity = capacity;
+    }
+
+    while (procNameListCount < count) {
+        procNameList[procNameListCount] = _glapi_get_proc_name(procNameListCount);
+        assert(procNameList[procNameListCount] != NULL);
+        procNameListCount++;
     }
+    return procNameList;
 }
 
-static void DispatchCurrentUnref(__GLdispatchTable *dispatch)
+/*
+ * Sets a slot in a dispatch table.
+ *
+ * A new table starts out as copy-on-write pages of noop_func pointers that are
+ * shared between every table, so this skips the write if the slot already has
+ * the right value.
+ */
+static inline void SetDispatchSlot(void **tbl, int slot, void *func)
 {
+    if (tbl[slot] != func) {
+        tbl[slot] = func;
+    }
+}
+
+/*
+ * Tries to look up a range of slots with a single call to the vendor's
+ * getProcAddresses callback. The results are stored in procAddressList, with
+ * NULL for any slots that the vendor doesn't support.
+ *
+ * Returns GL_FALSE if the vendor doesn't support that, in which case the
+ * caller has to look up each function separately.
+ */
+static GLboolean FixupDispatchTableBulk(__GLdispatchTable *dispatch,
+        int first, int count)
+{
+    const char * const *names;
+
     CheckDispatchLocked();
-    dispatch->currentThreads--;
-    if (dispatch->currentThreads == 0) {
-        glvnd_list_del(&dispatch->entry);
+
+    if (dispatch->getProcAddresses == NULL) {
+        return GL_FALSE;
+    }
+    if (first >= count) {
+        return GL_TRUE;
+    }
+
+    names = GetProcNameList(count);
+    if (names == NULL) {
+        return GL_FALSE;
+    }
+
+    memset(procAddressList + first, 0, (count - first) * sizeof(void *));
+    return (*dispatch->getProcAddresses)(names, first, count - first,
+            procAddressList, dispatch->getProcAddressParam);
+}
+
+static void *LookupDispatchSlot(__GLdispatchTable *dispatch, int slot)
+{
+    const char *name = _glapi_get_proc_name(slot);
+    void *procAddr;
+
+    assert(name != NULL);
+
+    procAddr = (void*)(*dispatch->getProcAddress)(
+        name, dispatch->getProcAddressParam);
+    return procAddr ? procAddr : (void *)noop_func;
+}
+
+/*
+ * Fills in the slots from \p first up to \p count by asking the vendor
+ * library.
+ */
+static void FillDispatchTableRange(__GLdispatchTable *dispatch,
+        int first, int count)
+{
+    void **tbl = (void **)dispatch->table;
+    int i;
+
+    if (FixupDispatchTableBulk(dispatch, first, count)) {
+        for (i=first; i<count; i++) {
+            SetDispatchSlot(tbl, i, procAddressList[i] != NULL
+                    ? procAddressList[i] : (void *) noop_func);
+        }
+    } else {
+        for (i=first; i<count; i++) {
+            SetDispatchSlot(tbl, i, LookupDispatchSlot(dispatch, i));
+        }
+    }
+}
+
+/*
+ * Fills in the static slots of a new dispatch table from the on-disk cache. If
+ * there isn't a valid cache file for the vendor library yet, then this asks
+ * the vendor for every function and writes a new cache file.
+ */
+static void FillDispatchTableCached(__GLdispatchTable *dispatch)
+{
+    void **tbl = (void **)dispatch->table;
+    int staticCount = _glapi_get_static_stub_count();
+    unsigned char *filled;
+    int i;
+
+    filled = (unsigned char *) calloc(staticCount, 1);
+    if (filled != NULL && ProcCacheLoad(procCacheDir,
+                dispatch->getProcAddress, dispatch->getProcAddressParam,
+                tbl, staticCount, (void *) noop_func, filled)) {
+        for (i=0; i<staticCount; i++) {
+            if (!filled[i]) {
+                SetDispatchSlot(tbl, i, LookupDispatchSlot(dispatch, i));
+            }
+        }
+    } else {
+        FillDispatchTableRange(dispatch, 0, staticCount);
+        ProcCacheStore(procCacheDir,
+                dispatch->getProcAddress, dispatch->getProcAddressParam,
+                tbl, staticCount, (void *) noop_func);
+    }
+    free(filled);
+}
+
+/*
+ * Returns the table that the dispatch stubs should use for a dispatch table,
+ * which is either the top layer's table or the vendor's table.
+ */
+static inline void **GetTopTable(__GLdispatchTable *dispatch)
+{
+    if (dispatch->numLayerTables > 0) {
+        return (void **) dispatch->layerTables[0];
+    } else {
+        return (void **) dispatch->table;
+    }
+}
+
+/*
+ * Returns the table that a layer should call through.
+ */
+static inline void **GetNextLayerTable(__GLdispatchTable *dispatch, int layer)
+{
+    if (layer + 1 < dispatch->numLayerTables) {
+        return (void **) dispatch->layerTables[layer + 1];
+    } else {
+        return (void **) dispatch->table;
+    }
+}
+
+/*
+ * Fills in the slots from dispatch->stubsPopulated up to \p count in each
+ * layer's table.
+ */
+static GLboolean FixupLayerTables(__GLdispatchTable *dispatch, int count)
+{
+    int layer;
+    int i;
+
+    CheckDispatchLocked();
+
+    if (dispatch->layerTables == NULL) {
+        dispatch->layerTables = (struct _glapi_table **)
+            calloc(numLayers, sizeof(struct _glapi_table *));
+        if (dispatch->layerTables == NULL) {
+            return GL_FALSE;
+        }
+        dispatch->numLayerTables = numLayers;
+    }
+
+    // Start from the bottom, so that each layer can pass slots through to
+    // the table below it.
+    for (layer = dispatch->numLayerTables - 1; layer >= 0; layer--) {
+        const __GLlayerImports *imports = LayersGetImports(layer);
+        void **next = GetNextLayerTable(dispatch, layer);
+        void **tbl;
+
+        if (dispatch->layerTables[layer] == NULL) {
+            dispatch->layerTables[layer] = _glapi_create_table((_glapi_proc) noop_func);
+            if (dispatch->layerTables[layer] == NULL) {
+                return GL_FALSE;
+            }
+        }
+
+        tbl = (void **) dispatch->layerTables[layer];
+        for (i=dispatch->stubsPopulated; i<count; i++) {
+            void *func = (*imports->getProcAddress)(_glapi_get_proc_name(i),
+                    i, imports->param);
+            SetDispatchSlot(tbl, i, func != NULL ? func : next[i]);
+        }
     }
-    assert(dispatch->currentThreads >= 0);
+    return GL_TRUE;
 }
 
 /*
@@ -252,32 +697,183 @@ static GLboolean FixupDispatchTable(__GLdispatchTable *dispatch)
 
     void **tbl;
     int count = _glapi_get_stub_count();
+    int first = dispatch->stubsPopulated;
     int i;
 
     if (dispatch->table == NULL) {
-        dispatch->table = (struct _glapi_table *)
-            calloc(1, _glapi_get_dispatch_table_size() * sizeof(void *));
+        dispatch->table = _glapi_create_table((_glapi_proc) noop_func);
         if (dispatch->table == NULL) {
             return GL_FALSE;
         }
     }
 
     tbl = (void **)dispatch->table;
-    for (i=dispatch->stubsPopulated; i<count; i++) {
-        const char *name = _glapi_get_proc_name(i);
-        void *procAddr;
+    if (lazyDispatchTable) {
+        for (i=first; i<count; i++) {
+            // There aren't any trampolines for the overflow stubs, so look
+            // those up right away.
+            tbl[i] = (void *) trampoline_get_resolve(i);
+            if (tbl[i] == NULL) {
+                tbl[i] = LookupDispatchSlot(dispatch, i);
+            }
+        }
+    } else {
+        if (procCacheDir != NULL && first == 0) {
+            // The static stubs always exist, so count can't be smaller.
+            assert(count >= _glapi_get_static_stub_count());
+            FillDispatchTableCached(dispatch);
+            first = _glapi_get_static_stub_count();
+        }
+        FillDispatchTableRange(dispatch, first, count);
+    }
 
-        assert(name != NULL);
+    if (numLayers > 0 && !FixupLayerTables(dispatch, count)) {
+        return GL_FALSE;
+    }
 
-        procAddr = (void*)(*dispatch->getProcAddress)(
-            name, dispatch->getProcAddressParam);
-        tbl[i] = procAddr ? procAddr : (void *)noop_func;
+    if (countCalls) {
+        void **countTbl;
+        void **top = GetTopTable(dispatch);
+
+        if (dispatch->countTable == NULL) {
+            dispatch->countTable = _glapi_create_table((_glapi_proc) noop_func);
+            if (dispatch->countTable == NULL) {
+                return GL_FALSE;
+            }
+        }
+
+        // The overflow stubs don't have counting trampolines, so those just
+        // go straight to the real function.
+        countTbl = (void **) dispatch->countTable;
+        for (i=dispatch->stubsPopulated; i<count; i++) {
+            countTbl[i] = (void *) trampoline_get_count(i);
+            if (countTbl[i] == NULL) {
+                countTbl[i] = top[i];
+            }
+        }
     }
+
+    // Make sure the table contents are visible before stubsPopulated is,
+    // because MakeCurrent checks stubsPopulated without the dispatch lock.
+    DispatchMemoryBarrier();
     dispatch->stubsPopulated = count;
 
     return GL_TRUE;
 }
 
+/*
+ * Fills in the slots for newly generated stubs in a current dispatch table
+ * with resolver trampolines. Calls to this function must be protected by the
+ * dispatch lock.
+ *
+ * This leaves stubsPopulated alone, so the table still gets fixed up for real
+ * the next time that it's made current. Until then, each trampoline looks up
+ * its function on the first call. That way, generating a stub doesn't have to
+ * call into the vendor library for every current context.
+ *
+ * Returns GL_FALSE if the slots need to be looked up right away instead.
+ */
+static GLboolean FixupDispatchTableLazy(__GLdispatchTable *dispatch,
+        int first, int count)
+{
+    void **tbl = (void **) dispatch->table;
+    int i;
+
+    CheckDispatchLocked();
+
+    // The layer and counting tables would need trampolines of their own.
+    if (!lazyNewStubs || numLayers > 0 || countCalls) {
+        return GL_FALSE;
+    }
+
+    // There aren't any trampolines for the overflow stubs.
+    for (i=first; i<count; i++) {
+        if (trampoline_get_resolve(i) == NULL) {
+            return GL_FALSE;
+        }
+    }
+
+    for (i=first; i<count; i++) {
+        ((void * volatile *) tbl)[i] = (void *) trampoline_get_resolve(i);
+    }
+    return GL_TRUE;
+}
+
+/*
+ * Looks up the function for one slot of a lazily-populated dispatch table.
+ *
+ * This is called from the resolver trampolines. A trampoline is only reachable
+ * through the current thread's dispatch table, so we don't need to take the
+ * dispatch lock to find the table. The name of a stub never changes once the
+ * stub exists, so looking it up without the lock is safe, too.
+ */
+static mapi_func ResolveLazySlot(int slot)
+{
+    __GLdispatchThreadStatePrivate *priv = GetCurrentThreadPrivate();
+    __GLdispatchTable *dispatch = (priv != NULL ? priv->dispatch : NULL);
+    const char *name;
+    void *procAddr = NULL;
+    int i;
+
+    if (dispatch == NULL || dispatch->table == NULL) {
+        assert(!"Resolver trampoline called without a current dispatch table");
+        return (mapi_func) noop_func;
+    }
+
+    name = _glapi_get_proc_name(slot);
+    if (name != NULL) {
+        procAddr = (void *) (*dispatch->getProcAddress)(
+            name, dispatch->getProcAddressParam);
+    }
+    if (procAddr == NULL) {
+        procAddr = (void *) noop_func;
+    }
+
+    // Other threads could be resolving the same slot at the same time, but
+    // they'll all come up with the same function, and a pointer-sized store
+    // is atomic.
+    ((void * volatile *) dispatch->table)[slot] = procAddr;
+
+    // Any layer that passes this slot through got a copy of the trampoline,
+    // so point those at the real function, too.
+    for (i=0; i<dispatch->numLayerTables; i++) {
+        void * volatile *layerTbl = (void * volatile *) dispatch->layerTables[i];
+        if (layerTbl[slot] == (void *) trampoline_get_resolve(slot)) {
+            layerTbl[slot] = procAddr;
+        }
+    }
+
+    return (mapi_func) procAddr;
+}
+
+/*
+ * Counts a call to a slot and returns the real function.
+ *
+ * This is called from the counting trampolines. Like ResolveLazySlot, it can
+ * only be reached through the current thread's dispatch table.
+ */
+static mapi_func CountSlot(int slot)
+{
+    __GLdispatchThreadStatePrivate *priv = GetCurrentThreadPrivate();
+    __GLdispatchTable *dispatch = (priv != NULL ? priv->dispatch : NULL);
+
+    if (dispatch == NULL || dispatch->table == NULL) {
+        assert(!"Counting trampoline called without a current dispatch table");
+        return (mapi_func) noop_func;
+    }
+
+    CallCountsAdd(slot);
+    return (mapi_func) GetTopTable(dispatch)[slot];
+}
+
+PUBLIC GLboolean __glDispatchWriteCallCounts(void)
+{
+    if (!countCalls) {
+        return GL_FALSE;
+    }
+    return (CallCountsWrite() ? GL_TRUE : GL_FALSE);
+}
+
 PUBLIC __GLdispatchProc __glDispatchGetProcAddress(const char *procName)
 {
     int prevCount;
@@ -291,18 +887,33 @@ PUBLIC __GLdispatchProc __glDispatchGetProcAddress(const char *procName)
     prevCount = _glapi_get_stub_count();
     addr = _glapi_get_proc_address(procName);
     if (addr != NULL && prevCount != _glapi_get_stub_count()) {
+        int count = _glapi_get_stub_count();
         __GLdispatchTable *curDispatch;
 
+        /*
+         * A thread in MakeCurrent increments the table's currentThreads
+         * count before it compares stubsPopulated to the stub count, so after
+         * this barrier, either that thread will see the new stub count and
+         * take the dispatch lock, or we'll see that the table is current.
+         */
+        DispatchMemoryBarrier();
+
         /*
          * Fixup any current dispatch tables to contain the right pointer
          * to this proc.
          */
-        glvnd_list_for_each_entry(curDispatch, &currentDispatchList, entry) {
+        glvnd_list_for_each_entry(curDispatch, &dispatchTableList, entry) {
+            if (curDispatch->currentThreads <= 0) {
+                continue;
+            }
+
             // Sanity check: Every current dispatch table must have already
             // been allocated. That's important because it means
             // FixupDispatchTable can't fail.
             assert(curDispatch->table != NULL);
-            FixupDispatchTable(curDispatch);
+            if (!FixupDispatchTableLazy(curDispatch, prevCount, count)) {
+                FixupDispatchTable(curDispatch);
+            }
         }
     }
     UnlockDispatch();
@@ -310,8 +921,75 @@ PUBLIC __GLdispatchProc __glDispatchGetProcAddress(const char *procName)
     return addr;
 }
 
+static void ClearUnknownProcs(void)
+{
+    __GLdispatchUnknownProc *unknown, *tmp;
+
+    CheckDispatchLocked();
+    HASH_ITER(hh, unknownProcHash, unknown, tmp) {
+        HASH_DEL(unknownProcHash, unknown);
+        free(unknown);
+    }
+}
+
+PUBLIC __GLdispatchProc __glDispatchProbeProcAddress(const char *procName,
+        __GLgetProcAddressCallback probe, void *param)
+{
+    __GLdispatchUnknownProc *unknown = NULL;
+    int index;
+
+    LockDispatch();
+    index = _glapi_get_proc_offset(procName);
+    if (index < 0) {
+        HASH_FIND_STR(unknownProcHash, procName, unknown);
+    }
+    UnlockDispatch();
+
+    if (index >= 0) {
+        // There's already a stub, so returning it won't change anything.
+        return __glDispatchGetProcAddress(procName);
+    } else if (unknown != NULL) {
+        return NULL;
+    }
+
+    // Don't hold the dispatch lock while calling into the vendors.
+    if ((*probe)(procName, param) != NULL) {
+        return __glDispatchGetProcAddress(procName);
+    }
+
+    LockDispatch();
+    HASH_FIND_STR(unknownProcHash, procName, unknown);
+    if (unknown == NULL) {
+        size_t len = strlen(procName);
+        unknown = malloc(sizeof(__GLdispatchUnknownProc) + len + 1);
+        if (unknown != NULL) {
+            unknown->name = (char *) (unknown + 1);
+            memcpy(unknown->name, procName, len + 1);
+            HASH_ADD_KEYPTR(hh, unknownProcHash, unknown->name, len, unknown);
+        }
+    }
+    UnlockDispatch();
+
+    return NULL;
+}
+
+PUBLIC void __glDispatchResetProbeCache(void)
+{
+    LockDispatch();
+    ClearUnknownProcs();
+    UnlockDispatch();
+}
+
 PUBLIC __GLdispatchTable *__glDispatchCreateTable(
         __GLgetProcAddressCallback getProcAddress, void *param)
+{
+    return __glDispatchCreateTableBulk(getProcAddress, NULL, param);
+}
+
+PUBLIC __GLdispatchTable *__glDispatchCreateTableBulk(
+        __GLgetProcAddressCallback getProcAddress,
+        __GLgetProcAddressesCallback getProcAddresses,
+        void *param)
 {
     __GLdispatchTable *dispatch = calloc(1, sizeof(__GLdispatchTable));
     if (dispatch == NULL) {
@@ -319,13 +997,20 @@ PUBLIC __GLdispatchTable *__glDispatchCreateTable(
     }
 
     dispatch->getProcAddress = getProcAddress;
+    dispatch->getProcAddresses = getProcAddresses;
     dispatch->getProcAddressParam = param;
 
+    LockDispatch();
+    glvnd_list_add(&dispatch->entry, &dispatchTableList);
+    UnlockDispatch();
+
     return dispatch;
 }
 
 PUBLIC void __glDispatchDestroyTable(__GLdispatchTable *dispatch)
 {
+    int i;
+
     /*
      * XXX: Technically, dispatch->currentThreads should be 0 if we're calling
      * into this function, but buggy apps may unload libGLX without losing
@@ -333,7 +1018,13 @@ PUBLIC void __glDispatchDestroyTable(__GLdispatchTable *dispatch)
      * is destroyed.
      */
     LockDispatch();
-    free(dispatch->table);
+    glvnd_list_del(&dispatch->entry);
+    _glapi_destroy_table(dispatch->table);
+    _glapi_destroy_table(dispatch->countTable);
+    for (i=0; i<dispatch->numLayerTables; i++) {
+        _glapi_destroy_table(dispatch->layerTables[i]);
+    }
+    free(dispatch->layerTables);
     free(dispatch);
     UnlockDispatch();
 }
@@ -380,7 +1071,58 @@ static inline int ContextIsCurrentInAnyOtherThread(void)
     return !!otherContexts;
 }
 
-static int PatchingIsSafe(void)
+/*
+ * Return values for PatchingIsSafe.
+ */
+enum {
+    PATCHING_UNSAFE,
+    PATCHING_SAFE,
+
+    /*
+     * Other threads have current contexts, but they're all using the same
+     * dispatch table as the one that's being made current, so the vendor can
+     * patch the entrypoints if they're switched over atomically.
+     */
+    PATCHING_CONCURRENT,
+};
+
+/*
+ * Checks whether a vendor can patch the entrypoints while other threads have
+ * current contexts.
+ *
+ * Those other threads are still calling through the dispatch table, so
+ * switching them over to the patched entrypoints is only safe if they're
+ * all using the same vendor, if the entrypoints aren't already patched
+ * for some other vendor, and if the vendor says that its patched code works
+ * on a thread that was already current before the patch.
+ */
+static GLboolean ConcurrentPatchingIsSafe(__GLdispatchTable *dispatch,
+        const __GLdispatchPatchCallbacks *patchCb)
+{
+    CheckDispatchLocked();
+
+    if (dispatch == NULL || patchCb == NULL || stubCurrentPatchCb != NULL) {
+        return GL_FALSE;
+    }
+    if (patchCb->initiatePatchConcurrent == NULL) {
+        return GL_FALSE;
+    }
+
+    // This is only called from MakeCurrent, before the new context has taken
+    // its references. A thread in the lockless MakeCurrent path increments
+    // numCurrentContexts before the table's count, so if another thread is
+    // partway through making some other table current, then these won't
+    // match.
+    if (__glDispatchGetCurrentThreadState() != NULL
+            || numCurrentContexts != dispatch->currentThreads) {
+        return GL_FALSE;
+    }
+
+    return GL_TRUE;
+}
+
+static int PatchingIsSafe(__GLdispatchTable *dispatch,
+        const __GLdispatchPatchCallbacks *patchCb)
 {
     CheckDispatchLocked();
 
@@ -388,18 +1130,31 @@ static int PatchingIsSafe(void)
      * Can only patch entrypoints on supported TLS access models
      */
     if (glvnd_list_is_empty(&dispatchStubList)) {
-        return 0;
+        return PATCHING_UNSAFE;
     }
 
     if (PatchingIsDisabledByEnvVar()) {
-        return 0;
+        return PATCHING_UNSAFE;
+    }
+
+    // Patched entrypoints would skip the counting trampolines.
+    if (countCalls) {
+        return PATCHING_UNSAFE;
+    }
+
+    // Patched entrypoints would also skip the layers.
+    if (numLayers > 0) {
+        return PATCHING_UNSAFE;
     }
 
     if (ContextIsCurrentInAnyOtherThread()) {
-        return 0;
+        if (ConcurrentPatchingIsSafe(dispatch, patchCb)) {
+            return PATCHING_CONCURRENT;
+        }
+        return PATCHING_UNSAFE;
     }
 
-    return 1;
+    return PATCHING_SAFE;
 }
 
 typedef struct __GLdispatchStubCallbackRec {
@@ -417,18 +1172,24 @@ typedef struct __GLdispatchStubCallbackRec {
  * This is used in __glDispatchInit to register the libGLdispatch's own stub
  * functions.
  */
-int RegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks)
+int RegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks,
+        size_t size)
 {
     if (callbacks == NULL) {
         return -1;
     }
 
-    __GLdispatchStubCallback *stub = malloc(sizeof(*stub));
+    __GLdispatchStubCallback *stub = calloc(1, sizeof(*stub));
     if (stub == NULL) {
         return -1;
     }
 
-    memcpy(&stub->callbacks, callbacks, sizeof(__GLdispatchStubPatchCallbacks));
+    // An older caller's structure could be smaller than ours, so only copy
+    // what it provided. Anything after that stays NULL.
+    if (size > sizeof(__GLdispatchStubPatchCallbacks)) {
+        size = sizeof(__GLdispatchStubPatchCallbacks);
+    }
+    memcpy(&stub->callbacks, callbacks, size);
     stub->isPatched = GL_FALSE;
 
     stub->id = nextDispatchStubID++;
@@ -439,10 +1200,19 @@ int RegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks)
 }
 
 int __glDispatchRegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks)
+{
+    // This is the size of the structure before any of the optional
+    // callbacks were added.
+    return __glDispatchRegisterStubCallbacksSize(callbacks,
+            offsetof(__GLdispatchStubPatchCallbacks, startPatchConcurrent));
+}
+
+int __glDispatchRegisterStubCallbacksSize(
+        const __GLdispatchStubPatchCallbacks *callbacks, size_t size)
 {
     int ret;
     LockDispatch();
-    ret = RegisterStubCallbacks(callbacks);
+    ret = RegisterStubCallbacks(callbacks, size);
     UnlockDispatch();
     return ret;
 }
@@ -487,26 +1257,44 @@ void UnregisterAllStubCallbacks(void)
  * If the function pointers are NULL, then this attempts to restore the default
  * libglvnd entrypoints.
  *
+ * \p dispatch is the table that's being made current, or NULL if this isn't
+ * called from MakeCurrent.
+ *
  * Returns 1 on success, 0 on failure.
  */
 static int PatchEntrypoints(
    const __GLdispatchPatchCallbacks *patchCb,
    int vendorID,
+   __GLdispatchTable *dispatch,
    GLboolean force
 )
 {
     __GLdispatchStubCallback *stub;
+    int safety = PATCHING_SAFE;
     CheckDispatchLocked();
 
-    if (!force && !PatchingIsSafe()) {
-        return 0;
-    }
-
     if (patchCb == stubCurrentPatchCb) {
         // Entrypoints already using the requested patch; no need to do anything
         return 1;
     }
 
+    /*
+     * Tell any thread in the lockless MakeCurrent path to back off before we
+     * check for current contexts. That thread increments numCurrentContexts
+     * before checking stubPatchPending, so either it sees this flag and takes
+     * the dispatch lock, or PatchingIsSafe sees its context.
+     */
+    stubPatchPending = 1;
+    DispatchMemoryBarrier();
+
+    if (!force) {
+        safety = PatchingIsSafe(dispatch, patchCb);
+        if (safety == PATCHING_UNSAFE) {
+            stubPatchPending = 0;
+            return 0;
+        }
+    }
+
     if (stubCurrentPatchCb) {
         // Notify the previous vendor that it no longer owns these
         // entrypoints. If this is being called from a library unload,
@@ -526,17 +1314,59 @@ static int PatchEntrypoints(
 
         stubCurrentPatchCb = NULL;
         stubOwnerVendorID = 0;
+        stubDirectPatched = 0;
+        stubPatchGeneration++;
     }
 
     if (patchCb) {
         GLboolean anySuccess = GL_FALSE;
+        GLboolean anyReused = GL_FALSE;
+
+        // If the vendor library can reuse its patched entrypoints, then keep
+        // a copy of them, so that switching back to this vendor later is
+        // just a matter of mapping that copy back in.
+        GLboolean saveImages = (safety == PATCHING_SAFE
+                && patchCb->reusePatch != NULL);
+
+        // The generic patcher needs to know which table to look up
+        // functions in.
+        DirectPatchSetTable(dispatch);
 
         glvnd_list_for_each_entry(stub, &dispatchStubList, entry) {
-            if (patchCb->isPatchSupported(stub->callbacks.getStubType(),
+            if (!patchCb->isPatchSupported(stub->callbacks.getStubType(),
                         stub->callbacks.getStubSize()))
             {
-                if (stub->callbacks.startPatch()) {
-                    if (patchCb->initiatePatch(stub->callbacks.getStubType(),
+                if (stub->isPatched) {
+                    // The vendor library can't patch these stubs, but they
+                    // were patched before. Restore them now.
+                    stub->callbacks.restoreFuncs();
+                    stub->isPatched = GL_FALSE;
+                }
+            } else if (safety != PATCHING_CONCURRENT && saveImages
+                    && stub->callbacks.reuseSavedPatch != NULL
+                    && stub->callbacks.reuseSavedPatch(vendorID)) {
+                stub->isPatched = GL_TRUE;
+                anySuccess = GL_TRUE;
+                anyReused = GL_TRUE;
+            } else {
+                GLboolean (*initiate)(int, int, DispatchPatchLookupStubOffset);
+                GLboolean started;
+
+                initiate = patchCb->initiatePatch;
+                if (safety == PATCHING_CONCURRENT) {
+                    initiate = patchCb->initiatePatchConcurrent;
+                    // If these stubs can't be patched concurrently, then
+                    // just leave them alone. They'll still work through the
+                    // dispatch table.
+                    started = (stub->callbacks.startPatchConcurrent != NULL
+                            && stub->callbacks.startPatchConcurrent());
+                } else if (saveImages && stub->callbacks.startPatchSaved != NULL) {
+                    started = stub->callbacks.startPatchSaved(vendorID);
+                } else {
+                    started = stub->callbacks.startPatch();
+                }
+                if (started) {
+                    if (initiate(stub->callbacks.getStubType(),
                                 stub->callbacks.getStubSize(),
                                 stub->callbacks.getPatchOffset)) {
                         stub->callbacks.finishPatch();
@@ -547,112 +1377,296 @@ static int PatchEntrypoints(
                         stub->isPatched = GL_FALSE;
                     }
                 }
-            } else if (stub->isPatched) {
-                // The vendor library can't patch these stubs, but they were
-                // patched before. Restore them now.
-                stub->callbacks.restoreFuncs();
-                stub->isPatched = GL_FALSE;
             }
         }
 
+        DirectPatchSetTable(NULL);
+
+        if (anyReused) {
+            patchCb->reusePatch();
+        }
+
         if (anySuccess) {
             stubCurrentPatchCb = patchCb;
             stubOwnerVendorID = vendorID;
+            stubDirectPatched = DirectPatchIsCallbacks(patchCb);
+            stubPatchGeneration++;
         } else {
             stubCurrentPatchCb = NULL;
             stubOwnerVendorID = 0;
         }
     }
 
+    DispatchMemoryBarrier();
+    stubPatchPending = 0;
+
     return 1;
 }
 
+/**
+ * Returns the private data for the current thread.
+ *
+ * If the current thread doesn't have a private struct yet and \p create is
+ * true, then this will assign one, reusing a struct from a terminated thread
+ * if one is available.
+ */
+static __GLdispatchThreadStatePrivate *GetThreadPrivate(GLboolean create)
+{
+    __GLdispatchThreadStatePrivate *priv = GetCurrentThreadPrivate();
+
+    if (priv != NULL || !create) {
+        return priv;
+    }
+
+#if !USE_LOCKLESS_MAKE_CURRENT
+    LockDispatch();
+#endif
+
+    for (priv = threadStatePrivateList; priv != NULL; priv = priv->next) {
+        if (priv->inUse) {
+            continue;
+        }
+#if USE_LOCKLESS_MAKE_CURRENT
+        if (__sync_bool_compare_and_swap(&priv->inUse, 0, 1)) {
+            break;
+        }
+#else
+        priv->inUse = 1;
+        break;
+#endif
+    }
+
+    if (priv == NULL) {
+        priv = (__GLdispatchThreadStatePrivate *) calloc(1, sizeof(*priv));
+        if (priv != NULL) {
+            priv->inUse = 1;
+#if USE_LOCKLESS_MAKE_CURRENT
+            do {
+                priv->next = threadStatePrivateList;
+            } while (!__sync_bool_compare_and_swap(&threadStatePrivateList,
+                        priv->next, priv));
+#else
+            priv->next = threadStatePrivateList;
+            threadStatePrivateList = priv;
+#endif
+        }
+    }
+
+#if !USE_LOCKLESS_MAKE_CURRENT
+    UnlockDispatch();
+#endif
+
+    if (priv != NULL) {
+        priv->threadState = NULL;
+        priv->dispatch = NULL;
+        priv->vendorID = 0;
+        priv->threadChecked = 0;
+        priv->attachedPatchGeneration = 0;
+        SetCurrentThreadPrivate(priv);
+    }
+    return priv;
+}
+
+/**
+ * Returns the current thread's private struct, or NULL if it doesn't have one.
+ */
+static __GLdispatchThreadStatePrivate *GetCurrentThreadPrivate(void)
+{
+#if defined(GLDISPATCH_USE_TLS)
+    if (threadPrivateTLS.generation == threadPrivateGeneration) {
+        return threadPrivateTLS.priv;
+    }
+    return NULL;
+#else
+    return (__GLdispatchThreadStatePrivate *)
+        __glvndPthreadFuncs.getspecific(threadContextKey);
+#endif
+}
+
+/**
+ * Assigns the current thread's private struct.
+ */
+static void SetCurrentThreadPrivate(__GLdispatchThreadStatePrivate *priv)
+{
+#if defined(GLDISPATCH_USE_TLS)
+    threadPrivateTLS.priv = priv;
+    threadPrivateTLS.generation = threadPrivateGeneration;
+#endif
+    __glvndPthreadFuncs.setspecific(threadContextKey, priv);
+}
+
+/**
+ * Releases a private struct so that another thread can reuse it.
+ */
+static void ReleaseThreadPrivate(__GLdispatchThreadStatePrivate *priv)
+{
+    priv->threadState = NULL;
+    priv->dispatch = NULL;
+    priv->vendorID = 0;
+    DispatchMemoryBarrier();
+    priv->inUse = 0;
+}
+
+#if USE_LOCKLESS_MAKE_CURRENT
+/**
+ * Tries to make a dispatch table current without taking the dispatch lock.
+ *
+ * This only works in the common case, where the dispatch table is already
+ * up to date and we don't need to patch or unpatch any entrypoints.
+ *
+ * If this succeeds, then the dispatch table and context counts have been
+ * incremented. If it fails, then nothing has changed, and the caller should
+ * fall back to the locked path.
+ */
+static GLboolean MakeCurrentNoLock(__GLdispatchTable *dispatch, int vendorID,
+        const __GLdispatchPatchCallbacks *patchCb)
+{
+    /*
+     * Take the references first. Each of these is a full barrier, so anything
+     * that changes the entrypoints or adds a new stub will either see that this
+     * context is current, or we'll see the change below.
+     */
+    DispatchAtomicAdd(&numCurrentContexts, 1);
+    DispatchCurrentRef(dispatch);
+
+    if (!stubPatchPending
+            && patchCb == stubCurrentPatchCb
+            && (!stubOwnerVendorID || vendorID == stubOwnerVendorID)
+            && dispatch->stubsPopulated == _glapi_get_stub_count()) {
+        return GL_TRUE;
+    }
+
+    DispatchCurrentUnref(dispatch);
+    DispatchAtomicAdd(&numCurrentContexts, -1);
+    return GL_FALSE;
+}
+#endif // USE_LOCKLESS_MAKE_CURRENT
+
 PUBLIC GLboolean __glDispatchMakeCurrent(__GLdispatchThreadState *threadState,
                                          __GLdispatchTable *dispatch,
                                          int vendorID,
                                          const __GLdispatchPatchCallbacks *patchCb)
 {
     __GLdispatchThreadStatePrivate *priv;
+    int i;
 
     if (__glDispatchGetCurrentThreadState() != NULL) {
         assert(!"__glDispatchMakeCurrent called with a current API state\n");
         return GL_FALSE;
     }
 
-    priv = (__GLdispatchThreadStatePrivate *) malloc(sizeof(__GLdispatchThreadStatePrivate));
+    priv = GetThreadPrivate(GL_TRUE);
     if (priv == NULL) {
         return GL_FALSE;
     }
 
-    // We need to fix up the dispatch table if it hasn't been
-    // initialized, or there are new dynamic entries which were
-    // added since the last time make current was called.
-    LockDispatch();
+#if USE_LOCKLESS_MAKE_CURRENT
+    if (!MakeCurrentNoLock(dispatch, vendorID, patchCb))
+#endif
+    {
+        // We need to fix up the dispatch table if it hasn't been
+        // initialized, or there are new dynamic entries which were
+        // added since the last time make current was called.
+        LockDispatch();
 
-    // Patch if necessary
-    PatchEntrypoints(patchCb, vendorID, GL_FALSE);
+        // Patch if necessary
+        PatchEntrypoints(patchCb, vendorID, dispatch, GL_FALSE);
 
-    // If the current entrypoints are unsafe to use with this vendor, bail out.
-    if (!CurrentEntrypointsSafeToUse(vendorID)) {
-        UnlockDispatch();
-        free(priv);
-        return GL_FALSE;
-    }
+        // If the current entrypoints are unsafe to use with this vendor, bail out.
+        if (!CurrentEntrypointsSafeToUse(vendorID)) {
+            UnlockDispatch();
+            return GL_FALSE;
+        }
+
+        if (!FixupDispatchTable(dispatch)) {
+            UnlockDispatch();
+            return GL_FALSE;
+        }
+
+        DispatchCurrentRef(dispatch);
+        DispatchAtomicAdd(&numCurrentContexts, 1);
 
-    if (!FixupDispatchTable(dispatch)) {
         UnlockDispatch();
-        free(priv);
-        return GL_FALSE;
     }
 
-    DispatchCurrentRef(dispatch);
-    numCurrentContexts++;
-    glvnd_list_add(&priv->entry, &threadStatePrivateList);
-
     /*
      * Update the API state with the new values.
      */
     priv->dispatch = dispatch;
     priv->vendorID = vendorID;
-    priv->threadState = threadState;
     threadState->priv = priv;
 
-    UnlockDispatch();
-
     /*
-     * Set the current state in TLS.
+     * Set the current state.
      */
-    SetCurrentThreadState(threadState);
-    _glapi_set_current(dispatch->table);
+    priv->threadState = threadState;
+    for (i=0; i<dispatch->numLayerTables; i++) {
+        const __GLlayerImports *imports = LayersGetImports(i);
+        (*imports->setNextTable)(GetNextLayerTable(dispatch, i), imports->param);
+    }
+    _glapi_set_current(countCalls ? dispatch->countTable
+            : (struct _glapi_table *) GetTopTable(dispatch));
 
     return GL_TRUE;
 }
 
+/*
+ * Restores the entrypoints if they're patched with the generic patcher and no
+ * other thread has a current context.
+ *
+ * If another thread still has a context current, then the entrypoints can't
+ * be changed out from under it, so they're left alone until that thread
+ * releases its context, too.
+ */
+static void RestoreDirectPatch(void)
+{
+    LockDispatch();
+    if (DirectPatchIsCallbacks(stubCurrentPatchCb)) {
+        PatchEntrypoints(NULL, 0, NULL, GL_FALSE);
+    }
+    UnlockDispatch();
+}
+
 static void LoseCurrentInternal(__GLdispatchThreadState *curThreadState,
         GLboolean threadDestroyed)
 {
-    LockDispatch();
-    // Note that we don't try to restore the default stubs here. Chances are,
-    // the next MakeCurrent will be from the same vendor, and if we leave them
-    // patched, then we won't have to go through the overhead of patching them
-    // again.
+    // Note that we don't try to restore the default stubs here, unless they
+    // were patched by the generic patcher. Chances are, the next MakeCurrent
+    // will be from the same vendor, and if we leave them patched, then we
+    // won't have to go through the overhead of patching them again.
+    //
+    // The generic patcher jumps straight to the vendor's functions, though,
+    // and those don't have to work without a current context. Restoring those
+    // is cheap anyway, since switching back to the same vendor can just map
+    // in the saved entrypoints again.
 
     if (curThreadState) {
-        numCurrentContexts--;
-        if (curThreadState->priv != NULL) {
-            if (curThreadState->priv->dispatch != NULL) {
-                DispatchCurrentUnref(curThreadState->priv->dispatch);
+        __GLdispatchThreadStatePrivate *priv = curThreadState->priv;
+
+#if !USE_LOCKLESS_MAKE_CURRENT
+        LockDispatch();
+#endif
+        if (priv != NULL) {
+            if (priv->dispatch != NULL) {
+                DispatchCurrentUnref(priv->dispatch);
             }
 
-            glvnd_list_del(&curThreadState->priv->entry);
-            free(curThreadState->priv);
+            priv->threadState = NULL;
+            priv->dispatch = NULL;
+            priv->vendorID = 0;
             curThreadState->priv = NULL;
         }
+        DispatchAtomicAdd(&numCurrentContexts, -1);
+#if !USE_LOCKLESS_MAKE_CURRENT
+        UnlockDispatch();
+#endif
+
+        if (stubDirectPatched) {
+            RestoreDirectPatch();
+        }
     }
-    UnlockDispatch();
 
     if (!threadDestroyed) {
-        SetCurrentThreadState(NULL);
         _glapi_set_current(NULL);
     }
 }
@@ -668,6 +1682,7 @@ PUBLIC void __glDispatchLoseCurrent(void)
 
 PUBLIC GLboolean __glDispatchForceUnpatch(int vendorID)
 {
+    __GLdispatchStubCallback *stub;
     GLboolean ret = GL_FALSE;
 
     LockDispatch();
@@ -682,22 +1697,31 @@ PUBLIC GLboolean __glDispatchForceUnpatch(int vendorID)
          * case, it's just as likely that the other thread would be somewhere
          * in the vendor library itself.
          */
-        PatchEntrypoints(NULL, 0, GL_TRUE);
+        PatchEntrypoints(NULL, 0, NULL, GL_TRUE);
         ret = GL_TRUE;
     }
+
+    // Any entrypoints that we saved for this vendor would point into the
+    // vendor library, so throw them out.
+    glvnd_list_for_each_entry(stub, &dispatchStubList, entry) {
+        if (stub->callbacks.discardSavedPatch != NULL) {
+            stub->callbacks.discardSavedPatch(vendorID);
+        }
+    }
     UnlockDispatch();
 
     return ret;
 }
 
-__GLdispatchThreadState *__glDispatchGetCurrentThreadState(void)
+PUBLIC const __GLdispatchPatchCallbacks *__glDispatchGetDirectPatchCallbacks(void)
 {
-    return (__GLdispatchThreadState *) __glvndPthreadFuncs.getspecific(threadContextKey);
+    return DirectPatchGetCallbacks();
 }
 
-void SetCurrentThreadState(__GLdispatchThreadState *threadState)
+__GLdispatchThreadState *__glDispatchGetCurrentThreadState(void)
 {
-    __glvndPthreadFuncs.setspecific(threadContextKey, threadState);
+    __GLdispatchThreadStatePrivate *priv = GetThreadPrivate(GL_FALSE);
+    return (priv != NULL ? priv->threadState : NULL);
 }
 
 /*
@@ -705,7 +1729,8 @@ void SetCurrentThreadState(__GLdispatchThreadState *threadState)
  */
 void __glDispatchReset(void)
 {
-    __GLdispatchTable *cur, *tmp;
+    __GLdispatchTable *cur;
+    __GLdispatchThreadStatePrivate *priv, *self;
 
     /* Reset the dispatch lock */
     __glvndPthreadFuncs.mutex_init(&dispatchLock.lock, NULL);
@@ -713,17 +1738,32 @@ void __glDispatchReset(void)
 
     LockDispatch();
     /*
-     * Clear out the current dispatch list.
+     * Clear out the current dispatch tables.
      */
-
-    glvnd_list_for_each_entry_safe(cur, tmp, &currentDispatchList, entry) {
+    glvnd_list_for_each_entry(cur, &dispatchTableList, entry) {
         cur->currentThreads = 0;
-        glvnd_list_del(&cur->entry);
+    }
+    numCurrentContexts = 0;
+    stubPatchPending = 0;
+
+    /*
+     * The other threads don't exist in the child process, so release their
+     * private structs for reuse.
+     */
+    self = GetThreadPrivate(GL_FALSE);
+    for (priv = threadStatePrivateList; priv != NULL; priv = priv->next) {
+        if (priv != self) {
+            ReleaseThreadPrivate(priv);
+        }
     }
     UnlockDispatch();
 
     /* Clear GLAPI TLS entries. */
-    SetCurrentThreadState(NULL);
+    if (self != NULL) {
+        self->threadState = NULL;
+        self->dispatch = NULL;
+        self->vendorID = 0;
+    }
     _glapi_set_current(NULL);
 }
 
@@ -743,18 +1783,41 @@ void __glDispatchFini(void)
     clientRefcount--;
 
     if (clientRefcount == 0) {
-        while (!glvnd_list_is_empty(&threadStatePrivateList))
+        while (threadStatePrivateList != NULL)
         {
-            __GLdispatchThreadStatePrivate *priv = glvnd_list_first_entry(&threadStatePrivateList,
-                    __GLdispatchThreadStatePrivate, entry);
-            glvnd_list_del(&priv->entry);
+            __GLdispatchThreadStatePrivate *priv = threadStatePrivateList;
+            threadStatePrivateList = priv->next;
             free(priv);
         }
 
+        free(procNameList);
+        procNameList = NULL;
+        free(procAddressList);
+        procAddressList = NULL;
+        procNameListCount = 0;
+        procNameListCapacity = 0;
+
+        free(procCacheDir);
+        procCacheDir = NULL;
+
+        ClearUnknownProcs();
+
+        if (countCalls) {
+            CallCountsFini();
+            countCalls = GL_FALSE;
+        }
+
+        LayersFini();
+        numLayers = 0;
+
         /* This frees the dispatchStubList */
         UnregisterAllStubCallbacks();
 
         __glvndPthreadFuncs.key_delete(threadContextKey);
+#if defined(GLDISPATCH_USE_TLS)
+        threadPrivateTLS.priv = NULL;
+        threadPrivateGeneration++;
+#endif
 
         // Clean up GLAPI thread state
         _glapi_destroy();
@@ -767,31 +1830,54 @@ void __glDispatchCheckMultithreaded(void)
 {
     if (!__glvndPthreadFuncs.is_singlethreaded)
     {
-        // Check to see if the current thread has a dispatch table assigned to
-        // it, and if it doesn't, then plug in the no-op table.
-        // This is a partial workaround to broken applications that try to call
-        // OpenGL functions without a current context, without adding any
-        // additional overhead to the dispatch stubs themselves. As long as the
-        // thread calls at least one GLX function first, any OpenGL calls will
-        // go to the no-op stubs instead of crashing.
-        if (_glapi_get_current() == NULL) {
-            // Calling _glapi_set_current(NULL) will plug in the no-op table.
-            _glapi_set_current(NULL);
+        __GLdispatchThreadStatePrivate *priv = GetThreadPrivate(GL_TRUE);
+
+        /*
+         * This gets called from every GLX and EGL entrypoint, so in the
+         * common case, we only look at the current thread's private data.
+         * We only need the dispatch lock the first time that we see a
+         * thread, or if the entrypoints have been patched again since this
+         * thread last called threadAttach.
+         */
+        if (priv != NULL && priv->threadChecked
+                && priv->attachedPatchGeneration == stubPatchGeneration) {
+            return;
         }
 
         LockDispatch();
-        if (!isMultiThreaded) {
-            glvnd_thread_t tid = __glvndPthreadFuncs.self();
-            if (__glvndPthreadFuncs.equal(firstThreadId, GLVND_THREAD_NULL)) {
-                firstThreadId = tid;
-            } else if (!__glvndPthreadFuncs.equal(firstThreadId, tid)) {
-                isMultiThreaded = 1;
-                _glapi_set_multithread();
+        if (priv == NULL || !priv->threadChecked) {
+            // Check to see if the current thread has a dispatch table assigned
+            // to it, and if it doesn't, then plug in the no-op table.
+            // This is a partial workaround to broken applications that try to
+            // call OpenGL functions without a current context, without adding
+            // any additional overhead to the dispatch stubs themselves. As
+            // long as the thread calls at least one GLX function first, any
+            // OpenGL calls will go to the no-op stubs instead of crashing.
+            if (_glapi_get_current() == NULL) {
+                // Calling _glapi_set_current(NULL) will plug in the no-op table.
+                _glapi_set_current(NULL);
+            }
+
+            if (!isMultiThreaded) {
+                glvnd_thread_t tid = __glvndPthreadFuncs.self();
+                if (__glvndPthreadFuncs.equal(firstThreadId, GLVND_THREAD_NULL)) {
+                    firstThreadId = tid;
+                } else if (!__glvndPthreadFuncs.equal(firstThreadId, tid)) {
+                    isMultiThreaded = 1;
+                    _glapi_set_multithread();
+                }
             }
         }
 
         if (stubCurrentPatchCb != NULL && stubCurrentPatchCb->threadAttach != NULL) {
-            stubCurrentPatchCb->threadAttach();
+            if (priv == NULL || priv->attachedPatchGeneration != stubPatchGeneration) {
+                stubCurrentPatchCb->threadAttach();
+            }
+        }
+
+        if (priv != NULL) {
+            priv->threadChecked = 1;
+            priv->attachedPatchGeneration = stubPatchGeneration;
         }
         UnlockDispatch();
     }
@@ -800,12 +1886,27 @@ void __glDispatchCheckMultithreaded(void)
 void ThreadDestroyed(void *data)
 {
     if (data != NULL) {
-        __GLdispatchThreadState *threadState = (__GLdispatchThreadState *) data;
-        LoseCurrentInternal(threadState, GL_TRUE);
+        __GLdispatchThreadStatePrivate *priv = (__GLdispatchThreadStatePrivate *) data;
+        __GLdispatchThreadState *threadState = priv->threadState;
 
-        if (threadState->threadDestroyedCallback != NULL) {
-            threadState->threadDestroyedCallback(threadState);
+#if defined(GLDISPATCH_USE_TLS)
+        /*
+         * The pthread key has already been cleared at this point, so clear
+         * the TLS copy to match. That way, another library's thread
+         * destructor won't find a private struct that we've released.
+         */
+        threadPrivateTLS.priv = NULL;
+#endif
+
+        if (threadState != NULL) {
+            LoseCurrentInternal(threadState, GL_TRUE);
+
+            if (threadState->threadDestroyedCallback != NULL) {
+                threadState->threadDestroyedCallback(threadState);
+            }
         }
+
+        ReleaseThreadPrivate(priv);
     }
 }
 
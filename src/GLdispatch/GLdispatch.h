@@ -52,9 +52,11 @@
  * The current version of the ABI between libGLdispatch and the window system
  * libraries.
  *
+ * Version 2 added \c initiatePatchConcurrent to __GLdispatchPatchCallbacks.
+ *
  * \see __glDispatchGetABIVersion
  */
-#define GLDISPATCH_ABI_VERSION 1
+#define GLDISPATCH_ABI_VERSION 2
 
 /* Namespaces for thread state */
 enum {
@@ -71,6 +73,24 @@ typedef void (*__GLdispatchProc)(void);
 
 typedef void *(*__GLgetProcAddressCallback)(const char *procName, void *param);
 
+/**
+ * A callback to look up a range of dispatch table slots at once.
+ *
+ * Both \p procNames and \p procs are indexed by dispatch table slot. The
+ * callback should fill in \c procs[first] through \c procs[first+count-1]
+ * with the vendor's function for each name, or with NULL if the vendor doesn't
+ * support a function.
+ *
+ * The \p procNames array is owned by libGLdispatch and stays the same for as
+ * long as libGLdispatch is loaded, so a vendor library can use it to cache
+ * its results.
+ *
+ * \return GL_TRUE if the vendor filled in the table, or GL_FALSE to fall back
+ * to calling the \c __GLgetProcAddressCallback for each function.
+ */
+typedef GLboolean (*__GLgetProcAddressesCallback)(const char * const *procNames,
+        int first, int count, void **procs, void *param);
+
 /**
  * An opaque structure used for internal thread state data.
  */
@@ -124,8 +144,8 @@ typedef struct __GLdispatchThreadStateRec {
     /*!
      * Private data for this thread state.
      *
-     * This structure is assigned in \c __glDispatchMakeCurrent, and freed in
-     * \c __glDispatchLoseCurrent.
+     * This structure is assigned in \c __glDispatchMakeCurrent, and released
+     * in \c __glDispatchLoseCurrent.
      *
      * The value of this pointer, if any, is an internal detail of
      * libGLdispatch. The window system library should just ignore it.
@@ -203,9 +223,46 @@ typedef struct __GLdispatchPatchCallbacksRec {
      * This function is optional. If it's \c NULL, then libGLdispatch will
      * simply ignore it.
      *
+     * libGLdispatch calls this at most once on each thread while the vendor
+     * library owns the entrypoints: the first time that thread calls a
+     * window-system function after the vendor library patched them.
+     *
      * \note This function may be called concurrently from multiple threads.
      */
     void (*threadAttach)(void);
+
+    /*!
+     * (OPTIONAL) Called instead of \c initiatePatch when libGLdispatch
+     * switches back to entrypoints that the vendor library patched earlier.
+     *
+     * If the vendor library provides this function, then libGLdispatch keeps
+     * a copy of the patched entrypoints after \c releasePatch, so that
+     * switching back to the same vendor doesn't have to patch anything. The
+     * vendor library must keep everything that its patched entrypoints
+     * depend on until it's unloaded.
+     *
+     * If this is \c NULL, then libGLdispatch will call \c initiatePatch every
+     * time.
+     */
+    void (*reusePatch)(void);
+
+    /*!
+     * (OPTIONAL) Called instead of \c initiatePatch to patch the entrypoints
+     * while other threads are already current with this vendor library.
+     *
+     * The parameters are the same as \c initiatePatch. The vendor library's
+     * writes go into a copy of the entrypoints, and libGLdispatch switches
+     * each patched entrypoint over to its new code atomically after this
+     * returns. Any other thread may start running the patched entrypoints at
+     * any time after that, without calling \c threadAttach first, so the
+     * patched code must not depend on any per-thread setup.
+     *
+     * If this is \c NULL, then libGLdispatch only patches the entrypoints
+     * while no other thread has a current context.
+     */
+    GLboolean (*initiatePatchConcurrent)(int type,
+                                         int stubSize,
+                                         DispatchPatchLookupStubOffset lookupStubOffset);
 } __GLdispatchPatchCallbacks;
 
 /*!
@@ -251,6 +308,62 @@ PUBLIC int __glDispatchNewVendorID(void);
  */
 PUBLIC __GLdispatchProc __glDispatchGetProcAddress(const char *procName);
 
+/*!
+ * Like \c __glDispatchGetProcAddress, but only generates a new dispatch stub
+ * if some vendor library supports the function.
+ *
+ * If there isn't a stub for \p procName already, then this calls \p probe to
+ * ask whether any vendor supports it. If \p probe returns NULL, then this
+ * returns NULL without taking up a dispatch table slot, and remembers the name
+ * so that later calls can return NULL without calling \p probe again.
+ *
+ * The caller should call \c __glDispatchResetProbeCache if the set of vendor
+ * libraries that \p probe checks changes.
+ */
+PUBLIC __GLdispatchProc __glDispatchProbeProcAddress(const char *procName,
+        __GLgetProcAddressCallback probe, void *param);
+
+/*!
+ * Forgets the names that \c __glDispatchProbeProcAddress found no vendor
+ * support for.
+ */
+PUBLIC void __glDispatchResetProbeCache(void);
+
+/*!
+ * Writes the per-function call counts to the file named by the
+ * __GLVND_CALL_COUNTS_FILE environment variable.
+ *
+ * The counts are also written when GLdispatch is torn down, so this is only
+ * needed to get a snapshot while the process is still running.
+ *
+ * \return GL_TRUE if call counting is enabled and the file was written.
+ */
+PUBLIC GLboolean __glDispatchWriteCallCounts(void);
+
+/*!
+ * Returns a set of patch callbacks that rewrite the entrypoints to jump
+ * straight to a vendor library's functions.
+ *
+ * This is for vendor libraries that don't patch the entrypoints themselves,
+ * but whose functions work for any of their contexts. The entrypoints are
+ * restored when the last current context is released. A window-system
+ * library can make its own copy of these callbacks for each such vendor, and
+ * pass that to \c __glDispatchMakeCurrent.
+ *
+ * The functions come from the \c getProcAddress callback of the dispatch
+ * table that's being made current.
+ */
+PUBLIC const __GLdispatchPatchCallbacks *__glDispatchGetDirectPatchCallbacks(void);
+
+/*!
+ * Returns how the dispatch stubs in libGLdispatch find the current dispatch
+ * table, as one of the \c __GLDISPATCH_STUB_MODE_* values.
+ *
+ * Depending on how libglvnd was built, this might not be known until
+ * libGLdispatch is loaded.
+ */
+PUBLIC int __glDispatchGetStubMode(void);
+
 /*!
  * Create a new dispatch table in GLdispatch. This reference hangs off the
  * client GLX or EGL context, and is passed into GLdispatch during make current.
@@ -266,6 +379,25 @@ PUBLIC __GLdispatchTable *__glDispatchCreateTable(
     void *param
 );
 
+/*!
+ * Create a new dispatch table, using a callback that can look up a whole range
+ * of functions at once.
+ *
+ * This is the same as \c __glDispatchCreateTable, except that GLdispatch will
+ * try \p getProcAddresses first when it needs to fill in the table.
+ *
+ * \param[in] getProcAddress a callback to look up a single function.
+ * \param[in] getProcAddresses a callback to look up a range of functions. This
+ * may be NULL.
+ * \param[in] param A pointer to pass to \p getProcAddress and
+ * \p getProcAddresses.
+ */
+PUBLIC __GLdispatchTable *__glDispatchCreateTableBulk(
+    __GLgetProcAddressCallback getProcAddress,
+    __GLgetProcAddressesCallback getProcAddresses,
+    void *param
+);
+
 /*!
  * Destroy a dispatch table in GLdispatch.
  */
@@ -37,8 +37,12 @@
  * and updating dispatch tables.
  */
 struct __GLdispatchTableRec {
-    /*! Number of threads this dispatch is current on */
-    int currentThreads;
+    /*!
+     * Number of threads this dispatch is current on. This is updated with
+     * atomic operations, since MakeCurrent and LoseCurrent don't always take
+     * the dispatch lock.
+     */
+    int volatile currentThreads;
 
     /*!
      * The number of dispatch table entries that have been populated. This is
@@ -48,12 +52,28 @@ struct __GLdispatchTableRec {
 
     /*! Saved vendor library callbacks */
     __GLgetProcAddressCallback getProcAddress;
+    __GLgetProcAddressesCallback getProcAddresses;
     void *getProcAddressParam;
 
     /*! The real dispatch table */
     struct _glapi_table *table;
 
-    /*! List handle */
+    /*!
+     * The table that's made current instead of \c table when call counting is
+     * enabled. Each slot is a counting trampoline that calls into \c table.
+     */
+    struct _glapi_table *countTable;
+
+    /*!
+     * The table for each layer, starting with the one closest to the
+     * application. Each layer's table has the layer's own functions, and
+     * passes any other slots through to the next table down, ending with
+     * \c table.
+     */
+    struct _glapi_table **layerTables;
+    int numLayerTables;
+
+    /*! List handle for the list of all dispatch tables */
     struct glvnd_list entry;
 };
 
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "call_counts.h"
+#include "glapi.h"
+#include "glvnd_pthread.h"
+#include "utils_misc.h"
+#include "cJSON.h"
+
+typedef struct CallCountThreadRec {
+    unsigned long long *counts;
+    struct CallCountThreadRec *next;
+} CallCountThread;
+
+static int callCountSlots;
+static char *callCountPath;
+static glvnd_key_t callCountKey;
+
+/*
+ * Every thread that has made a counted call, in reverse order. The counters
+ * are kept after a thread exits, so that they still show up in the output.
+ * Adding to this list needs the lock, but each thread only touches its own
+ * counters.
+ */
+static CallCountThread *callCountThreads;
+static glvnd_mutex_t callCountLock = GLVND_MUTEX_INITIALIZER;
+
+int CallCountsInit(const char *path, int slotCount)
+{
+    callCountPath = strdup(path);
+    if (callCountPath == NULL) {
+        return 0;
+    }
+    if (__glvndPthreadFuncs.key_create(&callCountKey, NULL) != 0) {
+        free(callCountPath);
+        callCountPath = NULL;
+        return 0;
+    }
+    callCountSlots = slotCount;
+    return 1;
+}
+
+void CallCountsFini(void)
+{
+    if (callCountPath == NULL) {
+        return;
+    }
+
+    CallCountsWrite();
+
+    while (callCountThreads != NULL) {
+        CallCountThread *thr = callCountThreads;
+        callCountThreads = thr->next;
+        free(thr->counts);
+        free(thr);
+    }
+    __glvndPthreadFuncs.key_delete(callCountKey);
+    free(callCountPath);
+    callCountPath = NULL;
+}
+
+static CallCountThread *AddThread(void)
+{
+    CallCountThread *thr = malloc(sizeof(CallCountThread));
+    if (thr == NULL) {
+        return NULL;
+    }
+
+    // This is big enough that calloc will usually get fresh pages from mmap,
+    // so only the pages for slots that actually get called use any memory.
+    thr->counts = calloc(callCountSlots, sizeof(unsigned long long));
+    if (thr->counts == NULL) {
+        free(thr);
+        return NULL;
+    }
+
+    __glvndPthreadFuncs.mutex_lock(&callCountLock);
+    thr->next = callCountThreads;
+    callCountThreads = thr;
+    __glvndPthreadFuncs.mutex_unlock(&callCountLock);
+
+    __glvndPthreadFuncs.setspecific(callCountKey, thr);
+    return thr;
+}
+
+void CallCountsAdd(int slot)
+{
+    CallCountThread *thr = (CallCountThread *)
+        __glvndPthreadFuncs.getspecific(callCountKey);
+
+    if (thr == NULL) {
+        thr = AddThread();
+        if (thr == NULL) {
+            return;
+        }
+    }
+    if (slot >= 0 && slot < callCountSlots) {
+        thr->counts[slot]++;
+    }
+}
+
+static char *GetOutputPath(void)
+{
+    const char *pid = strstr(callCountPath, "%p");
+    char *path;
+
+    if (pid == NULL) {
+        return strdup(callCountPath);
+    }
+    if (glvnd_asprintf(&path, "%.*s%d%s", (int) (pid - callCountPath),
+                callCountPath, (int) getpid(), pid + 2) < 0) {
+        return NULL;
+    }
+    return path;
+}
+
+/*
+ * Adds an object to \p parent with a member for every non-zero count.
+ */
+static cJSON *AddCounts(cJSON *parent, const char *name,
+        const unsigned long long *counts)
+{
+    cJSON *node = cJSON_CreateObject();
+    int i;
+
+    if (node == NULL) {
+        return NULL;
+    }
+    if (parent->type == cJSON_Array) {
+        cJSON_AddItemToArray(parent, node);
+    } else {
+        cJSON_AddItemToObject(parent, name, node);
+    }
+
+    for (i=0; i<callCountSlots; i++) {
+        const char *procName;
+        if (counts[i] == 0) {
+            continue;
+        }
+        procName = _glapi_get_proc_name(i);
+        if (procName != NULL) {
+            cJSON_AddNumberToObject(node, procName, (double) counts[i]);
+        }
+    }
+    return node;
+}
+
+int CallCountsWrite(void)
+{
+    CallCountThread *thr;
+    unsigned long long *totals = NULL;
+    cJSON *root = NULL;
+    cJSON *threads;
+    char *text = NULL;
+    char *path = NULL;
+    FILE *out = NULL;
+    int ret = 0;
+    int i;
+
+    if (callCountPath == NULL) {
+        return 0;
+    }
+
+    __glvndPthreadFuncs.mutex_lock(&callCountLock);
+
+    totals = calloc(callCountSlots, sizeof(unsigned long long));
+    root = cJSON_CreateObject();
+    if (totals == NULL || root == NULL) {
+        goto done;
+    }
+
+    // Other threads may still be making calls, so these counts may be a bit
+    // out of date.
+    threads = cJSON_CreateArray();
+    if (threads == NULL) {
+        goto done;
+    }
+    cJSON_AddItemToObject(root, "threads", threads);
+    for (thr = callCountThreads; thr != NULL; thr = thr->next) {
+        if (AddCounts(threads, NULL, thr->counts) == NULL) {
+            goto done;
+        }
+        for (i=0; i<callCountSlots; i++) {
+            totals[i] += thr->counts[i];
+        }
+    }
+    if (AddCounts(root, "total", totals) == NULL) {
+        goto done;
+    }
+
+    text = cJSON_Print(root);
+    path = GetOutputPath();
+    if (text == NULL || path == NULL) {
+        goto done;
+    }
+
+    out = fopen(path, "w");
+    if (out == NULL) {
+        goto done;
+    }
+    if (fputs(text, out) >= 0 && fputc('\n', out) != EOF) {
+        ret = 1;
+    }
+    if (fclose(out) != 0) {
+        ret = 0;
+    }
+
+done:
+    __glvndPthreadFuncs.mutex_unlock(&callCountLock);
+    free(path);
+    free(text);
+    cJSON_Delete(root);
+    free(totals);
+    return ret;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#ifndef CALL_COUNTS_H
+#define CALL_COUNTS_H
+
+/**
+ * \file
+ *
+ * Per-thread counters for calls to each dispatch table slot.
+ *
+ * When call counting is enabled, libGLdispatch makes a wrapper table current
+ * instead of the vendor's dispatch table. Each slot of the wrapper table is a
+ * counting trampoline, which calls \c CallCountsAdd and then jumps to the
+ * vendor's function.
+ *
+ * The counts are written out as JSON, with one object for each thread that
+ * made any calls, plus the totals for every thread.
+ */
+
+/**
+ * Enables call counting.
+ *
+ * \param path The file to write the counts to. Any "%p" in the path is
+ *      replaced with the process ID.
+ * \param slotCount The number of slots to count.
+ * \return Non-zero on success.
+ */
+int CallCountsInit(const char *path, int slotCount);
+
+/**
+ * Writes the counts and frees everything.
+ */
+void CallCountsFini(void);
+
+/**
+ * Increments the count for a slot in the current thread.
+ *
+ * This doesn't take any locks, except on the first call in each thread.
+ */
+void CallCountsAdd(int slot);
+
+/**
+ * Writes the current counts to the file.
+ *
+ * \return Non-zero on success.
+ */
+int CallCountsWrite(void);
+
+#endif // CALL_COUNTS_H
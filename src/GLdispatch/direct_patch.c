@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include "direct_patch.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "GLdispatchPrivate.h"
+#include "glapi.h"
+
+static __GLdispatchTable *directTable = NULL;
+
+static GLboolean DirectIsPatchSupported(int type, int stubSize)
+{
+    // Every stub has to have room for the longest jump, not counting the
+    // endbr instruction.
+    switch (type) {
+        case __GLDISPATCH_STUB_X86_64:
+        case __GLDISPATCH_STUB_X32:
+            return (stubSize >= 13);
+        case __GLDISPATCH_STUB_X86:
+            return (stubSize >= 9);
+        default:
+            return GL_FALSE;
+    }
+}
+
+static void DirectWriteJump(int type, int stubSize, unsigned char *writePtr,
+        const unsigned char *execPtr, const void *func)
+{
+    const unsigned char endbr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+    const unsigned char endbr32[] = { 0xf3, 0x0f, 0x1e, 0xfb };
+    uint64_t target = (uint64_t) ((uintptr_t) func);
+    int64_t rel;
+    GLboolean nearJump;
+
+    // Use a direct jmp if the function is close enough. On x86, it always is.
+    rel = (int64_t) target - (int64_t) ((uintptr_t) (execPtr + 4 + 5));
+    nearJump = (type == __GLDISPATCH_STUB_X86 || (rel >= INT32_MIN && rel <= INT32_MAX));
+
+    // The endbr instruction is a nop on any CPU without CET, so it's always
+    // safe to include. The only time it doesn't fit is an indirect jump in
+    // a compact 16-byte stub, which only matters with IBT enabled.
+    if (type == __GLDISPATCH_STUB_X86) {
+        memcpy(writePtr, endbr32, sizeof(endbr32));
+        writePtr += 4;
+    } else if (nearJump || stubSize >= 17) {
+        memcpy(writePtr, endbr64, sizeof(endbr64));
+        writePtr += 4;
+    }
+
+    if (nearJump) {
+        int32_t rel32 = (int32_t) rel;
+        writePtr[0] = 0xe9;     // jmp rel32
+        memcpy(writePtr + 1, &rel32, sizeof(rel32));
+    } else {
+        writePtr[0] = 0x49;     // movabs $target, %r11
+        writePtr[1] = 0xbb;
+        memcpy(writePtr + 2, &target, sizeof(target));
+        writePtr[10] = 0x41;    // jmp *%r11
+        writePtr[11] = 0xff;
+        writePtr[12] = 0xe3;
+    }
+}
+
+static GLboolean DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset)
+{
+    int count = _glapi_get_stub_count();
+    int i;
+
+    if (directTable == NULL || !DirectIsPatchSupported(type, stubSize)) {
+        return GL_FALSE;
+    }
+
+    for (i=0; i<count; i++) {
+        const char *name = _glapi_get_proc_name(i);
+        void *writePtr;
+        const void *execPtr;
+        void *func;
+
+        if (name == NULL) {
+            continue;
+        }
+
+        // If the vendor doesn't support a function, then leave its stub
+        // alone, so that it still goes through the dispatch table to a no-op.
+        // Don't even look up the stub in that case, since looking it up can
+        // mean that we're about to replace it.
+        func = (*directTable->getProcAddress)(name,
+                directTable->getProcAddressParam);
+        if (func == NULL || !lookupStubOffset(name, &writePtr, &execPtr)) {
+            continue;
+        }
+
+        DirectWriteJump(type, stubSize, (unsigned char *) writePtr,
+                (const unsigned char *) execPtr, func);
+    }
+    return GL_TRUE;
+}
+
+static void DirectReusePatch(void)
+{
+    // The jumps only depend on the vendor's functions, which stay valid until
+    // the vendor library is unloaded.
+}
+
+static const __GLdispatchPatchCallbacks directPatchCallbacks = {
+    DirectIsPatchSupported, // isPatchSupported
+    DirectInitiatePatch,    // initiatePatch
+    NULL,                   // releasePatch
+    NULL,                   // threadAttach
+    DirectReusePatch,       // reusePatch
+};
+
+const __GLdispatchPatchCallbacks *DirectPatchGetCallbacks(void)
+{
+    return &directPatchCallbacks;
+}
+
+GLboolean DirectPatchIsCallbacks(const __GLdispatchPatchCallbacks *patchCb)
+{
+    // Each vendor has its own copy of the callbacks, so check one of the
+    // functions instead of the pointer. The caller might wrap initiatePatch
+    // or reusePatch to keep track of them, but it has no reason to replace
+    // isPatchSupported.
+    return (patchCb != NULL && patchCb->isPatchSupported == DirectIsPatchSupported);
+}
+
+void DirectPatchSetTable(__GLdispatchTable *dispatch)
+{
+    directTable = dispatch;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#ifndef DIRECT_PATCH_H
+#define DIRECT_PATCH_H
+
+/**
+ * \file
+ *
+ * A generic entrypoint patcher for vendor libraries that don't patch the
+ * entrypoints themselves.
+ *
+ * Each patched entrypoint is just a jump straight to the function that the
+ * vendor library's getProcAddress callback returns for it, skipping the TLS
+ * lookup and the dispatch table.
+ *
+ * Since those functions might not work without a current context, the
+ * patched entrypoints are restored once no thread has a current context.
+ */
+
+#include "GLdispatch.h"
+
+/**
+ * Returns the patch callbacks for the generic patcher.
+ */
+const __GLdispatchPatchCallbacks *DirectPatchGetCallbacks(void);
+
+/**
+ * Returns GL_TRUE if \p patchCb is a copy of the generic patcher's callbacks.
+ */
+GLboolean DirectPatchIsCallbacks(const __GLdispatchPatchCallbacks *patchCb);
+
+/**
+ * Sets the dispatch table that the generic patcher looks up functions in.
+ *
+ * This must be called with the dispatch lock held, before any call to the
+ * patch callbacks' \c initiatePatch.
+ */
+void DirectPatchSetTable(__GLdispatchTable *dispatch);
+
+#endif // DIRECT_PATCH_H
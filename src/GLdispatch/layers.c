@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+
+#include "layers.h"
+#include "utils_misc.h"
+#include "config_files.h"
+
+#define FILE_FORMAT_VERSION_MAJOR 1
+#define FILE_FORMAT_VERSION_MINOR 0
+
+typedef struct GLdispatchLayerRec {
+    void *dlhandle;
+    __GLlayerImports imports;
+} GLdispatchLayer;
+
+static GLdispatchLayer *layerList;
+static int layerCount;
+
+static void LoadLayerFromConfigFile(const char *filename);
+
+int LayersInit(void)
+{
+    const char *env = NULL;
+    char **tokens;
+    int i;
+
+    // Layers are only ever loaded by request, and never for a setuid or
+    // setgid process.
+    if (getuid() != geteuid() || getgid() != getegid()) {
+        return 0;
+    }
+
+    env = getenv("__GLVND_LAYER_FILENAMES");
+    if (env != NULL) {
+        tokens = SplitString(env, NULL, ":");
+        if (tokens != NULL) {
+            for (i=0; tokens[i] != NULL; i++) {
+                LoadLayerFromConfigFile(tokens[i]);
+            }
+            free(tokens);
+        }
+        return layerCount;
+    }
+
+    env = getenv("__GLVND_LAYER_DIRS");
+    if (env != NULL) {
+        tokens = SplitString(env, NULL, ":");
+        if (tokens != NULL) {
+            for (i=0; tokens[i] != NULL; i++) {
+                ForEachConfigFile(tokens[i], LoadLayerFromConfigFile);
+            }
+            free(tokens);
+        }
+    }
+    return layerCount;
+}
+
+void LayersFini(void)
+{
+    int i;
+
+    for (i=0; i<layerCount; i++) {
+        if (layerList[i].imports.teardown != NULL) {
+            layerList[i].imports.teardown(layerList[i].imports.param);
+        }
+        dlclose(layerList[i].dlhandle);
+    }
+    free(layerList);
+    layerList = NULL;
+    layerCount = 0;
+}
+
+const __GLlayerImports *LayersGetImports(int index)
+{
+    return &layerList[index].imports;
+}
+
+static void LoadLayer(const char *libraryPath, const char *jsonPath)
+{
+    GLdispatchLayer layer;
+    GLdispatchLayer *list;
+    __PFNGLLAYERMAINPROC layerMain;
+    char *filename = NULL;
+
+    memset(&layer, 0, sizeof(layer));
+
+    // If the library path is relative, then it's relative to the manifest,
+    // the same as for the EGL vendor files.
+    if (strchr(libraryPath, '/') != NULL && libraryPath[0] != '/') {
+        const char *slash = strrchr(jsonPath, '/');
+        if (slash != NULL) {
+            if (glvnd_asprintf(&filename, "%.*s/%s", (int) (slash - jsonPath),
+                        jsonPath, libraryPath) < 0) {
+                return;
+            }
+            libraryPath = filename;
+        }
+    }
+
+    layer.dlhandle = dlopen(libraryPath, RTLD_LAZY);
+    free(filename);
+    if (layer.dlhandle == NULL) {
+        return;
+    }
+
+    layerMain = (__PFNGLLAYERMAINPROC) dlsym(layer.dlhandle,
+            __GL_LAYER_MAIN_PROTO_NAME);
+    if (layerMain == NULL || !layerMain(GL_LAYER_ABI_VERSION, &layer.imports)
+            || layer.imports.getProcAddress == NULL
+            || layer.imports.setNextTable == NULL) {
+        dlclose(layer.dlhandle);
+        return;
+    }
+
+    list = (GLdispatchLayer *) realloc(layerList,
+            (layerCount + 1) * sizeof(GLdispatchLayer));
+    if (list == NULL) {
+        if (layer.imports.teardown != NULL) {
+            layer.imports.teardown(layer.imports.param);
+        }
+        dlclose(layer.dlhandle);
+        return;
+    }
+    layerList = list;
+    layerList[layerCount++] = layer;
+}
+
+static void LoadLayerFromConfigFile(const char *filename)
+{
+    cJSON *root;
+    cJSON *node;
+    cJSON *layerNode;
+
+    root = ReadJSONFile(filename);
+    if (root == NULL) {
+        return;
+    }
+
+    node = cJSON_GetObjectItem(root, "file_format_version");
+    if (node == NULL || node->type != cJSON_String
+            || !CheckConfigFormatVersion(node->valuestring,
+                FILE_FORMAT_VERSION_MAJOR, FILE_FORMAT_VERSION_MINOR)) {
+        goto done;
+    }
+
+    layerNode = cJSON_GetObjectItem(root, "layer");
+    if (layerNode == NULL || layerNode->type != cJSON_Object) {
+        goto done;
+    }
+
+    node = cJSON_GetObjectItem(layerNode, "library_path");
+    if (node == NULL || node->type != cJSON_String) {
+        goto done;
+    }
+    LoadLayer(node->valuestring, filename);
+
+done:
+    cJSON_Delete(root);
+}
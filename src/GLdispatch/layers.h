@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#ifndef LAYERS_H
+#define LAYERS_H
+
+/**
+ * \file
+ *
+ * Loads the GL dispatch layers listed in JSON manifest files.
+ *
+ * See libgllayerabi.h for the manifest format and the environment variables
+ * that select the layers.
+ */
+
+#include "glvnd/libgllayerabi.h"
+
+/**
+ * Loads every layer that's listed in the environment.
+ *
+ * \return The number of layers that were loaded.
+ */
+int LayersInit(void);
+
+/**
+ * Tears down and unloads all of the layers.
+ */
+void LayersFini(void);
+
+/**
+ * Returns the callbacks for a layer. Layer 0 is the closest to the
+ * application.
+ */
+const __GLlayerImports *LayersGetImports(int index);
+
+#endif // LAYERS_H
@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "proc_cache.h"
+#include "glapi.h"
+#include "trace.h"
+#include "utils_misc.h"
+
+#define PROC_CACHE_MAGIC "GLVNDPC"
+#define PROC_CACHE_VERSION 1
+
+/**
+ * The maximum number of distinct shared objects that a cache file can refer
+ * to. Functions in any other objects just don't get cached.
+ */
+#define PROC_CACHE_MAX_OBJECTS 16
+
+#define PROC_CACHE_MAX_BUILD_ID 64
+
+/// An entry for a slot that the vendor doesn't support.
+#define PROC_CACHE_ENTRY_NULL ((uint32_t) 0xFFFFFFFF)
+
+/// An entry for a slot that has to be looked up at runtime.
+#define PROC_CACHE_ENTRY_UNCACHED ((uint32_t) 0xFFFFFFFE)
+
+/// The name of the function used to find the vendor library.
+#define PROC_CACHE_ANCHOR_NAME "glGetString"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pointerSize;
+    uint64_t stubHash;
+    uint32_t slotCount;
+    uint32_t objectCount;
+} ProcCacheHeader;
+
+typedef struct {
+    uint32_t buildIdSize;
+    uint8_t buildId[PROC_CACHE_MAX_BUILD_ID];
+    uint32_t reserved;
+
+    /// The size of the object's address range, used to validate offsets.
+    uint64_t size;
+} ProcCacheObject;
+
+typedef struct {
+    /// An index into the object list, or one of the PROC_CACHE_ENTRY_* values.
+    uint32_t object;
+    uint32_t reserved;
+
+    /// The offset of the function from the object's base address.
+    uint64_t offset;
+} ProcCacheEntry;
+
+/**
+ * A shared object that's loaded in this process.
+ */
+typedef struct {
+    /// The load bias of the object. Offsets are relative to this.
+    uintptr_t base;
+
+    /// The end of the highest loadable segment.
+    uintptr_t end;
+
+    /// The start of the lowest loadable segment.
+    uintptr_t start;
+
+    uint32_t buildIdSize;
+    uint8_t buildId[PROC_CACHE_MAX_BUILD_ID];
+} LoadedObject;
+
+typedef struct {
+    uintptr_t addr;
+    const uint8_t *buildId;
+    uint32_t buildIdSize;
+    LoadedObject *result;
+    int found;
+} FindObjectParam;
+
+static int GetBuildId(const struct dl_phdr_info *info, LoadedObject *obj)
+{
+    int i;
+
+    for (i=0; i<info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        const char *ptr, *end;
+
+        if (phdr->p_type != PT_NOTE) {
+            continue;
+        }
+
+        ptr = (const char *) (info->dlpi_addr + phdr->p_vaddr);
+        end = ptr + phdr->p_memsz;
+        while (ptr + sizeof(ElfW(Nhdr)) <= end) {
+            const ElfW(Nhdr) *note = (const ElfW(Nhdr) *) ptr;
+            const char *name = ptr + sizeof(ElfW(Nhdr));
+            const char *desc = name + ((note->n_namesz + 3) & ~3);
+
+            ptr = desc + ((note->n_descsz + 3) & ~3);
+            if (ptr > end) {
+                break;
+            }
+
+            if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4
+                    && memcmp(name, "GNU", 4) == 0
+                    && note->n_descsz > 0
+                    && note->n_descsz <= PROC_CACHE_MAX_BUILD_ID) {
+                obj->buildIdSize = note->n_descsz;
+                memcpy(obj->buildId, desc, note->n_descsz);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void GetObjectRange(const struct dl_phdr_info *info, LoadedObject *obj)
+{
+    int i;
+
+    obj->base = info->dlpi_addr;
+    obj->start = UINTPTR_MAX;
+    obj->end = 0;
+    for (i=0; i<info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type == PT_LOAD) {
+            uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+            uintptr_t end = start + phdr->p_memsz;
+            if (start < obj->start) {
+                obj->start = start;
+            }
+            if (end > obj->end) {
+                obj->end = end;
+            }
+        }
+    }
+}
+
+static int FindObjectCallback(struct dl_phdr_info *info, size_t size, void *data)
+{
+    FindObjectParam *param = (FindObjectParam *) data;
+    LoadedObject obj;
+
+    (void) size;
+
+    GetObjectRange(info, &obj);
+    if (obj.start >= obj.end) {
+        return 0;
+    }
+
+    if (param->buildId == NULL) {
+        if (param->addr < obj.start || param->addr >= obj.end) {
+            return 0;
+        }
+        // Stop looking either way, since nothing else can contain this
+        // address.
+        if (GetBuildId(info, &obj)) {
+            *param->result = obj;
+            param->found = 1;
+        }
+        return 1;
+    } else {
+        if (!GetBuildId(info, &obj) || obj.buildIdSize != param->buildIdSize
+                || memcmp(obj.buildId, param->buildId, obj.buildIdSize) != 0) {
+            return 0;
+        }
+        *param->result = obj;
+        param->found = 1;
+        return 1;
+    }
+}
+
+/**
+ * Finds the loaded object that contains an address. Returns zero if there
+ * isn't one, or if it doesn't have a build ID.
+ */
+static int FindObjectByAddress(const void *addr, LoadedObject *obj)
+{
+    FindObjectParam param = { (uintptr_t) addr, NULL, 0, obj, 0 };
+    dl_iterate_phdr(FindObjectCallback, &param);
+    return param.found;
+}
+
+static int FindObjectByBuildId(const uint8_t *buildId, uint32_t buildIdSize,
+        LoadedObject *obj)
+{
+    FindObjectParam param = { 0, buildId, buildIdSize, obj, 0 };
+    dl_iterate_phdr(FindObjectCallback, &param);
+    return param.found;
+}
+
+/**
+ * Finds the vendor library and returns the name of its cache file, without
+ * the directory.
+ */
+static char *GetCacheFile(__GLgetProcAddressCallback getProcAddress, void *param,
+        int count, LoadedObject *vendor, void **anchor, int *anchorSlot)
+{
+    char buildIdStr[PROC_CACHE_MAX_BUILD_ID * 2 + 1];
+    char *name;
+    uint32_t i;
+
+    *anchorSlot = _glapi_get_proc_offset(PROC_CACHE_ANCHOR_NAME);
+    if (*anchorSlot < 0 || *anchorSlot >= count) {
+        return NULL;
+    }
+
+    *anchor = (*getProcAddress)(PROC_CACHE_ANCHOR_NAME, param);
+    if (*anchor == NULL || !FindObjectByAddress(*anchor, vendor)) {
+        return NULL;
+    }
+
+    for (i=0; i<vendor->buildIdSize; i++) {
+        snprintf(buildIdStr + i * 2, 3, "%02x", vendor->buildId[i]);
+    }
+
+    if (glvnd_asprintf(&name, "%s-%016llx.cache", buildIdStr,
+                _glapi_get_static_stub_hash()) < 0) {
+        return NULL;
+    }
+    return name;
+}
+
+/**
+ * Checks that a cache file or directory belongs to the current user, and
+ * that nobody else can write to it.
+ */
+static int IsPrivateToUser(const struct stat *st)
+{
+    return (st->st_uid == geteuid() && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0);
+}
+
+GLboolean ProcCacheLoad(const char *dir,
+        __GLgetProcAddressCallback getProcAddress, void *param,
+        void **procs, int count, void *noop, unsigned char *filled)
+{
+    LoadedObject vendor;
+    LoadedObject objects[PROC_CACHE_MAX_OBJECTS];
+    const ProcCacheHeader *header;
+    const ProcCacheObject *records;
+    const ProcCacheEntry *entries;
+    void *anchor;
+    int anchorSlot;
+    char *name;
+    struct stat st;
+    void *map = MAP_FAILED;
+    size_t expectedSize;
+    GLboolean ret = GL_FALSE;
+    int dirFd = -1;
+    int fd = -1;
+    uint32_t i;
+
+    name = GetCacheFile(getProcAddress, param, count, &vendor,
+            &anchor, &anchorSlot);
+    if (name == NULL) {
+        return GL_FALSE;
+    }
+
+    // Anyone who can change the cache file can point the dispatch table at
+    // any code in a loaded library, so ignore it unless both it and its
+    // directory belong to us and nobody else can write to them.
+    dirFd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0 || fstat(dirFd, &st) != 0 || !IsPrivateToUser(&st)) {
+        goto done;
+    }
+    fd = openat(dirFd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+            || !IsPrivateToUser(&st)
+            || st.st_size < (off_t) sizeof(ProcCacheHeader)) {
+        goto done;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        goto done;
+    }
+
+    header = (const ProcCacheHeader *) map;
+    if (memcmp(header->magic, PROC_CACHE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != PROC_CACHE_VERSION
+            || header->pointerSize != sizeof(void *)
+            || header->stubHash != _glapi_get_static_stub_hash()
+            || header->slotCount != (uint32_t) count
+            || header->objectCount < 1
+            || header->objectCount > PROC_CACHE_MAX_OBJECTS) {
+        goto done;
+    }
+
+    expectedSize = sizeof(ProcCacheHeader)
+        + header->objectCount * sizeof(ProcCacheObject)
+        + header->slotCount * sizeof(ProcCacheEntry);
+    if ((size_t) st.st_size != expectedSize) {
+        goto done;
+    }
+    records = (const ProcCacheObject *) (header + 1);
+    entries = (const ProcCacheEntry *) (records + header->objectCount);
+
+    // The first object is always the vendor library itself.
+    if (records[0].buildIdSize != vendor.buildIdSize
+            || memcmp(records[0].buildId, vendor.buildId, vendor.buildIdSize) != 0) {
+        goto done;
+    }
+
+    for (i=0; i<header->objectCount; i++) {
+        if (records[i].buildIdSize == 0
+                || records[i].buildIdSize > PROC_CACHE_MAX_BUILD_ID) {
+            goto done;
+        }
+        if (i == 0) {
+            objects[i] = vendor;
+        } else if (!FindObjectByBuildId(records[i].buildId,
+                    records[i].buildIdSize, &objects[i])) {
+            goto done;
+        }
+        if (records[i].size != objects[i].end - objects[i].base) {
+            goto done;
+        }
+    }
+
+    // Validate every entry before we change anything in the table.
+    for (i=0; i<header->slotCount; i++) {
+        if (entries[i].object < header->objectCount) {
+            if (entries[i].offset >= records[entries[i].object].size) {
+                goto done;
+            }
+        } else if (entries[i].object != PROC_CACHE_ENTRY_NULL
+                && entries[i].object != PROC_CACHE_ENTRY_UNCACHED) {
+            goto done;
+        }
+    }
+
+    // As a final sanity check, make sure that the cache agrees with the vendor
+    // library about the function that we already looked up.
+    if (entries[anchorSlot].object >= header->objectCount
+            || (void *) (objects[entries[anchorSlot].object].base
+                + entries[anchorSlot].offset) != anchor) {
+        goto done;
+    }
+
+    for (i=0; i<header->slotCount; i++) {
+        if (entries[i].object < header->objectCount) {
+            procs[i] = (void *) (objects[entries[i].object].base
+                    + (uintptr_t) entries[i].offset);
+            filled[i] = 1;
+        } else if (entries[i].object == PROC_CACHE_ENTRY_NULL) {
+            // Don't write to slots that are already set, so that the
+            // table's pages of no-op functions can stay shared.
+            if (procs[i] != noop) {
+                procs[i] = noop;
+            }
+            filled[i] = 1;
+        } else {
+            filled[i] = 0;
+        }
+    }
+    ret = GL_TRUE;
+
+done:
+    DBG_PRINTF(20, "Loading cache file %s/%s: %s\n", dir, name, ret ? "success" : "failed");
+    if (map != MAP_FAILED) {
+        munmap(map, st.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (dirFd >= 0) {
+        close(dirFd);
+    }
+    free(name);
+    return ret;
+}
+
+static int WriteAll(int fd, const void *data, size_t size)
+{
+    const char *ptr = (const char *) data;
+    while (size > 0) {
+        ssize_t written = write(fd, ptr, size);
+        if (written <= 0) {
+            return 0;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return 1;
+}
+
+void ProcCacheStore(const char *dir,
+        __GLgetProcAddressCallback getProcAddress, void *param,
+        void * const *procs, int count, void *noop)
+{
+    LoadedObject objects[PROC_CACHE_MAX_OBJECTS];
+    ProcCacheObject records[PROC_CACHE_MAX_OBJECTS];
+    ProcCacheHeader header;
+    ProcCacheEntry *entries = NULL;
+    uint32_t objectCount = 1;
+    void *anchor;
+    int anchorSlot;
+    char *name;
+    char *path = NULL;
+    char *tempPath = NULL;
+    int fd = -1;
+    int i;
+    uint32_t j;
+
+    name = GetCacheFile(getProcAddress, param, count, &objects[0],
+            &anchor, &anchorSlot);
+    if (name == NULL) {
+        return;
+    }
+    if (glvnd_asprintf(&path, "%s/%s", dir, name) < 0) {
+        path = NULL;
+        goto done;
+    }
+
+    entries = (ProcCacheEntry *) calloc(count, sizeof(ProcCacheEntry));
+    if (entries == NULL) {
+        goto done;
+    }
+
+    for (i=0; i<count; i++) {
+        uintptr_t addr = (uintptr_t) procs[i];
+
+        if (procs[i] == NULL || procs[i] == noop) {
+            entries[i].object = PROC_CACHE_ENTRY_NULL;
+            continue;
+        }
+
+        for (j=0; j<objectCount; j++) {
+            if (addr >= objects[j].start && addr < objects[j].end) {
+                break;
+            }
+        }
+        if (j >= objectCount) {
+            if (objectCount < PROC_CACHE_MAX_OBJECTS
+                    && FindObjectByAddress(procs[i], &objects[objectCount])) {
+                j = objectCount++;
+            } else {
+                entries[i].object = PROC_CACHE_ENTRY_UNCACHED;
+                continue;
+            }
+        }
+        entries[i].object = j;
+        entries[i].offset = addr - objects[j].base;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROC_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROC_CACHE_VERSION;
+    header.pointerSize = sizeof(void *);
+    header.stubHash = _glapi_get_static_stub_hash();
+    header.slotCount = count;
+    header.objectCount = objectCount;
+
+    memset(records, 0, sizeof(records));
+    for (j=0; j<objectCount; j++) {
+        records[j].buildIdSize = objects[j].buildIdSize;
+        memcpy(records[j].buildId, objects[j].buildId, objects[j].buildIdSize);
+        records[j].size = objects[j].end - objects[j].base;
+    }
+
+    // Write to a temporary file and then rename it, so that other processes
+    // never see a partially written file.
+    mkdir(dir, 0700);
+    if (glvnd_asprintf(&tempPath, "%s/.glvnd-cache-XXXXXX", dir) < 0) {
+        tempPath = NULL;
+        goto done;
+    }
+    fd = mkstemp(tempPath);
+    if (fd < 0) {
+        goto done;
+    }
+    if (!WriteAll(fd, &header, sizeof(header))
+            || !WriteAll(fd, records, objectCount * sizeof(ProcCacheObject))
+            || !WriteAll(fd, entries, count * sizeof(ProcCacheEntry))) {
+        goto done;
+    }
+    if (close(fd) != 0) {
+        fd = -1;
+        goto done;
+    }
+    fd = -1;
+
+    if (rename(tempPath, path) == 0) {
+        DBG_PRINTF(20, "Wrote cache file %s\n", path);
+        free(tempPath);
+        tempPath = NULL;
+    }
+
+done:
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (tempPath != NULL) {
+        unlink(tempPath);
+        free(tempPath);
+    }
+    free(entries);
+    free(path);
+    free(name);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#ifndef PROC_CACHE_H
+#define PROC_CACHE_H
+
+/**
+ * \file
+ *
+ * An on-disk cache of the functions that a vendor library returns for the
+ * static dispatch table slots.
+ *
+ * Each function is stored as an offset from the base address of whatever
+ * shared object it lives in, along with that object's ELF build ID. A cache
+ * file is named after the build ID of the vendor library and a hash of the
+ * static stub names, so a different vendor library or a different build of
+ * libGLdispatch will simply use a different file.
+ *
+ * The vendor library is identified by looking up glGetString, which every
+ * vendor has to provide, and finding the object that it lives in.
+ */
+
+#include "GLdispatch.h"
+
+/**
+ * Fills in the static slots of a dispatch table from the cache.
+ *
+ * The cache file is ignored if it's a symlink, or if either it or \p dir
+ * belongs to a different user or is writable by anyone else.
+ *
+ * \param dir The cache directory.
+ * \param getProcAddress The vendor's getProcAddress callback.
+ * \param param The parameter for \p getProcAddress.
+ * \param[out] procs The dispatch table.
+ * \param count The number of static slots.
+ * \param noop The function to store for slots that the vendor doesn't
+ *      support.
+ * \param[out] filled An array of \p count flags. Each one is set to non-zero
+ *      if the slot was filled in from the cache. Slots that couldn't be cached
+ *      still need to be looked up.
+ * \return GL_TRUE if the cache was valid and loaded.
+ */
+GLboolean ProcCacheLoad(const char *dir,
+        __GLgetProcAddressCallback getProcAddress, void *param,
+        void **procs, int count, void *noop, unsigned char *filled);
+
+/**
+ * Writes a cache file for a dispatch table.
+ *
+ * The parameters are the same as for \c ProcCacheLoad. The first \p count
+ * slots of \p procs must already be filled in.
+ */
+void ProcCacheStore(const char *dir,
+        __GLgetProcAddressCallback getProcAddress, void *param,
+        void * const *procs, int count, void *noop);
+
+#endif // PROC_CACHE_H
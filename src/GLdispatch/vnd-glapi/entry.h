@@ -35,6 +35,12 @@ typedef void (*mapi_func)(void);
 extern const int entry_type;
 extern const int entry_stub_size;
 
+/**
+ * Returns how the stubs find the current dispatch table, as one of the
+ * \c __GLDISPATCH_STUB_MODE_* values.
+ */
+int entry_get_stub_mode(void);
+
 /**
  * Returns the address of an entrypoint.
  *
@@ -89,4 +95,118 @@ int entry_patch_finish(void);
  */
 void *entry_get_patch_address(int index);
 
+/**
+ * Returns the address that a vendor library should write a patched stub to.
+ *
+ * During a patch started with \c entry_patch_start_image, this points into a
+ * separate writable mapping of the new image. Otherwise, it's the same as
+ * \c entry_get_patch_address.
+ *
+ * \param int The index of the entrypoint to patch.
+ * \return The address to write the new stub to.
+ */
+void *entry_get_patch_write_address(int index);
+
+/**
+ * Starts patching the entrypoints while other threads might be running them.
+ *
+ * Instead of writing to the entrypoints directly, the vendor library writes
+ * into a separate copy, which \c entry_patch_finish_concurrent then switches
+ * to one stub at a time. Every thread sees either the old or the new version
+ * of each stub, never a mix.
+ *
+ * \return Non-zero on success, or zero if concurrent patching isn't
+ *      supported.
+ */
+int entry_patch_start_concurrent(void);
+
+/**
+ * Returns the address that a vendor library should write a stub to during a
+ * concurrent patch. This is also the address that the patched stub will run
+ * from.
+ */
+void *entry_get_concurrent_patch_address(int index);
+
+/**
+ * Switches each entrypoint that was looked up with
+ * \c entry_get_concurrent_patch_address over to the patched stub.
+ *
+ * A stub that was looked up but never written is left alone.
+ *
+ * \return Non-zero on success. On failure, the entrypoints are unchanged.
+ */
+int entry_patch_finish_concurrent(void);
+
+/**
+ * Discards a concurrent patch without changing the entrypoints.
+ */
+void entry_patch_abort_concurrent(void);
+
+/**
+ * Starts patching into a new saved image of the entrypoints.
+ *
+ * The image starts out as a copy of the original stubs. The vendor library
+ * writes to it through \c entry_get_patch_write_address, and the entrypoints
+ * themselves are never writable. \c entry_patch_finish_image then maps the
+ * image over the entrypoints. After that, \c entry_switch_image can switch
+ * back to it with a single mmap call, without patching anything.
+ *
+ * This must only be called while the entrypoints are unpatched. Any image
+ * that was already saved for \p owner is discarded.
+ *
+ * \param owner A non-zero ID for the vendor library that's patching.
+ * \return Non-zero on success, or zero if saved images aren't supported. On
+ *      failure, the entrypoints are unchanged.
+ */
+int entry_patch_start_image(int owner);
+
+/**
+ * Called after the vendor library finishes patching a saved image.
+ *
+ * \return Non-zero on success, zero on failure.
+ */
+int entry_patch_finish_image(void);
+
+/**
+ * Discards the image from \c entry_patch_start_image, and switches back to
+ * the original entrypoints.
+ */
+void entry_patch_abort_image(void);
+
+/**
+ * Maps a saved image over the entrypoints.
+ *
+ * \param owner The owner that was passed to \c entry_patch_start_image, or
+ *      zero for the original entrypoints.
+ * \return Non-zero on success, or zero if there's no image for \p owner.
+ */
+int entry_switch_image(int owner);
+
+/**
+ * Discards the saved image for \p owner, if there is one. The image must not
+ * be mapped over the entrypoints.
+ */
+void entry_discard_image(int owner);
+
+/**
+ * Frees all of the saved images.
+ */
+void entry_cleanup_images(void);
+
+/**
+ * Returns the entrypoint for a dynamic stub past the end of the assembly
+ * entrypoints, generating it if necessary.
+ *
+ * \param slot The slot in the dispatch table. This must be at least
+ *      \c MAPI_TABLE_NUM_SLOTS.
+ * \return The entrypoint, or NULL if it can't be generated or if this isn't
+ *      supported on the current architecture.
+ */
+mapi_func entry_get_overflow(int slot);
+
+/**
+ * Frees any entrypoints that were generated by \c entry_get_overflow.
+ */
+void entry_cleanup_overflow(void);
+
 #endif /* _ENTRY_H_ */
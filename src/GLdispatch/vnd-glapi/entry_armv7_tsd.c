@@ -142,12 +142,17 @@ __asm__(".thumb\n\t");
 const int entry_type = __GLDISPATCH_STUB_ARMV7_ARM;
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TSD;
+}
+
 // Note: The rest of these functions could also be used for ARMv7 TLS stubs,
 // once those are implemented.
 
 mapi_func
 entry_get_public(int index)
 {
-    return (mapi_func)(public_entry_start + (index * entry_stub_size));
+    return (mapi_func)(public_entry_start + entry_get_stub_offset(index));
 }
 
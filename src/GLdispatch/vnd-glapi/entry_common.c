@@ -25,20 +25,51 @@
  *    Kyle Brenneman <kbrenneman@nvidia.com>
  */
 
+#define _GNU_SOURCE 1
+
 #include "entry.h"
 #include "entry_common.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <sys/types.h>
 #include <unistd.h>
 #include <assert.h>
 
 #include "glapi.h"
+#include "table.h"
 #include "u_macros.h"
 #include "u_current.h"
 #include "utils_misc.h"
 
+#if GLDISPATCH_ENABLE_PATCHING && defined(USE_X86_64_ASM) && !defined(__ILP32__) \
+    && defined(GLDISPATCH_USE_TLS) && defined(HAVE_LINUX_MEMBARRIER_H) \
+    && defined(HAVE_MEMFD_CREATE) \
+    && !defined(GLDISPATCH_COMPACT_STUBS) && !defined(GLDISPATCH_RUNTIME_STUBS)
+#define USE_CONCURRENT_PATCH 1
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+#if GLDISPATCH_ENABLE_PATCHING && defined(HAVE_MEMFD_CREATE)
+#define USE_PATCH_IMAGES 1
+#endif
+
+#define MAPI_TMP_STUB_POSITIONS
+#include "mapi_tmp.h"
+
+size_t entry_get_stub_offset(int index)
+{
+#if defined(MAPI_STUB_POSITIONS_REORDERED)
+    if (index >= 0 && index < ARRAY_LEN(public_stub_positions)) {
+        index = public_stub_positions[index];
+    }
+#endif
+    return ((size_t) index) * entry_stub_size;
+}
+
 static int entry_patch_mprotect(int prot)
 {
 #if GLDISPATCH_ENABLE_PATCHING
@@ -80,9 +111,376 @@ int entry_patch_finish(void)
 
 void *entry_get_patch_address(int index)
 {
-    return (void *) (public_entry_start + (index * entry_stub_size));
+    return (void *) (public_entry_start + entry_get_stub_offset(index));
+}
+
+#if defined(USE_PATCH_IMAGES)
+static void *entry_get_image_write_address(int index);
+static int ImageFind(int owner);
+static int ImageAdd(int owner);
+#endif
+
+void *entry_get_patch_write_address(int index)
+{
+#if defined(USE_PATCH_IMAGES)
+    void *addr = entry_get_image_write_address(index);
+    if (addr != NULL) {
+        return addr;
+    }
+#endif
+    return entry_get_patch_address(index);
+}
+
+#if defined(USE_CONCURRENT_PATCH)
+
+/*
+ * Concurrent patching for the x86-64 TLS stubs.
+ *
+ * Each stub is 32 bytes, and looks like this, with the endbr64 only in a CET
+ * build:
+ *
+ *      endbr64
+ *      movq _glapi_tls_Current@GOTTPOFF(%rip), %rax
+ *      movq %fs:(%rax), %r11
+ *      jmp *(8 * slot)(%r11)
+ *
+ * The code ends at most 22 bytes in, and the rest of the stub is padding.
+ * The compact 16-byte stubs don't have any padding, so this isn't available
+ * with those.
+ *
+ * The vendor library writes its stubs into a separate image, which is never
+ * modified once any thread can run it. Then, for each patched stub:
+ *
+ * 1. Write "jmp *target(%rip)" into the padding, where target holds the
+ *    address of the new stub in the image. No thread ever runs the padding,
+ *    so this is safe to write non-atomically.
+ * 2. Use membarrier to make every other thread serialize its instruction
+ *    stream, so that none of them can have a stale copy of the padding.
+ * 3. With a single aligned two-byte store, replace the start of the first
+ *    movq with a short jump to the padding.
+ * 4. Use membarrier again, so that every thread sees the new stub right away.
+ *
+ * The entrypoints are never writable while other threads can run them.
+ * Instead, before step 1, a copy of the entrypoints in a memfd is mapped
+ * read/exec over them. The contents are the same, so any thread running
+ * them doesn't notice. Steps 1 and 3 then write through a separate
+ * write-only mapping of the same file. The read/exec mapping is
+ * MAP_PRIVATE, so it still sees those writes, but restoring the stubs
+ * later doesn't write back into the file, and neither process writes into
+ * the other's entrypoints after a fork.
+ *
+ * The store in step 3 is the only change to any instruction that a thread
+ * could be running. A thread that's stopped partway through the old stub will
+ * either resume at the first movq, which now jumps to the new stub, or at one
+ * of the later instructions, which are unchanged, so it just finishes the old
+ * stub and goes through the dispatch table.
+ *
+ * Restoring the original stubs is only done when no other thread has a
+ * current context, so that can just copy the saved stubs back.
+ */
+
+#if defined(__CET__)
+#define CONCURRENT_REDIRECT_OFFSET 4
+#else
+#define CONCURRENT_REDIRECT_OFFSET 0
+#endif
+#define CONCURRENT_DETOUR_OFFSET 24
+#define CONCURRENT_DETOUR_SIZE 6
+
+/*
+ * The new stub address for each patched entrypoint. This has to be close
+ * enough to the stubs for a 32-bit RIP-relative offset, so it's a static array
+ * instead of part of the image.
+ */
+static const void *concurrentTargets[MAPI_TABLE_NUM_SLOTS];
+
+/*
+ * The image that the current or most recent concurrent patch was written
+ * into. Other threads may still be running it, so it isn't freed until the
+ * original stubs are restored.
+ */
+static unsigned char *concurrentImage;
+static size_t concurrentImageSize;
+static unsigned char *concurrentPatched;
+static int concurrentImageLive;
+
+/*
+ * A memfd with a copy of the entrypoints, which entry_patch_finish_concurrent
+ * maps over them.
+ */
+static int concurrentLiveFd = -1;
+
+/*
+ * 1 if membarrier's SYNC_CORE command is available and registered, -1 if
+ * it isn't, or 0 if we haven't checked yet.
+ */
+static int membarrierState;
+
+static int ConcurrentSyncCores(void)
+{
+    return (syscall(__NR_membarrier,
+                MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE, 0) == 0);
+}
+
+static int ConcurrentInitMembarrier(void)
+{
+    if (membarrierState == 0) {
+        long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+        membarrierState = -1;
+        if (cmds > 0
+                && (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE)
+                && syscall(__NR_membarrier,
+                    MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE, 0) == 0) {
+            membarrierState = 1;
+        }
+    }
+    return (membarrierState > 0);
+}
+
+static void ConcurrentFreeImage(void)
+{
+    if (concurrentImage != NULL) {
+        munmap(concurrentImage, concurrentImageSize);
+        concurrentImage = NULL;
+    }
+    free(concurrentPatched);
+    concurrentPatched = NULL;
+    concurrentImageLive = 0;
+    if (concurrentLiveFd >= 0) {
+        close(concurrentLiveFd);
+        concurrentLiveFd = -1;
+    }
+}
+
+/*
+ * Copies the entrypoints into a new memfd.
+ */
+static int ConcurrentCreateLiveFile(size_t size)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    void *ptr;
+    int fd;
+
+    if (((uintptr_t) public_entry_start) % pageSize != 0 || size % pageSize != 0) {
+        return -1;
+    }
+
+    fd = memfd_create("glvnd-entrypoints", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, size) != 0
+            || pwrite(fd, public_entry_start, size, 0) != (ssize_t) size) {
+        close(fd);
+        return -1;
+    }
+
+    // Make sure that we can execute it. A failed mmap with MAP_FIXED could
+    // leave the entrypoints unmapped, so check with a separate mapping first.
+    ptr = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    munmap(ptr, size);
+    return fd;
+}
+
+int entry_patch_start_concurrent(void)
+{
+    size_t size = ((uintptr_t) public_entry_end) - ((uintptr_t) public_entry_start);
+    size_t count = size / entry_stub_size;
+
+    if (concurrentImageLive || !ConcurrentInitMembarrier()) {
+        return 0;
+    }
+    if (count > MAPI_TABLE_NUM_SLOTS) {
+        count = MAPI_TABLE_NUM_SLOTS;
+    }
+
+    ConcurrentFreeImage();
+    concurrentImage = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (concurrentImage == MAP_FAILED) {
+        concurrentImage = NULL;
+        return 0;
+    }
+    concurrentImageSize = size;
+
+    concurrentPatched = (unsigned char *) calloc(count, 1);
+    if (concurrentPatched == NULL) {
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    concurrentLiveFd = ConcurrentCreateLiveFile(size);
+    if (concurrentLiveFd < 0) {
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    // Save the original stubs as an image too, so that they can be restored
+    // without making the entrypoints writable.
+    if (ImageFind(0) < 0 && ImageAdd(0) < 0) {
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    // Fill the image with int3, so that anything the vendor doesn't write
+    // will trap instead of running off into the next stub. This also lets
+    // entry_patch_finish_concurrent tell which stubs were written.
+    memset(concurrentImage, 0xCC, size);
+    return 1;
+}
+
+void *entry_get_concurrent_patch_address(int index)
+{
+    assert(concurrentImage != NULL);
+    assert(index >= 0 && index < MAPI_TABLE_NUM_SLOTS);
+
+    concurrentPatched[index] = 1;
+    return concurrentImage + entry_get_stub_offset(index);
+}
+
+/*
+ * Returns non-zero if the vendor wrote anything into a stub in the image.
+ *
+ * A vendor library can look up a stub and then not patch it (for example,
+ * if it doesn't support that function). That stub is still all int3, and it
+ * has to keep going through the dispatch table.
+ */
+static int ConcurrentStubWritten(size_t index)
+{
+    const unsigned char *stub = concurrentImage + entry_get_stub_offset(index);
+    size_t i;
+
+    for (i=0; i<entry_stub_size; i++) {
+        if (stub[i] != 0xCC) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int entry_patch_finish_concurrent(void)
+{
+    size_t count = concurrentImageSize / entry_stub_size;
+    unsigned char *writeView;
+    void *live;
+    size_t i;
+
+    if (count > MAPI_TABLE_NUM_SLOTS) {
+        count = MAPI_TABLE_NUM_SLOTS;
+    }
+
+    // Only redirect the stubs that actually got written, not every stub that
+    // the vendor looked up.
+    for (i=0; i<count; i++) {
+        if (concurrentPatched[i] && !ConcurrentStubWritten(i)) {
+            concurrentPatched[i] = 0;
+        }
+    }
+
+    if (mprotect(concurrentImage, concurrentImageSize, PROT_READ | PROT_EXEC) != 0) {
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    writeView = mmap(NULL, concurrentImageSize, PROT_WRITE, MAP_SHARED,
+            concurrentLiveFd, 0);
+    if (writeView == MAP_FAILED) {
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    // The file has the same contents as the entrypoints, so other threads
+    // can keep running them across this.
+    live = mmap(public_entry_start, concurrentImageSize, PROT_READ | PROT_EXEC,
+            MAP_PRIVATE | MAP_FIXED, concurrentLiveFd, 0);
+    if (live == MAP_FAILED) {
+        munmap(writeView, concurrentImageSize);
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    for (i=0; i<count; i++) {
+        unsigned char *stub;
+        unsigned char *liveStub;
+        int32_t rel;
+
+        if (!concurrentPatched[i]) {
+            continue;
+        }
+
+        concurrentTargets[i] = concurrentImage + entry_get_stub_offset(i);
+        stub = writeView + entry_get_stub_offset(i);
+        liveStub = (unsigned char *) public_entry_start + entry_get_stub_offset(i);
+        rel = (int32_t) ((intptr_t) &concurrentTargets[i]
+                - (intptr_t) (liveStub + CONCURRENT_DETOUR_OFFSET + CONCURRENT_DETOUR_SIZE));
+        stub[CONCURRENT_DETOUR_OFFSET] = 0xff;      // jmp *rel(%rip)
+        stub[CONCURRENT_DETOUR_OFFSET + 1] = 0x25;
+        memcpy(stub + CONCURRENT_DETOUR_OFFSET + 2, &rel, sizeof(rel));
+    }
+
+    if (!ConcurrentSyncCores()) {
+        // Nothing has jumped to the padding yet, so we can still back out.
+        munmap(writeView, concurrentImageSize);
+        ConcurrentFreeImage();
+        return 0;
+    }
+
+    for (i=0; i<count; i++) {
+        unsigned char jump[2] = { 0xeb,     // jmp rel8
+            CONCURRENT_DETOUR_OFFSET - (CONCURRENT_REDIRECT_OFFSET + 2) };
+        uint16_t value;
+
+        if (!concurrentPatched[i]) {
+            continue;
+        }
+
+        memcpy(&value, jump, sizeof(value));
+        __atomic_store_n((uint16_t *) (writeView
+                    + entry_get_stub_offset(i) + CONCURRENT_REDIRECT_OFFSET),
+                value, __ATOMIC_RELEASE);
+    }
+
+    ConcurrentSyncCores();
+    munmap(writeView, concurrentImageSize);
+    close(concurrentLiveFd);
+    concurrentLiveFd = -1;
+    concurrentImageLive = 1;
+    return 1;
+}
+
+void entry_patch_abort_concurrent(void)
+{
+    ConcurrentFreeImage();
 }
 
+#else // defined(USE_CONCURRENT_PATCH)
+
+int entry_patch_start_concurrent(void)
+{
+    return 0;
+}
+
+void *entry_get_concurrent_patch_address(int index)
+{
+    assert(!"This should never be called");
+    return NULL;
+}
+
+int entry_patch_finish_concurrent(void)
+{
+    return 0;
+}
+
+void entry_patch_abort_concurrent(void)
+{
+}
+
+#endif // defined(USE_CONCURRENT_PATCH)
+
 void *entry_save_entrypoints(void)
 {
     size_t size = ((uintptr_t) public_entry_end) - ((uintptr_t) public_entry_start);
@@ -141,5 +539,349 @@ void entry_restore_entrypoints(void *saved)
     size_t size = ((uintptr_t) public_entry_end) - ((uintptr_t) public_entry_start);
     memcpy(public_entry_start, saved, size);
     InvalidateCache();
+
+#if defined(USE_CONCURRENT_PATCH)
+    // Nothing can be running the old patched stubs anymore.
+    ConcurrentFreeImage();
+#endif
+}
+
+
+#if defined(USE_PATCH_IMAGES)
+
+/*
+ * Saved images of the entrypoints.
+ *
+ * Each image is a copy of the whole entrypoint region, stored in a memfd so
+ * that it can be mapped over the real entrypoints with a single mmap call.
+ * Image 0 is a copy of the original stubs, and every other image holds the
+ * stubs that some vendor library patched.
+ *
+ * The vendor library writes a new image through a separate read/write
+ * mapping of the file, while the entrypoints themselves stay read/exec the
+ * whole time. Nothing is ever mapped as both writable and executable, so this
+ * works even where a W^X policy would make entry_patch_start fail.
+ *
+ * Once an image is finished, it never changes, and it's always mapped with
+ * MAP_PRIVATE. That way, patching the entrypoints in place afterward won't
+ * write back into the file, and a child process after a fork can keep
+ * mapping the images that it inherited. New images always go into a file
+ * that the current process created, though.
+ */
+typedef struct EntryImageRec {
+    int owner;
+    int fd;
+    off_t offset;
+} EntryImage;
+
+static EntryImage *images;
+static int numImages;
+
+/*
+ * The owner of the image that's being patched, or 0 if there isn't one.
+ */
+static int patchImageOwner;
+
+/*
+ * A writable mapping of the image that's being patched.
+ */
+static unsigned char *patchImageWriteView;
+
+/*
+ * The file that new images are added to, and the process that created it.
+ */
+static int imageFd = -1;
+static pid_t imageFdPid;
+static off_t imageFdSize;
+
+static size_t ImageGetSize(void)
+{
+    return ((uintptr_t) public_entry_end) - ((uintptr_t) public_entry_start);
+}
+
+static int ImageFind(int owner)
+{
+    int i;
+    for (i=0; i<numImages; i++) {
+        if (images[i].owner == owner) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int ImageMap(const EntryImage *image, int prot, int flags)
+{
+    void *ptr = mmap(public_entry_start, ImageGetSize(), prot,
+            flags | MAP_FIXED, image->fd, image->offset);
+    if (ptr == MAP_FAILED) {
+        return 0;
+    }
+    InvalidateCache();
+    return 1;
+}
+
+static int ImageCheckMapping(int fd, int prot, int flags)
+{
+    void *ptr = mmap(NULL, ImageGetSize(), prot, flags, fd, 0);
+    if (ptr == MAP_FAILED) {
+        return 0;
+    }
+    munmap(ptr, ImageGetSize());
+    return 1;
+}
+
+static int ImageOpenFile(void)
+{
+    pid_t pid = getpid();
+    int fd;
+
+    if (imageFd >= 0 && imageFdPid == pid) {
+        return 1;
+    }
+
+    // If we're in a child process after a fork, then imageFd is shared with
+    // the parent. The images in it are still safe to map, so keep it open,
+    // but don't add anything to it.
+    imageFd = -1;
+
+    fd = memfd_create("glvnd-entrypoints", MFD_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    if (ftruncate(fd, ImageGetSize()) != 0
+            || pwrite(fd, public_entry_start, ImageGetSize(), 0) != (ssize_t) ImageGetSize()) {
+        close(fd);
+        return 0;
+    }
+
+    // Make sure that we can execute the images. A failed mmap with MAP_FIXED
+    // could leave the entrypoints unmapped, so check with a separate mapping
+    // first.
+    if (!ImageCheckMapping(fd, PROT_READ | PROT_EXEC, MAP_PRIVATE)) {
+        close(fd);
+        return 0;
+    }
+
+    imageFd = fd;
+    imageFdPid = pid;
+    imageFdSize = 0;
+    return 1;
+}
+
+/*
+ * Adds an image for \p owner, initialized with the original stubs. This must
+ * only be called while the entrypoints are unpatched.
+ */
+static int ImageAdd(int owner)
+{
+    size_t size = ImageGetSize();
+    EntryImage *newImages;
+
+    if (!ImageOpenFile()) {
+        return -1;
+    }
+
+    newImages = realloc(images, (numImages + 1) * sizeof(EntryImage));
+    if (newImages == NULL) {
+        return -1;
+    }
+    images = newImages;
+
+    if (ftruncate(imageFd, imageFdSize + size) != 0) {
+        return -1;
+    }
+    if (pwrite(imageFd, public_entry_start, size, imageFdSize) != (ssize_t) size) {
+        ftruncate(imageFd, imageFdSize);
+        return -1;
+    }
+
+    images[numImages].owner = owner;
+    images[numImages].fd = imageFd;
+    images[numImages].offset = imageFdSize;
+    imageFdSize += size;
+    return numImages++;
+}
+
+static void ImageRemove(int index)
+{
+    EntryImage *image = &images[index];
+
+    // The space in the file isn't reused, since a child process might still
+    // have it mapped. The exception is the last image in our own file, which
+    // is what happens if a vendor library fails to patch the entrypoints.
+    if (image->fd == imageFd && imageFdPid == getpid()
+            && image->offset + (off_t) ImageGetSize() == imageFdSize) {
+        if (ftruncate(imageFd, image->offset) == 0) {
+            imageFdSize = image->offset;
+        }
+    }
+
+    images[index] = images[numImages - 1];
+    numImages--;
+}
+
+int entry_patch_start_image(int owner)
+{
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    int index;
+
+    assert(owner != 0);
+    assert(patchImageOwner == 0);
+
+    if (((uintptr_t) public_entry_start) % pageSize != 0
+            || ((uintptr_t) public_entry_end) % pageSize != 0) {
+        return 0;
+    }
+
+    entry_discard_image(owner);
+
+    if (ImageFind(0) < 0 && ImageAdd(0) < 0) {
+        return 0;
+    }
+    index = ImageAdd(owner);
+    if (index < 0) {
+        return 0;
+    }
+
+    // The vendor library writes the new image through a separate mapping.
+    // The entrypoints keep running the original stubs until it's done.
+    patchImageWriteView = mmap(NULL, ImageGetSize(), PROT_READ | PROT_WRITE,
+            MAP_SHARED, images[index].fd, images[index].offset);
+    if (patchImageWriteView == MAP_FAILED) {
+        patchImageWriteView = NULL;
+        ImageRemove(index);
+        return 0;
+    }
+
+    patchImageOwner = owner;
+    return 1;
+}
+
+static void *entry_get_image_write_address(int index)
+{
+    if (patchImageWriteView == NULL) {
+        return NULL;
+    }
+    return patchImageWriteView + entry_get_stub_offset(index);
+}
+
+static void ImageCloseWriteView(void)
+{
+    if (patchImageWriteView != NULL) {
+        munmap(patchImageWriteView, ImageGetSize());
+        patchImageWriteView = NULL;
+    }
+}
+
+int entry_patch_finish_image(void)
+{
+    int owner = patchImageOwner;
+
+    assert(owner != 0);
+    patchImageOwner = 0;
+    ImageCloseWriteView();
+
+    if (!entry_switch_image(owner)) {
+        entry_discard_image(owner);
+        return 0;
+    }
+    return 1;
+}
+
+void entry_patch_abort_image(void)
+{
+    int owner = patchImageOwner;
+
+    patchImageOwner = 0;
+    ImageCloseWriteView();
+    entry_discard_image(owner);
+}
+
+int entry_switch_image(int owner)
+{
+    int index = ImageFind(owner);
+    if (index < 0) {
+        return 0;
+    }
+    if (!ImageMap(&images[index], PROT_READ | PROT_EXEC, MAP_PRIVATE)) {
+        return 0;
+    }
+#if defined(USE_CONCURRENT_PATCH)
+    // Nothing can be running a concurrently patched stub anymore.
+    ConcurrentFreeImage();
+#endif
+    return 1;
+}
+
+void entry_discard_image(int owner)
+{
+    int index;
+
+    assert(owner != 0);
+    index = ImageFind(owner);
+    if (index >= 0) {
+        ImageRemove(index);
+    }
+}
+
+void entry_cleanup_images(void)
+{
+    int i, j;
+
+    // Close each file once. Any image that's still mapped over the
+    // entrypoints keeps its own reference to the file.
+    for (i=0; i<numImages; i++) {
+        for (j=0; j<i; j++) {
+            if (images[j].fd == images[i].fd) {
+                break;
+            }
+        }
+        if (j == i && images[i].fd != imageFd) {
+            close(images[i].fd);
+        }
+    }
+    if (imageFd >= 0) {
+        close(imageFd);
+        imageFd = -1;
+    }
+
+    free(images);
+    images = NULL;
+    numImages = 0;
+    patchImageOwner = 0;
+    ImageCloseWriteView();
+}
+
+#else // defined(USE_PATCH_IMAGES)
+
+int entry_patch_start_image(int owner)
+{
+    return 0;
+}
+
+int entry_patch_finish_image(void)
+{
+    assert(!"This should never be called");
+    return 0;
+}
+
+void entry_patch_abort_image(void)
+{
+    assert(!"This should never be called");
+}
+
+int entry_switch_image(int owner)
+{
+    return 0;
+}
+
+void entry_discard_image(int owner)
+{
+}
+
+void entry_cleanup_images(void)
+{
 }
 
+#endif // defined(USE_PATCH_IMAGES)
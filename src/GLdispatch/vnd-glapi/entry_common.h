@@ -34,11 +34,23 @@
  * Common code for the x86-64 TLS, x86-64 TSD, and ARMv7 entrypoint stubs.
  */
 
+#include <stddef.h>
+
 #include "entry.h"
 
 extern char public_entry_start[];
 extern char public_entry_end[];
 
+/**
+ * Returns the offset of a stub from public_entry_start.
+ *
+ * The stubs are normally in index order, but if the stubs were generated with
+ * a profile, then the most frequently called stubs come first.
+ *
+ * \param index The index of the entrypoint.
+ */
+size_t entry_get_stub_offset(int index);
+
 #ifdef __CET__
 #ifdef __x86_64__
 #define ENDBR "endbr64\n\t"
@@ -119,3 +119,8 @@ __asm__(".balign " U_STRINGIFY(GLDISPATCH_PAGE_SIZE) "\n"
 const int entry_type = __GLDISPATCH_STUB_LOONGARCH64;
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TSD;
+}
+
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/**
+ * \file
+ *
+ * Entrypoints for dynamic stubs past the end of the assembly entrypoints.
+ *
+ * The assembly entrypoints only cover MAPI_TABLE_NUM_DYNAMIC dynamic stubs.
+ * Past that, entrypoints are written out at runtime into anonymous mappings,
+ * a chunk at a time. Each chunk is filled in completely and then made
+ * read-only before any of its entrypoints are handed out, so nothing is ever
+ * modified while another thread might be running it.
+ *
+ * The generated code loads the dispatch table from _glapi_tls_Current using
+ * its offset from the thread pointer, so this only works where that variable
+ * uses the initial-exec TLS model. With runtime stub selection, it only works
+ * if the stubs found _glapi_tls_Current in the static TLS block.
+ */
+
+#include "entry.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "glapi.h"
+#include "table.h"
+#include "glvnd/GLdispatchABI.h"
+
+#if defined(USE_X86_64_ASM) && !defined(__ILP32__) \
+    && defined(GLDISPATCH_USE_TLS) && (defined(__GLIBC__) || defined(__FreeBSD__))
+
+#define OVERFLOW_STUB_SIZE 64
+#define OVERFLOW_CHUNK_STUBS 1024
+#define OVERFLOW_CHUNK_SIZE (OVERFLOW_STUB_SIZE * OVERFLOW_CHUNK_STUBS)
+#define OVERFLOW_NUM_CHUNKS \
+    ((MAPI_TABLE_NUM_OVERFLOW + OVERFLOW_CHUNK_STUBS - 1) / OVERFLOW_CHUNK_STUBS)
+
+static unsigned char *overflowChunks[OVERFLOW_NUM_CHUNKS];
+
+/*
+ * The code for each stub. This is the same as the x86-64 TLS stub, except
+ * that it reads the TLS variable at a fixed offset from %fs instead of going
+ * through the GOT, and it checks for the no-op table, since table_noop_array
+ * doesn't have any entries for these slots.
+ */
+static const unsigned char OVERFLOW_TEMPLATE[] = {
+#if defined(__CET__)
+    0xf3, 0x0f, 0x1e, 0xfa,                     // endbr64
+#endif
+    0x64, 0x4c, 0x8b, 0x1c, 0x25, 0, 0, 0, 0,   // movq %fs:TPOFF, %r11
+    0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0,         // movabs $table_noop_array, %rax
+    0x49, 0x39, 0xc3,                           // cmpq %rax, %r11
+    0x74, 0x07,                                 // je 1f
+    0x41, 0xff, 0xa3, 0, 0, 0, 0,               // jmp *(8 * slot)(%r11)
+    0xff, 0x25, 0, 0, 0, 0,                     // 1: jmp *2f(%rip)
+    0, 0, 0, 0, 0, 0, 0, 0,                     // 2: .quad noop_generic
+};
+
+#if defined(__CET__)
+#define TEMPLATE_OFFSET_BASE 4
+#else
+#define TEMPLATE_OFFSET_BASE 0
+#endif
+#define TEMPLATE_OFFSET_TPOFF (TEMPLATE_OFFSET_BASE + 5)
+#define TEMPLATE_OFFSET_NOOP_TABLE (TEMPLATE_OFFSET_BASE + 11)
+#define TEMPLATE_OFFSET_SLOT (TEMPLATE_OFFSET_BASE + 27)
+#define TEMPLATE_OFFSET_NOOP_FUNC (TEMPLATE_OFFSET_BASE + 37)
+
+static int GetTLSOffset(int32_t *ret)
+{
+    uintptr_t tp;
+    intptr_t offset;
+
+    __asm__("movq %%fs:0, %0" : "=r" (tp));
+    offset = (intptr_t) ((uintptr_t) &_glapi_tls_Current[GLAPI_CURRENT_DISPATCH] - tp);
+    if (offset < INT32_MIN || offset > INT32_MAX) {
+        return 0;
+    }
+    *ret = (int32_t) offset;
+    return 1;
+}
+
+static unsigned char *GenerateChunk(int chunk)
+{
+    const void *noopTable = table_noop_array;
+    mapi_func noopFunc = table_noop_array[MAPI_TABLE_NUM_SLOTS - 1];
+    unsigned char *buf;
+    int32_t tpoff;
+    int i;
+
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+    if (entry_get_stub_mode() != __GLDISPATCH_STUB_MODE_TLS) {
+        return NULL;
+    }
+#endif
+    if (!GetTLSOffset(&tpoff)) {
+        return NULL;
+    }
+
+    buf = mmap(NULL, OVERFLOW_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        return NULL;
+    }
+
+    for (i=0; i<OVERFLOW_CHUNK_STUBS; i++) {
+        unsigned char *stub = buf + (i * OVERFLOW_STUB_SIZE);
+        int32_t offset = (int32_t) ((MAPI_TABLE_NUM_SLOTS
+                + (chunk * OVERFLOW_CHUNK_STUBS) + i) * sizeof(mapi_func));
+
+        memcpy(stub, OVERFLOW_TEMPLATE, sizeof(OVERFLOW_TEMPLATE));
+        memcpy(stub + TEMPLATE_OFFSET_TPOFF, &tpoff, sizeof(tpoff));
+        memcpy(stub + TEMPLATE_OFFSET_NOOP_TABLE, &noopTable, sizeof(noopTable));
+        memcpy(stub + TEMPLATE_OFFSET_SLOT, &offset, sizeof(offset));
+        memcpy(stub + TEMPLATE_OFFSET_NOOP_FUNC, &noopFunc, sizeof(noopFunc));
+    }
+
+    if (mprotect(buf, OVERFLOW_CHUNK_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        munmap(buf, OVERFLOW_CHUNK_SIZE);
+        return NULL;
+    }
+    return buf;
+}
+
+mapi_func entry_get_overflow(int slot)
+{
+    int index = slot - MAPI_TABLE_NUM_SLOTS;
+    int chunk;
+
+    if (index < 0 || index >= MAPI_TABLE_NUM_OVERFLOW) {
+        return NULL;
+    }
+
+    chunk = index / OVERFLOW_CHUNK_STUBS;
+    if (overflowChunks[chunk] == NULL) {
+        overflowChunks[chunk] = GenerateChunk(chunk);
+        if (overflowChunks[chunk] == NULL) {
+            return NULL;
+        }
+    }
+    return (mapi_func) (overflowChunks[chunk]
+            + ((index % OVERFLOW_CHUNK_STUBS) * OVERFLOW_STUB_SIZE));
+}
+
+void entry_cleanup_overflow(void)
+{
+    int i;
+
+    for (i=0; i<OVERFLOW_NUM_CHUNKS; i++) {
+        if (overflowChunks[i] != NULL) {
+            munmap(overflowChunks[i], OVERFLOW_CHUNK_SIZE);
+            overflowChunks[i] = NULL;
+        }
+    }
+}
+
+#else
+
+mapi_func entry_get_overflow(int slot)
+{
+    (void) slot;
+    return NULL;
+}
+
+void entry_cleanup_overflow(void)
+{
+}
+
+#endif
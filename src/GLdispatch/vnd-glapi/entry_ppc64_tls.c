@@ -100,6 +100,11 @@ extern uint64_t ppc64_current_tls();
 const int entry_type = __GLDISPATCH_STUB_PPC64;
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TLS;
+}
+
 static const uint32_t ENTRY_TEMPLATE[] =
 {
     // This should be functionally the same code as would be generated from
@@ -142,7 +147,7 @@ static const int TEMPLATE_OFFSET_SLOT = sizeof(ENTRY_TEMPLATE) - 8;
 
 void entry_generate_default_code(int index, int slot)
 {
-    char *entry = (char *) (public_entry_start + (index * entry_stub_size));
+    char *entry = (char *) (public_entry_start + entry_get_stub_offset(index));
     STATIC_ASSERT(ENTRY_STUB_ALIGN >= sizeof(ENTRY_TEMPLATE));
 
     assert(slot >= 0);
@@ -121,6 +121,11 @@ __asm__(".text\n");
 const int entry_type = __GLDISPATCH_STUB_PPC64;
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TSD;
+}
+
 static const uint32_t ENTRY_TEMPLATE[] =
 {
     // This should be functionally the same code as would be generated from
@@ -200,7 +205,7 @@ static const int TEMPLATE_OFFSET_SLOT = (sizeof(ENTRY_TEMPLATE) - 8);
  */
 void entry_generate_default_code(int index, int slot)
 {
-    char *entry = (char *) (public_entry_start + (index * entry_stub_size));
+    char *entry = (char *) (public_entry_start + entry_get_stub_offset(index));
     memcpy(entry, ENTRY_TEMPLATE, sizeof(ENTRY_TEMPLATE));
 
     *((uint32_t *) (entry + TEMPLATE_OFFSET_SLOT)) = slot * sizeof(mapi_func);
@@ -44,15 +44,53 @@ entry_current_get(void)
 #endif
 }
 
+/*
+ * Each entrypoint ends in a call to the vendor's function with the same
+ * arguments, so it can always be a tail call. Compilers will normally do that
+ * anyway with optimizations on, but not necessarily in a debug or sanitizer
+ * build. Where the compiler supports it, the musttail attribute makes it a
+ * tail call regardless, so the entrypoints don't add a stack frame or copy
+ * the arguments.
+ *
+ * The musttail attribute only applies to a return statement, so the functions
+ * that return void use it to return a void expression. That isn't valid ISO
+ * C, so -Wpedantic is turned off for the entrypoints when musttail is used.
+ */
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define ENTRY_USE_MUSTTAIL 1
+#endif
+#endif
+
+#if defined(ENTRY_USE_MUSTTAIL)
+#define ENTRY_TAIL_CALL(call) __attribute__((musttail)) return call
+#define ENTRY_TAIL_RETURN(call) __attribute__((musttail)) return call
+#else
+#define ENTRY_TAIL_CALL(call) call
+#define ENTRY_TAIL_RETURN(call) return call
+#endif
+
 /* C version of the public entries */
 #define MAPI_TMP_DEFINES
 #define MAPI_TMP_PUBLIC_DECLARES
 #define MAPI_TMP_PUBLIC_ENTRIES
+#if defined(ENTRY_USE_MUSTTAIL)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
 #include "mapi_tmp.h"
+#if defined(ENTRY_USE_MUSTTAIL)
+#pragma GCC diagnostic pop
+#endif
 
 const int entry_type = __GLDISPATCH_STUB_UNKNOWN;
 const int entry_stub_size = 0;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_C;
+}
+
 mapi_func
 entry_get_public(int index)
 {
@@ -82,6 +120,64 @@ void *entry_get_patch_address(int index)
     return NULL;
 }
 
+int entry_patch_start_concurrent(void)
+{
+    assert(!"This should never be called");
+    return 0;
+}
+
+void *entry_get_concurrent_patch_address(int index)
+{
+    assert(!"This should never be called");
+    return NULL;
+}
+
+int entry_patch_finish_concurrent(void)
+{
+    assert(!"This should never be called");
+    return 0;
+}
+
+void entry_patch_abort_concurrent(void)
+{
+    assert(!"This should never be called");
+}
+
+void *entry_get_patch_write_address(int index)
+{
+    assert(!"This should never be called");
+    return NULL;
+}
+
+int entry_patch_start_image(int owner)
+{
+    return 0;
+}
+
+int entry_patch_finish_image(void)
+{
+    assert(!"This should never be called");
+    return 0;
+}
+
+void entry_patch_abort_image(void)
+{
+    assert(!"This should never be called");
+}
+
+int entry_switch_image(int owner)
+{
+    return 0;
+}
+
+void entry_discard_image(int owner)
+{
+}
+
+void entry_cleanup_images(void)
+{
+}
+
 void *entry_save_entrypoints(void)
 {
     assert(!"This should never be called");
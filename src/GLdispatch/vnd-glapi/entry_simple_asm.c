@@ -53,5 +53,5 @@
 
 mapi_func entry_get_public(int index)
 {
-    return (mapi_func)(public_entry_start + (index * entry_stub_size));
+    return (mapi_func)(public_entry_start + entry_get_stub_offset(index));
 }
@@ -25,6 +25,8 @@
  *    Chia-I Wu <olv@lunarg.com>
  */
 
+#define _GNU_SOURCE 1
+
 #include "entry.h"
 #include "entry_common.h"
 
@@ -32,13 +34,28 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 #include "utils_misc.h"
 #include "u_macros.h"
 #include "glapi.h"
 #include "glvnd/GLdispatchABI.h"
 
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+#if defined(__ILP32__)
+#error "Runtime stub selection is not supported on x32"
+#endif
+#if !defined(USE_ATTRIBUTE_CONSTRUCTOR)
+#error "Runtime stub selection requires constructor attributes"
+#endif
+#endif
+
+#if defined(GLDISPATCH_COMPACT_STUBS) && !defined(GLDISPATCH_RUNTIME_STUBS)
+#define ENTRY_STUB_ALIGN 16
+#else
 #define ENTRY_STUB_ALIGN 32
+#endif
 #if !defined(GLDISPATCH_PAGE_SIZE)
 #define GLDISPATCH_PAGE_SIZE 4096
 #endif
@@ -55,7 +72,52 @@ __asm__(".balign " U_STRINGIFY(GLDISPATCH_PAGE_SIZE) "\n"
     ".balign " U_STRINGIFY(ENTRY_STUB_ALIGN) "\n" \
     func ":"
 
-#ifdef __ILP32__
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+
+/*
+ * With runtime stub selection, the stubs are assembled to get the dispatch
+ * table through a TLS descriptor, which works no matter where the dynamic
+ * linker put _glapi_tls_Current. The descriptor call only clobbers %rax, so
+ * it's safe to do right in the stub. When the library is loaded,
+ * EntrySelectStubs rewrites them to read _glapi_tls_Current at a fixed offset
+ * from %fs if it ended up in the static TLS block, or to go through
+ * _glapi_get_current if the __GLVND_DISPATCH_STUBS environment variable asks
+ * for the TSD stubs.
+ *
+ * Every variant ends in the same "jmp *disp32(%rax)", written out by hand so
+ * that the assembler can't pick a shorter encoding, so the slot offset can be
+ * read back out of the assembled stub.
+ */
+
+#define STUB_ASM_CODE(slot)                              \
+    ENDBR                                               \
+    "leaq _glapi_tls_Current@TLSDESC(%rip), %rax\n\t"   \
+    "call *_glapi_tls_Current@TLSCALL(%rax)\n\t"        \
+    "movq %fs:(%rax), %rax\n\t"                         \
+    ".byte 0xff, 0xa0\n\t"                              \
+    ".long 8 * " slot
+
+#elif defined(GLDISPATCH_COMPACT_STUBS)
+
+/*
+ * With compact stubs, each stub only loads its slot number and jumps to a
+ * common tail, which does the TLS lookup and the indirect jump. That fits each
+ * stub in 16 bytes, even with an endbr64.
+ *
+ * The offset of _glapi_tls_Current from %fs isn't a link-time constant in a
+ * shared library, but with the initial-exec model, it's fixed once the library
+ * is loaded. Without an endbr64, a "movq %fs:TPOFF, %rax" and a
+ * "jmp *disp32(%rax)" also fit in 16 bytes, so EntryInlineTLSOffset rewrites
+ * the stubs to do that when the library is loaded, and the tail is only used
+ * if that fails.
+ */
+
+#define STUB_ASM_CODE(slot)                              \
+    ENDBR                                               \
+    "movl $" slot ", %eax\n\t"                           \
+    "jmp x86_64_entry_tail"
+
+#elif defined(__ILP32__)
 
 #define STUB_ASM_CODE(slot)                              \
     ENDBR                                               \
@@ -72,7 +134,7 @@ __asm__(".balign " U_STRINGIFY(GLDISPATCH_PAGE_SIZE) "\n"
     "movq %fs:(%rax), %r11\n\t"                              \
     "jmp *(8 * " slot ")(%r11)"
 
-#endif // __ILP32__
+#endif // defined(GLDISPATCH_RUNTIME_STUBS)
 
 #define MAPI_TMP_STUB_ASM_GCC
 #include "mapi_tmp.h"
@@ -84,6 +146,74 @@ __asm__(".balign " U_STRINGIFY(GLDISPATCH_PAGE_SIZE) "\n"
 
 __asm__(".text\n");
 
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+
+// Helper for the TSD stubs. It returns the current dispatch table in %rax,
+// and leaves the argument registers alone.
+__asm__(".balign 16\n"
+        ".globl x86_64_entry_tsd_current\n"
+        ".hidden x86_64_entry_tsd_current\n"
+        "x86_64_entry_tsd_current:\n\t"
+        "movq _glapi_Current@GOTPCREL(%rip), %rax\n\t"
+        "movq (%rax), %rax\n\t"
+        "test %rax, %rax\n\t"
+        "jne 1f\n\t"
+        "push %rdi\n\t"
+        "push %rsi\n\t"
+        "push %rdx\n\t"
+        "push %rcx\n\t"
+        "push %r8\n\t"
+        "push %r9\n\t"
+        "call _glapi_get_current@PLT\n\t"
+        "pop %r9\n\t"
+        "pop %r8\n\t"
+        "pop %rcx\n\t"
+        "pop %rdx\n\t"
+        "pop %rsi\n\t"
+        "pop %rdi\n"
+        "1:\n\t"
+        "ret\n"
+
+        // Returns the offset of _glapi_tls_Current from %fs, and stores the
+        // address of its TLS descriptor in the pointer in %rdi. This must
+        // start with the leaq, so that GetStaticTLSOffset can tell whether
+        // the linker relaxed it.
+        ".balign 16\n"
+        ".globl x86_64_entry_tlsdesc_probe\n"
+        ".hidden x86_64_entry_tlsdesc_probe\n"
+        "x86_64_entry_tlsdesc_probe:\n\t"
+        "leaq _glapi_tls_Current@TLSDESC(%rip), %rax\n\t"
+        "movq %rax, (%rdi)\n\t"
+        "call *_glapi_tls_Current@TLSCALL(%rax)\n\t"
+        "ret\n");
+
+#elif defined(GLDISPATCH_COMPACT_STUBS)
+
+// The common tail for the compact stubs. The stub leaves its slot number in
+// %eax. This is outside of the stub region, so patching never touches it.
+#ifdef __ILP32__
+
+__asm__(".balign 16\n"
+        "x86_64_entry_tail:\n\t"
+        "movq _glapi_tls_Current@GOTTPOFF(%rip), %r11\n\t"
+        "movl %fs:(%r11), %r11d\n\t"
+        "movl (%r11d, %eax, 4), %r11d\n\t"
+        "jmp *%r11\n");
+
+#else // __ILP32__
+
+__asm__(".balign 16\n"
+        ".globl x86_64_entry_tail\n"
+        ".hidden x86_64_entry_tail\n"
+        "x86_64_entry_tail:\n\t"
+        "movq _glapi_tls_Current@GOTTPOFF(%rip), %r11\n\t"
+        "movq %fs:(%r11), %r11\n\t"
+        "jmp *(%r11, %rax, 8)\n");
+
+#endif // __ILP32__
+
+#endif // defined(GLDISPATCH_COMPACT_STUBS)
+
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
 #ifdef __ILP32__
@@ -96,3 +226,274 @@ const int entry_type = __GLDISPATCH_STUB_X86_64;
 
 #endif // __ILP32__
 
+
+#if defined(GLDISPATCH_COMPACT_STUBS) && !defined(GLDISPATCH_RUNTIME_STUBS) \
+    && !defined(__ILP32__) && !defined(__CET__) && defined(USE_ATTRIBUTE_CONSTRUCTOR)
+#define ENTRY_INLINE_TLS_OFFSET 1
+#endif
+
+#if defined(GLDISPATCH_RUNTIME_STUBS) || defined(ENTRY_INLINE_TLS_OFFSET)
+
+/**
+ * Replaces the stubs with a new mapping that holds the contents of \p buf.
+ *
+ * This way, nothing is modified while it might be running. On success, this
+ * takes ownership of \p buf. On failure, it unmaps it.
+ */
+static int ReplaceStubs(unsigned char *buf, size_t size)
+{
+    if (mprotect(buf, size, PROT_READ | PROT_EXEC) != 0
+            || mremap(buf, size, size, MREMAP_MAYMOVE | MREMAP_FIXED,
+                public_entry_start) == MAP_FAILED) {
+        munmap(buf, size);
+        return 0;
+    }
+    return 1;
+}
+
+#endif // defined(GLDISPATCH_RUNTIME_STUBS) || defined(ENTRY_INLINE_TLS_OFFSET)
+
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+
+#if defined(__CET__)
+#define STUB_CODE_OFFSET 4
+#else
+#define STUB_CODE_OFFSET 0
+#endif
+
+extern char x86_64_entry_tsd_current[]
+    __attribute__((visibility("hidden")));
+extern intptr_t x86_64_entry_tlsdesc_probe(const intptr_t **desc)
+    __attribute__((visibility("hidden")));
+
+static int entryStubMode = __GLDISPATCH_STUB_MODE_TLSDESC;
+
+int entry_get_stub_mode(void)
+{
+    return entryStubMode;
+}
+
+/**
+ * Finds the offset of _glapi_tls_Current from %fs, if it's in the static TLS
+ * block.
+ *
+ * A TLS descriptor is a function and an argument. For a variable in the static
+ * TLS block, the function just returns the argument, which is the variable's
+ * offset from the thread pointer. Otherwise, the argument points to whatever
+ * the function needs to find the variable in a dynamically allocated block.
+ *
+ * If the stubs were linked into an executable, then the linker will have
+ * replaced the TLSDESC sequence with a direct load of the offset, and there's
+ * no descriptor at all.
+ */
+static int GetStaticTLSOffset(int32_t *ret)
+{
+    static const unsigned char LEA_RAX[] = { 0x48, 0x8d, 0x05 };
+    const intptr_t *desc = NULL;
+    intptr_t offset = x86_64_entry_tlsdesc_probe(&desc);
+
+    if (memcmp((const void *) x86_64_entry_tlsdesc_probe, LEA_RAX, sizeof(LEA_RAX)) == 0
+            && desc[1] != offset) {
+        return 0;
+    }
+    if (offset < INT32_MIN || offset > INT32_MAX) {
+        return 0;
+    }
+    *ret = (int32_t) offset;
+    return 1;
+}
+
+/*
+ * The stubs as they're assembled, after the endbr64:
+ *
+ *   leaq _glapi_tls_Current@TLSDESC(%rip), %rax   48 8d 05 <rel32>
+ *   call *_glapi_tls_Current@TLSCALL(%rax)        ff 10
+ *   movq %fs:(%rax), %rax                         64 48 8b 00
+ *   jmp *disp32(%rax)                             ff a0 <disp32>
+ */
+#define STUB_TLSDESC_CALL 7
+#define STUB_TLSDESC_LOAD 9
+#define STUB_TLSDESC_JUMP 13
+#define STUB_TLSDESC_SIZE 19
+
+/**
+ * Rewrites the stubs to use the TLS or TSD variant.
+ *
+ * The stubs are written into a new mapping, which then replaces the original
+ * one, so nothing is modified while it might be running.
+ */
+static int WriteStubs(int mode, int32_t tpoff)
+{
+    static const unsigned char TLSDESC_CALL[] = { 0xff, 0x10 };
+    static const unsigned char TLSDESC_LOAD[] = { 0x64, 0x48, 0x8b, 0x00 };
+    static const unsigned char JMP_RAX_DISP32[] = { 0xff, 0xa0 };
+    size_t size = public_entry_end - public_entry_start;
+    const intptr_t *desc = NULL;
+    unsigned char *buf;
+    size_t offset;
+    int count = 0;
+
+    // Every stub's leaq should point to the same descriptor as the probe's.
+    x86_64_entry_tlsdesc_probe(&desc);
+
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        return 0;
+    }
+    memcpy(buf, public_entry_start, size);
+
+    for (offset = 0; offset < size; offset += ENTRY_STUB_ALIGN) {
+        unsigned char *code = buf + offset + STUB_CODE_OFFSET;
+        const char *exec = public_entry_start + offset + STUB_CODE_OFFSET;
+        unsigned char *p = code;
+        int32_t rel, disp;
+
+        // Stop at the padding after the last stub.
+        memcpy(&rel, code + 3, sizeof(rel));
+        if (code[0] != 0x48 || code[1] != 0x8d || code[2] != 0x05
+                || exec + STUB_TLSDESC_CALL + rel != (const char *) desc
+                || memcmp(code + STUB_TLSDESC_CALL, TLSDESC_CALL, sizeof(TLSDESC_CALL)) != 0
+                || memcmp(code + STUB_TLSDESC_LOAD, TLSDESC_LOAD, sizeof(TLSDESC_LOAD)) != 0
+                || memcmp(code + STUB_TLSDESC_JUMP, JMP_RAX_DISP32, sizeof(JMP_RAX_DISP32)) != 0) {
+            break;
+        }
+        memcpy(&disp, code + STUB_TLSDESC_JUMP + 2, sizeof(disp));
+
+        if (mode == __GLDISPATCH_STUB_MODE_TLS) {
+            static const unsigned char TLS_CODE[] = {
+                0x64, 0x48, 0x8b, 0x04, 0x25,   // movq %fs:TPOFF, %rax
+            };
+            memcpy(p, TLS_CODE, sizeof(TLS_CODE));
+            memcpy(p + 5, &tpoff, sizeof(tpoff));
+            p += 9;
+        } else {
+            rel = (int32_t) (x86_64_entry_tsd_current - (exec + 5));
+            p[0] = 0xe8;                        // call x86_64_entry_tsd_current
+            memcpy(p + 1, &rel, sizeof(rel));
+            p += 5;
+        }
+        memcpy(p, JMP_RAX_DISP32, sizeof(JMP_RAX_DISP32));
+        memcpy(p + 2, &disp, sizeof(disp));
+        p += 6;
+
+        // Nothing runs past the jump, but fill in the rest with int3 anyway.
+        memset(p, 0xcc, STUB_TLSDESC_SIZE - (p - code));
+        count++;
+    }
+
+    if (count == 0) {
+        munmap(buf, size);
+        return 0;
+    }
+    return ReplaceStubs(buf, size);
+}
+
+static void __attribute__((constructor)) EntrySelectStubs(void)
+{
+    const char *env = getenv("__GLVND_DISPATCH_STUBS");
+    int32_t tpoff = 0;
+    int mode;
+
+    if (GetStaticTLSOffset(&tpoff)) {
+        mode = __GLDISPATCH_STUB_MODE_TLS;
+    } else {
+        mode = __GLDISPATCH_STUB_MODE_TLSDESC;
+    }
+
+    if (env != NULL) {
+        if (strcmp(env, "tlsdesc") == 0) {
+            mode = __GLDISPATCH_STUB_MODE_TLSDESC;
+        } else if (strcmp(env, "tsd") == 0) {
+            mode = __GLDISPATCH_STUB_MODE_TSD;
+        }
+    }
+
+    if (mode != __GLDISPATCH_STUB_MODE_TLSDESC && !WriteStubs(mode, tpoff)) {
+        mode = __GLDISPATCH_STUB_MODE_TLSDESC;
+    }
+    entryStubMode = mode;
+}
+
+#else // defined(GLDISPATCH_RUNTIME_STUBS)
+
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TLS;
+}
+
+#if defined(ENTRY_INLINE_TLS_OFFSET)
+
+extern char x86_64_entry_tail[]
+    __attribute__((visibility("hidden")));
+
+/**
+ * Rewrites each compact stub to load _glapi_tls_Current at a fixed offset
+ * from %fs, instead of jumping to x86_64_entry_tail.
+ *
+ * As assembled, each stub is:
+ *
+ *   movl $slot, %eax                b8 <imm32>
+ *   jmp x86_64_entry_tail           e9 <rel32>
+ *
+ * and it becomes:
+ *
+ *   movq %fs:TPOFF, %rax            64 48 8b 04 25 <imm32>
+ *   jmp *(8 * slot)(%rax)           ff a0 <disp32>
+ */
+static void __attribute__((constructor)) EntryInlineTLSOffset(void)
+{
+    size_t size = public_entry_end - public_entry_start;
+    intptr_t tpoff;
+    unsigned char *buf;
+    size_t offset;
+
+    // With initial-exec TLS, the offset is the same for every thread.
+    __asm__("movq _glapi_tls_Current@GOTTPOFF(%%rip), %0" : "=r" (tpoff));
+    if (tpoff < INT32_MIN || tpoff > INT32_MAX) {
+        return;
+    }
+
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        return;
+    }
+    memcpy(buf, public_entry_start, size);
+
+    for (offset = 0; offset < size; offset += ENTRY_STUB_ALIGN) {
+        unsigned char *code = buf + offset;
+        const char *exec = public_entry_start + offset;
+        int32_t tpoff32 = (int32_t) tpoff;
+        uint32_t slot;
+        int32_t rel, disp;
+
+        // Stop at the padding after the last stub.
+        memcpy(&slot, code + 1, sizeof(slot));
+        memcpy(&rel, code + 6, sizeof(rel));
+        if (code[0] != 0xb8 || code[5] != 0xe9
+                || exec + 10 + rel != x86_64_entry_tail
+                || slot >= INT32_MAX / sizeof(void *)) {
+            break;
+        }
+        disp = (int32_t) (slot * sizeof(void *));
+
+        code[0] = 0x64;
+        code[1] = 0x48;
+        code[2] = 0x8b;
+        code[3] = 0x04;
+        code[4] = 0x25;
+        memcpy(code + 5, &tpoff32, sizeof(tpoff32));
+        code[9] = 0xff;
+        code[10] = 0xa0;
+        memcpy(code + 11, &disp, sizeof(disp));
+        code[15] = 0xcc;
+    }
+
+    // If this fails, then the stubs still work through the tail.
+    ReplaceStubs(buf, size);
+}
+
+#endif // defined(ENTRY_INLINE_TLS_OFFSET)
+
+#endif // defined(GLDISPATCH_RUNTIME_STUBS)
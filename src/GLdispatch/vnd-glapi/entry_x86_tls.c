@@ -78,3 +78,8 @@ __asm__(".text\n");
 const int entry_type = __GLDISPATCH_STUB_X86;
 const int entry_stub_size = ENTRY_STUB_ALIGN;
 
+int entry_get_stub_mode(void)
+{
+    return __GLDISPATCH_STUB_MODE_TLS;
+}
+
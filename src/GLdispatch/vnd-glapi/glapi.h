@@ -85,10 +85,14 @@ enum {
 
 /**
  * A pointer to each thread's dispatch table.
+ *
+ * With runtime stub selection, this uses the default TLS model, so that
+ * libGLdispatch can still be loaded after startup. The stubs check when
+ * they're loaded whether it ended up in the static TLS block anyway.
  */
 _GLAPI_EXPORT extern const __thread void *
     _glapi_tls_Current[GLAPI_NUM_CURRENT_ENTRIES]
-#if defined(__GLIBC__) || defined(__FreeBSD__)
+#if (defined(__GLIBC__) || defined(__FreeBSD__)) && !defined(GLDISPATCH_RUNTIME_STUBS)
     __attribute__((tls_model("initial-exec")))
 #endif
     ;
@@ -145,9 +149,34 @@ _GLAPI_EXPORT const struct _glapi_table *
 _glapi_get_current(void);
 
 
+/**
+ * Returns the maximum number of slots in a dispatch table.
+ */
 unsigned int
 _glapi_get_dispatch_table_size(void);
 
+/**
+ * Allocates a dispatch table with room for every slot.
+ *
+ * Every static and dynamic slot starts out as \p noop. Those start out as
+ * shared, read-only pages where possible, and the memory for the table is only
+ * committed as slots are changed, so the unused slots don't cost anything.
+ * Callers should avoid writing to a slot that already has the right value.
+ *
+ * This isn't thread-safe, so the caller must serialize calls to it.
+ *
+ * \param noop The function to fill in for each slot.
+ * \return The new table, or NULL on failure.
+ */
+struct _glapi_table *
+_glapi_create_table(_glapi_proc noop);
+
+/**
+ * Frees a table that was allocated with \c _glapi_create_table.
+ */
+void
+_glapi_destroy_table(struct _glapi_table *table);
+
 
 int
 _glapi_get_proc_offset(const char *funcName);
@@ -167,6 +196,25 @@ _glapi_get_proc_name(unsigned int offset);
  */
 int _glapi_get_stub_count(void);
 
+/**
+ * Returns the number of static stubs. The static stubs always occupy the first
+ * slots of the dispatch table, in the same order.
+ */
+int _glapi_get_static_stub_count(void);
+
+/**
+ * Returns a hash of the names of the static stubs, in slot order. This will be
+ * different for any build of libGLdispatch with a different static dispatch
+ * table layout.
+ */
+unsigned long long _glapi_get_static_stub_hash(void);
+
+/**
+ * Returns how the dispatch stubs find the current dispatch table, as one of
+ * the \c __GLDISPATCH_STUB_MODE_* values.
+ */
+int _glapi_get_stub_mode(void);
+
 /**
  * Functions used for patching entrypoints. These functions are exported from
  * an entrypoint library such as libGL.so or libOpenGL.so, and used in
@@ -232,6 +280,50 @@ typedef struct __GLdispatchStubPatchCallbacksRec {
      */
     int (* getStubSize) (void);
 
+    /**
+     * (OPTIONAL) Starts patching the entrypoints while other threads might
+     * be running them. This is used instead of \c startPatch when the only
+     * other current contexts belong to the vendor that's patching.
+     *
+     * After this, \c getPatchOffset hands back addresses in a separate copy
+     * of the stubs, and \c finishPatch switches each entrypoint over to the
+     * new stub atomically. Otherwise, it's the same as \c startPatch.
+     *
+     * \return GL_TRUE on success, GL_FALSE if concurrent patching isn't
+     * supported.
+     */
+    GLboolean (* startPatchConcurrent) (void);
+
+    /**
+     * (OPTIONAL) Starts patching the entrypoints, and keeps a copy of the
+     * patched entrypoints for \p owner. After \c restoreFuncs, the
+     * \c reuseSavedPatch callback can switch back to that copy without having
+     * the vendor library patch anything.
+     *
+     * Otherwise, this is the same as \c startPatch.
+     *
+     * \param owner A non-zero ID for the vendor library.
+     */
+    GLboolean (* startPatchSaved) (int owner);
+
+    /**
+     * (OPTIONAL) Switches to the entrypoints that were saved for \p owner in
+     * an earlier call to \c startPatchSaved. After this, \c restoreFuncs
+     * will restore the original entrypoints as usual.
+     *
+     * This must only be called while the entrypoints are unpatched.
+     *
+     * \return GL_TRUE on success, or GL_FALSE if there are no saved
+     * entrypoints for \p owner.
+     */
+    GLboolean (* reuseSavedPatch) (int owner);
+
+    /**
+     * (OPTIONAL) Discards any saved entrypoints for \p owner. This is called
+     * before the vendor library is unloaded.
+     */
+    void (* discardSavedPatch) (int owner);
+
 } __GLdispatchStubPatchCallbacks;
 
 /*!
@@ -242,6 +334,11 @@ typedef struct __GLdispatchStubPatchCallbacksRec {
  * This function returns an ID number, which is passed to
  * \c __glDispatchUnregisterStubCallbacks to unregister the callbacks.
  *
+ * This only reads the callbacks up to \c getStubSize, which is all that
+ * older versions of the structure had. Use
+ * \c __glDispatchRegisterStubCallbacksSize to provide any of the optional
+ * callbacks after that.
+ *
  * \see stub_get_patch_callbacks for the table used for the entrypoints in
  * libGL, libOpenGL, and libGLdispatch.
  *
@@ -250,6 +347,18 @@ typedef struct __GLdispatchStubPatchCallbacksRec {
  */
 _GLAPI_EXPORT int __glDispatchRegisterStubCallbacks(const __GLdispatchStubPatchCallbacks *callbacks);
 
+/*!
+ * Same as \c __glDispatchRegisterStubCallbacks, but only reads the first
+ * \p size bytes of \p callbacks. Any callback past that is treated as
+ * \c NULL.
+ *
+ * \param callbacks A table of callback functions.
+ * \param size The size of the caller's __GLdispatchStubPatchCallbacks.
+ * \return A unique ID number, or -1 on failure.
+ */
+_GLAPI_EXPORT int __glDispatchRegisterStubCallbacksSize(
+        const __GLdispatchStubPatchCallbacks *callbacks, size_t size);
+
 /*!
  * This unregisters the GLdispatch stubs, and performs any necessary cleanup.
  *
@@ -26,12 +26,31 @@
  *    Chia-I Wu <olv@lunarg.com>
  */
 
+#define _GNU_SOURCE 1
+
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include "glapi.h"
 #include "u_current.h"
-#include "table.h" /* for MAPI_TABLE_NUM_SLOTS */
+#include "table.h" /* for MAPI_TABLE_MAX_SLOTS */
 #include "stub.h"
 
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+/*
+ * A file that holds a dispatch table where every static and dynamic slot is
+ * the same no-op function. New tables map it with MAP_PRIVATE, so a page of a
+ * table only gets its own memory once a slot in that page is changed, and the
+ * pages that a vendor never fills in stay shared between every table.
+ */
+static int noop_table_fd = -1;
+static _glapi_proc noop_table_func;
+static size_t noop_table_size;
+
 /*
  * Global variables and _glapi_get_current are defined in
  * u_current.c.
@@ -48,6 +67,11 @@ _glapi_destroy(void)
 {
    u_current_destroy();
    stub_cleanup();
+
+   if (noop_table_fd >= 0) {
+       close(noop_table_fd);
+       noop_table_fd = -1;
+   }
 }
 
 void
@@ -79,7 +103,93 @@ _glapi_get_current(void)
 unsigned int
 _glapi_get_dispatch_table_size(void)
 {
-   return MAPI_TABLE_NUM_SLOTS;
+   return MAPI_TABLE_MAX_SLOTS;
+}
+
+static int
+create_noop_table_file(_glapi_proc noop)
+{
+#if defined(HAVE_MEMFD_CREATE)
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = MAPI_TABLE_SIZE;
+    _glapi_proc *funcs;
+    int fd;
+    int i;
+
+    size = ((size + pageSize - 1) / pageSize) * pageSize;
+
+    fd = memfd_create("glvnd-noop-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return 0;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    funcs = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (funcs == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    for (i=0; i<(int) (size / sizeof(_glapi_proc)); i++) {
+        funcs[i] = noop;
+    }
+    munmap(funcs, size);
+
+#if defined(F_ADD_SEALS)
+    // Nothing should ever write to the file after this, so seal it to be
+    // sure. This is just a sanity check, so it's fine if it fails.
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE);
+#endif
+
+    noop_table_fd = fd;
+    noop_table_func = noop;
+    noop_table_size = size;
+    return 1;
+#else
+    (void) noop;
+    return 0;
+#endif
+}
+
+struct _glapi_table *
+_glapi_create_table(_glapi_proc noop)
+{
+    _glapi_proc *table = mmap(NULL, MAPI_TABLE_MAX_SLOTS * sizeof(mapi_func),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+            -1, 0);
+    int i;
+
+    if (table == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (noop_table_fd < 0) {
+        create_noop_table_file(noop);
+    }
+    if (noop_table_fd >= 0 && noop_table_func == noop) {
+        if (mmap(table, noop_table_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED, noop_table_fd, 0) != MAP_FAILED) {
+            return (struct _glapi_table *) table;
+        }
+    }
+
+    // If we can't map the shared file, then fill in the table ourselves. The
+    // overflow slots are only ever read after they're filled in, so those can
+    // stay untouched either way.
+    for (i=0; i<MAPI_TABLE_NUM_SLOTS; i++) {
+        table[i] = noop;
+    }
+    return (struct _glapi_table *) table;
+}
+
+void
+_glapi_destroy_table(struct _glapi_table *table)
+{
+    if (table != NULL) {
+        munmap(table, MAPI_TABLE_MAX_SLOTS * sizeof(mapi_func));
+    }
 }
 
 static int
@@ -139,3 +249,18 @@ int _glapi_get_stub_count(void)
     return stub_get_count();
 }
 
+int _glapi_get_static_stub_count(void)
+{
+    return MAPI_TABLE_NUM_STATIC;
+}
+
+unsigned long long _glapi_get_static_stub_hash(void)
+{
+    return MAPI_TABLE_STATIC_HASH;
+}
+
+int _glapi_get_stub_mode(void)
+{
+    return entry_get_stub_mode();
+}
+
@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 
@@ -48,8 +49,44 @@ struct mapi_stub {
     int slot;
 };
 
+/**
+ * An entry in the perfect hash table for the public stubs.
+ */
+struct mapi_stub_hash {
+    /*!
+     * The index of the stub in public_stubs.
+     */
+    unsigned short index;
+
+    /*!
+     * The length of the stub's name, or 0xFFFF for an unused entry.
+     */
+    unsigned short length;
+};
+
 static void *savedEntrypoints = NULL;
 
+/**
+ * True if the current patch was started with \c stubStartPatchConcurrent.
+ */
+static GLboolean patchingConcurrent = GL_FALSE;
+
+/**
+ * The owner of the saved image that's mapped over the entrypoints, or 0 if
+ * the entrypoints aren't using a saved image.
+ */
+static int currentImageOwner = 0;
+
+/**
+ * The image owner for a patch that isn't saved after \c stubRestoreFuncs.
+ */
+#define STUB_TEMPORARY_IMAGE_OWNER -1
+
+/**
+ * True if the current patch was started with \c stubStartPatchSaved.
+ */
+static GLboolean patchingImage = GL_FALSE;
+
 /* define public_stubs */
 #define MAPI_TMP_PUBLIC_STUBS
 #include "mapi_tmp.h"
@@ -67,11 +104,82 @@ stub_compare(const void *key, const void *elem)
    return strcmp(name, stub_name);
 }
 
+/**
+ * Hashes a stub name, and returns its length.
+ *
+ * This must match the hash that gen_gldispatch_mapi.py uses to generate the
+ * public_stub_hash tables.
+ */
+static uint64_t
+stub_hash_name(const char *name, size_t *length)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *p;
+
+    for (p = (const unsigned char *) name; *p != '\0'; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    *length = (const char *) p - name;
+    return h;
+}
+
+static uint32_t
+stub_hash_mix(uint64_t h, uint32_t displace)
+{
+    h ^= displace * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uint32_t) h;
+}
+
 /**
  * Return the public stub with the given name.
+ *
+ * This uses a minimal perfect hash that's generated along with the
+ * public_stubs array, so a lookup is one hash and one string comparison.
  */
 int
 stub_find_public(const char *name)
+{
+    const struct mapi_stub_hash *entry;
+    uint64_t h;
+    size_t length;
+    int displace;
+
+    if (name[0] != 'g' || name[1] != 'l') {
+        // The hash table only has the full names, but a name without the
+        // "gl" prefix is still allowed.
+        return stub_find_public_sorted(name);
+    }
+
+    h = stub_hash_name(name, &length);
+    displace = public_stub_hash_displace[(uint32_t) (h >> 32)
+        % ARRAY_LEN(public_stub_hash_displace)];
+    if (displace < 0) {
+        entry = &public_stub_hash[-displace - 1];
+    } else {
+        entry = &public_stub_hash[stub_hash_mix(h, displace)
+            % ARRAY_LEN(public_stub_hash)];
+    }
+
+    if (entry->length == length
+            && memcmp(public_stubs[entry->index].name, name, length) == 0) {
+        return entry->index;
+    } else {
+        return -1;
+    }
+}
+
+/**
+ * Return the public stub with the given name, using a binary search.
+ *
+ * This is slower than \c stub_find_public, but it doesn't depend on the
+ * generated hash tables. It's kept for testing and benchmarking.
+ */
+int
+stub_find_public_sorted(const char *name)
 {
     const struct mapi_stub *stub;
 
@@ -95,26 +203,109 @@ void stub_cleanup(void)
     free(savedEntrypoints);
     savedEntrypoints = NULL;
 
+    entry_cleanup_images();
+    currentImageOwner = 0;
+
 #if !defined(STATIC_DISPATCH_ONLY)
     stub_cleanup_dynamic();
 #endif
 }
 
 #if !defined(STATIC_DISPATCH_ONLY)
-static char *dynamic_stub_names[MAPI_TABLE_NUM_DYNAMIC];
+#define DYNAMIC_NAME_CHUNK_SIZE 256
+#define DYNAMIC_NAME_NUM_CHUNKS \
+    ((MAPI_TABLE_NUM_DYNAMIC + MAPI_TABLE_NUM_OVERFLOW \
+      + DYNAMIC_NAME_CHUNK_SIZE - 1) / DYNAMIC_NAME_CHUNK_SIZE)
+
+/*
+ * The names of the dynamic stubs, allocated in fixed-size chunks. A chunk
+ * never moves once it's allocated, so stub_get_name can look up the name of
+ * any existing stub without taking a lock.
+ */
+static char **dynamic_stub_names[DYNAMIC_NAME_NUM_CHUNKS];
 static int num_dynamic_stubs;
 
+/*
+ * An open-addressed hash table of the dynamic stubs, keyed by name. Each
+ * entry is the index of a stub plus one, or zero for an empty entry. The
+ * table is resized to keep it at most half full.
+ */
+static int *dynamic_stub_hash;
+static unsigned int dynamic_stub_hash_size;
+
+static char **
+dynamic_stub_name_ptr(int idx)
+{
+    return &dynamic_stub_names[idx / DYNAMIC_NAME_CHUNK_SIZE]
+        [idx % DYNAMIC_NAME_CHUNK_SIZE];
+}
+
 void stub_cleanup_dynamic(void)
 {
     int i;
 
     // Free the copies of the stub names.
     for (i=0; i<num_dynamic_stubs; i++) {
+        free(*dynamic_stub_name_ptr(i));
+    }
+    for (i=0; i<DYNAMIC_NAME_NUM_CHUNKS; i++) {
         free(dynamic_stub_names[i]);
         dynamic_stub_names[i] = NULL;
     }
 
+    free(dynamic_stub_hash);
+    dynamic_stub_hash = NULL;
+    dynamic_stub_hash_size = 0;
+
     num_dynamic_stubs = 0;
+
+    entry_cleanup_overflow();
+}
+
+/**
+ * Returns the position in the hash table for a name. This is either the
+ * entry for that name, or the empty entry where it would go.
+ */
+static unsigned int
+stub_hash_find_entry(const int *hash, unsigned int size, const char *name)
+{
+    size_t length;
+    unsigned int pos = (unsigned int) stub_hash_name(name, &length) & (size - 1);
+
+    while (hash[pos] != 0
+            && strcmp(name, *dynamic_stub_name_ptr(hash[pos] - 1)) != 0) {
+        pos = (pos + 1) & (size - 1);
+    }
+    return pos;
+}
+
+/**
+ * Makes sure the hash table has room for one more stub.
+ */
+static int
+stub_hash_reserve(void)
+{
+    unsigned int size;
+    int *hash;
+    int i;
+
+    if (((unsigned int) num_dynamic_stubs + 1) * 2 <= dynamic_stub_hash_size) {
+        return 1;
+    }
+
+    size = (dynamic_stub_hash_size > 0 ? dynamic_stub_hash_size * 2 : 64);
+    hash = (int *) calloc(size, sizeof(int));
+    if (hash == NULL) {
+        return 0;
+    }
+    for (i=0; i<num_dynamic_stubs; i++) {
+        hash[stub_hash_find_entry(hash, size, *dynamic_stub_name_ptr(i))] = i + 1;
+    }
+
+    free(dynamic_stub_hash);
+    dynamic_stub_hash = hash;
+    dynamic_stub_hash_size = size;
+    return 1;
 }
 
 /**
@@ -124,32 +315,51 @@ int
 stub_add_dynamic(const char *name)
 {
    int idx;
+   int slot;
+   char **chunk;
 
    idx = num_dynamic_stubs;
-   if (idx >= MAPI_TABLE_NUM_DYNAMIC)
+   if (idx >= MAPI_TABLE_NUM_DYNAMIC + MAPI_TABLE_NUM_OVERFLOW)
       return -1;
 
    // Make sure that we have a dispatch stub for this index. If the stubs are
    // in C instead of assembly, then we can't use dynamic dispatch stubs, and
-   // entry_get_public will return NULL.
-   if (entry_get_public(MAPI_TABLE_NUM_STATIC + idx) == NULL) {
+   // entry_get_public will return NULL. Past the end of the assembly stubs,
+   // entry_get_overflow will return NULL if it can't generate a stub.
+   slot = MAPI_TABLE_NUM_STATIC + idx;
+   if (stub_get_addr(slot) == NULL) {
        return -1;
    }
 
-   assert(dynamic_stub_names[idx] == NULL);
+   if (!stub_hash_reserve()) {
+       return -1;
+   }
+
+   chunk = dynamic_stub_names[idx / DYNAMIC_NAME_CHUNK_SIZE];
+   if (chunk == NULL) {
+       chunk = (char **) calloc(DYNAMIC_NAME_CHUNK_SIZE, sizeof(char *));
+       if (chunk == NULL) {
+           return -1;
+       }
+       dynamic_stub_names[idx / DYNAMIC_NAME_CHUNK_SIZE] = chunk;
+   }
+
+   assert(chunk[idx % DYNAMIC_NAME_CHUNK_SIZE] == NULL);
 
    /*
     * name is the pointer passed to glXGetProcAddress, so the caller may free
     * or modify it later. Allocate a copy of the name to store.
     */
-   dynamic_stub_names[idx] = strdup(name);
-   if (dynamic_stub_names[idx] == NULL) {
+   chunk[idx % DYNAMIC_NAME_CHUNK_SIZE] = strdup(name);
+   if (chunk[idx % DYNAMIC_NAME_CHUNK_SIZE] == NULL) {
        return -1;
    }
 
+   dynamic_stub_hash[stub_hash_find_entry(dynamic_stub_hash,
+           dynamic_stub_hash_size, name)] = idx + 1;
    num_dynamic_stubs = idx + 1;
 
-   return (MAPI_TABLE_NUM_STATIC + idx);
+   return slot;
 }
 
 /**
@@ -160,16 +370,16 @@ int
 stub_find_dynamic(const char *name, int generate)
 {
     int found = -1;
-    int i;
-   
+
     if (generate) {
         assert(stub_find_public(name) < 0);
     }
 
-    for (i = 0; i < num_dynamic_stubs; i++) {
-        if (strcmp(name, dynamic_stub_names[i]) == 0) {
-            found = MAPI_TABLE_NUM_STATIC + i;
-            break;
+    if (dynamic_stub_hash_size > 0) {
+        int entry = dynamic_stub_hash[stub_hash_find_entry(dynamic_stub_hash,
+                dynamic_stub_hash_size, name)];
+        if (entry != 0) {
+            found = MAPI_TABLE_NUM_STATIC + entry - 1;
         }
     }
 
@@ -189,8 +399,10 @@ stub_get_name(int index)
 {
     if (index < MAPI_TABLE_NUM_STATIC) {
         return public_stubs[index].name;
+    } else if (index - MAPI_TABLE_NUM_STATIC < num_dynamic_stubs) {
+        return *dynamic_stub_name_ptr(index - MAPI_TABLE_NUM_STATIC);
     } else {
-        return dynamic_stub_names[index - MAPI_TABLE_NUM_STATIC];
+        return NULL;
     }
 }
 
@@ -205,7 +417,11 @@ int stub_get_count(void)
 mapi_func
 stub_get_addr(int index)
 {
-    return entry_get_public(index);
+    if (index < MAPI_TABLE_NUM_SLOTS) {
+        return entry_get_public(index);
+    } else {
+        return entry_get_overflow(index);
+    }
 }
 #endif // !defined(STATIC_DISPATCH_ONLY)
 
@@ -217,11 +433,20 @@ static int stub_allow_override(void)
 static GLboolean stubStartPatch(void)
 {
     assert(savedEntrypoints == NULL);
+    assert(currentImageOwner == 0);
 
     if (!stub_allow_override()) {
         return GL_FALSE;
     }
 
+    // If we can, patch a separate image of the stubs, so that the
+    // entrypoints never have to be writable.
+    if (entry_patch_start_image(STUB_TEMPORARY_IMAGE_OWNER)) {
+        currentImageOwner = STUB_TEMPORARY_IMAGE_OWNER;
+        patchingImage = GL_TRUE;
+        return GL_TRUE;
+    }
+
     savedEntrypoints = entry_save_entrypoints();
     if (savedEntrypoints == NULL) {
         return GL_FALSE;
@@ -236,9 +461,91 @@ static GLboolean stubStartPatch(void)
     return GL_TRUE;
 }
 
+static GLboolean stubStartPatchConcurrent(void)
+{
+    assert(savedEntrypoints == NULL);
+
+    if (!stub_allow_override()) {
+        return GL_FALSE;
+    }
+
+    // The vendor library writes into a separate copy, but we still need the
+    // original stubs to restore them later.
+    savedEntrypoints = entry_save_entrypoints();
+    if (savedEntrypoints == NULL) {
+        return GL_FALSE;
+    }
+
+    if (!entry_patch_start_concurrent()) {
+        free(savedEntrypoints);
+        savedEntrypoints = NULL;
+        return GL_FALSE;
+    }
+
+    patchingConcurrent = GL_TRUE;
+    return GL_TRUE;
+}
+
+static GLboolean stubStartPatchSaved(int owner)
+{
+    assert(savedEntrypoints == NULL);
+    assert(currentImageOwner == 0);
+
+    if (!stub_allow_override()) {
+        return GL_FALSE;
+    }
+
+    if (entry_patch_start_image(owner)) {
+        currentImageOwner = owner;
+        patchingImage = GL_TRUE;
+        return GL_TRUE;
+    }
+
+    // If we can't use a saved image, then fall back to a normal patch.
+    return stubStartPatch();
+}
+
+static GLboolean stubReuseSavedPatch(int owner)
+{
+    assert(savedEntrypoints == NULL);
+    assert(currentImageOwner == 0);
+
+    if (!stub_allow_override()) {
+        return GL_FALSE;
+    }
+
+    if (entry_switch_image(owner)) {
+        currentImageOwner = owner;
+        return GL_TRUE;
+    }
+    return GL_FALSE;
+}
+
+static void stubDiscardSavedPatch(int owner)
+{
+    if (currentImageOwner == owner) {
+        entry_switch_image(0);
+        currentImageOwner = 0;
+    }
+    entry_discard_image(owner);
+}
+
 static void stubFinishPatch(void)
 {
-    entry_patch_finish();
+    if (patchingImage) {
+        patchingImage = GL_FALSE;
+        if (!entry_patch_finish_image()) {
+            // The entrypoints are still the original stubs.
+            currentImageOwner = 0;
+        }
+    } else if (patchingConcurrent) {
+        patchingConcurrent = GL_FALSE;
+        // If this fails, then the entrypoints are left unpatched, so they'll
+        // still work by going through the dispatch table.
+        entry_patch_finish_concurrent();
+    } else {
+        entry_patch_finish();
+    }
 }
 
 static void stubRestoreFuncsInternal(void)
@@ -254,6 +561,33 @@ static void stubRestoreFuncsInternal(void)
 
 static GLboolean stubRestoreFuncs(void)
 {
+    if (currentImageOwner != 0) {
+        // Unless it's a temporary image, the patched image stays saved, so
+        // that stubReuseSavedPatch can switch back to it later.
+        if (!entry_switch_image(0)) {
+            return GL_FALSE;
+        }
+        if (currentImageOwner == STUB_TEMPORARY_IMAGE_OWNER) {
+            entry_discard_image(currentImageOwner);
+        }
+        currentImageOwner = 0;
+        return GL_TRUE;
+    }
+
+    if (savedEntrypoints == NULL) {
+        // Nothing was patched.
+        return GL_TRUE;
+    }
+
+    // A concurrent patch also keeps the original stubs as an image, so
+    // switch back to that if we can instead of making the entrypoints
+    // writable.
+    if (entry_switch_image(0)) {
+        free(savedEntrypoints);
+        savedEntrypoints = NULL;
+        return GL_TRUE;
+    }
+
     if (entry_patch_start()) {
         stubRestoreFuncsInternal();
         entry_patch_finish();
@@ -265,14 +599,26 @@ static GLboolean stubRestoreFuncs(void)
 
 static void stubAbortPatch(void)
 {
-    stubRestoreFuncsInternal();
-    entry_patch_finish();
+    if (patchingImage) {
+        patchingImage = GL_FALSE;
+        currentImageOwner = 0;
+        entry_patch_abort_image();
+    } else if (patchingConcurrent) {
+        patchingConcurrent = GL_FALSE;
+        entry_patch_abort_concurrent();
+        free(savedEntrypoints);
+        savedEntrypoints = NULL;
+    } else {
+        stubRestoreFuncsInternal();
+        entry_patch_finish();
+    }
 }
 
 static GLboolean stubGetPatchOffset(const char *name, void **writePtr, const void **execPtr)
 {
     int index;
     void *addr = NULL;
+    void *writeAddr = NULL;
 
     index = stub_find_public(name);
 
@@ -282,12 +628,19 @@ static GLboolean stubGetPatchOffset(const char *name, void **writePtr, const voi
     }
 #endif // !defined(STATIC_DISPATCH_ONLY)
 
-    if (index >= 0) {
-        addr = entry_get_patch_address(index);
+    // The overflow entrypoints can't be patched.
+    if (index >= 0 && index < MAPI_TABLE_NUM_SLOTS) {
+        if (patchingConcurrent) {
+            addr = entry_get_concurrent_patch_address(index);
+            writeAddr = addr;
+        } else {
+            addr = entry_get_patch_address(index);
+            writeAddr = entry_get_patch_write_address(index);
+        }
     }
 
     if (writePtr != NULL) {
-        *writePtr = addr;
+        *writePtr = writeAddr;
     }
     if (execPtr != NULL) {
         *execPtr = addr;
@@ -315,6 +668,10 @@ static const __GLdispatchStubPatchCallbacks stubPatchCallbacks =
     stubGetPatchOffset, // getPatchOffset
     stubGetStubType,    // getStubType
     stubGetStubSize,    // getStubSize
+    stubStartPatchConcurrent, // startPatchConcurrent
+    stubStartPatchSaved, // startPatchSaved
+    stubReuseSavedPatch, // reuseSavedPatch
+    stubDiscardSavedPatch, // discardSavedPatch
 };
 
 const __GLdispatchStubPatchCallbacks *stub_get_patch_callbacks(void)
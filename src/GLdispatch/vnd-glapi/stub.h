@@ -38,11 +38,14 @@
  */
 void stub_cleanup(void);
 
-#if !defined(STATIC_DISPATCH_ONLY)
-
 int
 stub_find_public(const char *name);
 
+int
+stub_find_public_sorted(const char *name);
+
+#if !defined(STATIC_DISPATCH_ONLY)
+
 int
 stub_find_dynamic(const char *name, int generate);
 
@@ -38,6 +38,15 @@
 #define MAPI_TABLE_NUM_SLOTS (MAPI_TABLE_NUM_STATIC + MAPI_TABLE_NUM_DYNAMIC)
 #define MAPI_TABLE_SIZE (MAPI_TABLE_NUM_SLOTS * sizeof(mapi_func))
 
+/**
+ * The number of dynamic stubs that can go past the end of the assembly
+ * entrypoints. The entrypoints for these are generated at runtime by
+ * \c entry_get_overflow, and dispatch tables only use memory for them once
+ * they're filled in.
+ */
+#define MAPI_TABLE_NUM_OVERFLOW (65536 - MAPI_TABLE_NUM_DYNAMIC)
+#define MAPI_TABLE_MAX_SLOTS (MAPI_TABLE_NUM_SLOTS + MAPI_TABLE_NUM_OVERFLOW)
+
 extern const mapi_func table_noop_array[];
 
 /**
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include "trampoline.h"
+
+#include <stddef.h>
+
+#include "table.h"
+#include "u_macros.h"
+
+#if defined(USE_X86_64_ASM) && !defined(__ILP32__)
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "entry_common.h"
+
+#define TRAMPOLINE_SIZE 16
+
+/*
+ * Called from trampoline_common. These have to be visible to the assembly code
+ * below, but they're hidden along with everything else in libGLdispatch.
+ */
+trampoline_resolve_hook trampoline_hook;
+trampoline_resolve_hook trampoline_count_hook;
+
+/*
+ * Each trampoline loads its slot number into %eax and jumps to
+ * trampoline_common, which saves the integer and SSE argument registers,
+ * calls the hook, and then tail-calls whatever function the hook returned.
+ *
+ * The counting trampolines are the same, except that they also set the high
+ * bit of %eax, which tells the common routine to call trampoline_count_hook
+ * instead.
+ *
+ * The trampolines themselves aren't in the library. There's one for every
+ * dispatch table slot, which adds up to a lot of code that most processes
+ * never run, so each set is written into an anonymous mapping the first time
+ * that someone asks for it.
+ *
+ * The stack is 16-byte aligned at the call, since the return address and six
+ * pushes leave it 8 bytes off, and the 136-byte frame makes up the difference.
+ */
+__asm__(".text\n"
+        ".balign " U_STRINGIFY(TRAMPOLINE_SIZE) "\n"
+        ".globl trampoline_common\n"
+        ".hidden trampoline_common\n"
+        "trampoline_common:\n\t"
+        ENDBR
+        "pushq %rdi\n\t"
+        "pushq %rsi\n\t"
+        "pushq %rdx\n\t"
+        "pushq %rcx\n\t"
+        "pushq %r8\n\t"
+        "pushq %r9\n\t"
+        "subq $136, %rsp\n\t"
+        "movdqu %xmm0, 0(%rsp)\n\t"
+        "movdqu %xmm1, 16(%rsp)\n\t"
+        "movdqu %xmm2, 32(%rsp)\n\t"
+        "movdqu %xmm3, 48(%rsp)\n\t"
+        "movdqu %xmm4, 64(%rsp)\n\t"
+        "movdqu %xmm5, 80(%rsp)\n\t"
+        "movdqu %xmm6, 96(%rsp)\n\t"
+        "movdqu %xmm7, 112(%rsp)\n\t"
+        "movl %eax, %edi\n\t"
+        "btrl $31, %edi\n\t"
+        "jc 1f\n\t"
+        "call *trampoline_hook(%rip)\n\t"
+        "jmp 2f\n"
+        "1:\n\t"
+        "call *trampoline_count_hook(%rip)\n"
+        "2:\n\t"
+        "movdqu 0(%rsp), %xmm0\n\t"
+        "movdqu 16(%rsp), %xmm1\n\t"
+        "movdqu 32(%rsp), %xmm2\n\t"
+        "movdqu 48(%rsp), %xmm3\n\t"
+        "movdqu 64(%rsp), %xmm4\n\t"
+        "movdqu 80(%rsp), %xmm5\n\t"
+        "movdqu 96(%rsp), %xmm6\n\t"
+        "movdqu 112(%rsp), %xmm7\n\t"
+        "addq $136, %rsp\n\t"
+        "popq %r9\n\t"
+        "popq %r8\n\t"
+        "popq %rcx\n\t"
+        "popq %rdx\n\t"
+        "popq %rsi\n\t"
+        "popq %rdi\n\t"
+        "jmp *%rax\n"
+        );
+
+extern char trampoline_common[];
+
+/*
+ * The generated trampolines, or NULL if they haven't been generated yet.
+ * These are only set while the caller holds the dispatch lock, and a
+ * trampoline can't be called until its address has been handed out, so
+ * nothing else needs to synchronize with them.
+ */
+static unsigned char *resolveTrampolines;
+static unsigned char *countTrampolines;
+
+static void WriteU32(unsigned char *dest, uint32_t value)
+{
+    memcpy(dest, &value, sizeof(value));
+}
+
+/*
+ * Creates a read-only, executable mapping with a trampoline for every slot.
+ *
+ * The mapping could be anywhere, so it might be too far away for a direct
+ * jump to trampoline_common. Instead, every trampoline jumps to an indirect
+ * jump at the end of the mapping.
+ */
+static unsigned char *CreateTrampolines(uint32_t slotFlags)
+{
+    size_t tableSize = MAPI_TABLE_NUM_SLOTS * TRAMPOLINE_SIZE;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    size_t mapSize;
+    unsigned char *map;
+    unsigned char *farJump;
+    uintptr_t target = (uintptr_t) trampoline_common;
+    int i;
+
+    if (pageSize <= 0) {
+        return NULL;
+    }
+    mapSize = (tableSize + TRAMPOLINE_SIZE + pageSize - 1) & ~((size_t) pageSize - 1);
+
+    // Write the trampolines first and only then make the mapping executable,
+    // so that it's never writable and executable at the same time.
+    map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    // jmp *0(%rip), followed by the address of trampoline_common.
+    farJump = map + tableSize;
+    farJump[0] = 0xff;
+    farJump[1] = 0x25;
+    WriteU32(farJump + 2, 0);
+    memcpy(farJump + 6, &target, sizeof(target));
+
+    for (i=0; i<MAPI_TABLE_NUM_SLOTS; i++) {
+        unsigned char *tramp = map + i * TRAMPOLINE_SIZE;
+        unsigned char *p = tramp;
+
+#ifdef __CET__
+        // endbr64
+        *p++ = 0xf3;
+        *p++ = 0x0f;
+        *p++ = 0x1e;
+        *p++ = 0xfa;
+#endif
+
+        // movl $slot, %eax
+        *p++ = 0xb8;
+        WriteU32(p, (uint32_t) i | slotFlags);
+        p += 4;
+
+        // jmp farJump
+        *p++ = 0xe9;
+        WriteU32(p, (uint32_t) (farJump - (p + 4)));
+        p += 4;
+
+        // Pad with int3, so that nothing runs off the end.
+        memset(p, 0xcc, TRAMPOLINE_SIZE - (p - tramp));
+    }
+
+    if (mprotect(map, mapSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(map, mapSize);
+        return NULL;
+    }
+
+    __builtin___clear_cache((char *) map, (char *) map + mapSize);
+    return map;
+}
+
+static mapi_func GetTrampoline(unsigned char **trampolines,
+        uint32_t slotFlags, int slot)
+{
+    if (slot < 0 || slot >= MAPI_TABLE_NUM_SLOTS) {
+        return NULL;
+    }
+    if (*trampolines == NULL) {
+        *trampolines = CreateTrampolines(slotFlags);
+        if (*trampolines == NULL) {
+            return NULL;
+        }
+    }
+    return (mapi_func) (*trampolines + slot * TRAMPOLINE_SIZE);
+}
+
+int trampoline_supported(void)
+{
+    return 1;
+}
+
+void trampoline_set_hook(trampoline_resolve_hook hook)
+{
+    trampoline_hook = hook;
+}
+
+mapi_func trampoline_get_resolve(int slot)
+{
+    return GetTrampoline(&resolveTrampolines, 0, slot);
+}
+
+void trampoline_set_count_hook(trampoline_resolve_hook hook)
+{
+    trampoline_count_hook = hook;
+}
+
+mapi_func trampoline_get_count(int slot)
+{
+    return GetTrampoline(&countTrampolines, 0x80000000, slot);
+}
+
+#else // defined(USE_X86_64_ASM) && !defined(__ILP32__)
+
+int trampoline_supported(void)
+{
+    return 0;
+}
+
+void trampoline_set_hook(trampoline_resolve_hook hook)
+{
+    (void) hook;
+}
+
+mapi_func trampoline_get_resolve(int slot)
+{
+    (void) slot;
+    return NULL;
+}
+
+void trampoline_set_count_hook(trampoline_resolve_hook hook)
+{
+    (void) hook;
+}
+
+mapi_func trampoline_get_count(int slot)
+{
+    (void) slot;
+    return NULL;
+}
+
+#endif // defined(USE_X86_64_ASM) && !defined(__ILP32__)
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#ifndef _TRAMPOLINE_H_
+#define _TRAMPOLINE_H_
+
+/**
+ * \file
+ *
+ * Per-slot resolver trampolines for lazily populated dispatch tables.
+ *
+ * Each slot in the dispatch table has a trampoline that passes the slot number
+ * to a resolver hook. The hook returns the real function, and the trampoline
+ * then jumps to it with the caller's original arguments. The hook is expected
+ * to store the function in the dispatch table, so that later calls go straight
+ * to it.
+ *
+ * There's also a second set of counting trampolines, which work the same way
+ * but call a separate hook. Those are used to count calls to each slot, so
+ * their hook just returns the real function without storing it anywhere.
+ */
+
+#include "entry.h"
+
+/**
+ * The resolver hook called from the trampolines.
+ *
+ * \param slot The dispatch table slot being called.
+ * \return The function to jump to. This must not be NULL.
+ */
+typedef mapi_func (*trampoline_resolve_hook)(int slot);
+
+/**
+ * Returns non-zero if resolver trampolines are available on this platform.
+ */
+int trampoline_supported(void);
+
+/**
+ * Sets the function that the trampolines call to resolve a slot.
+ *
+ * This must be called before any trampoline is installed in a dispatch table.
+ */
+void trampoline_set_hook(trampoline_resolve_hook hook);
+
+/**
+ * Returns the resolver trampoline for a dispatch table slot, or NULL if
+ * trampolines aren't supported.
+ */
+mapi_func trampoline_get_resolve(int slot);
+
+/**
+ * Sets the function that the counting trampolines call.
+ */
+void trampoline_set_count_hook(trampoline_resolve_hook hook);
+
+/**
+ * Returns the counting trampoline for a dispatch table slot, or NULL if
+ * trampolines aren't supported.
+ */
+mapi_func trampoline_get_count(int slot);
+
+#endif /* _TRAMPOLINE_H_ */
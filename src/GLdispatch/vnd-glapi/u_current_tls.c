@@ -30,22 +30,61 @@
 #include "stub.h"
 
 __thread const void *_glapi_tls_Current[GLAPI_NUM_CURRENT_ENTRIES]
-#if defined(__GLIBC__) || defined(__FreeBSD__)
+#if (defined(__GLIBC__) || defined(__FreeBSD__)) && !defined(GLDISPATCH_RUNTIME_STUBS)
     __attribute__((tls_model("initial-exec")))
 #endif
     = {
         (void *) table_noop_array,
       };
 
-const void *_glapi_Current[GLAPI_NUM_CURRENT_ENTRIES] = {};
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+
+/*
+ * The TSD stubs that EntrySelectStubs can pick use _glapi_Current until the
+ * process goes multithreaded, the same as with u_current_tsd.c, and call
+ * _glapi_get_current after that.
+ */
+const void *_glapi_Current[GLAPI_NUM_CURRENT_ENTRIES]
+    = {
+        (const void *) table_noop_array
+      };
+
+static int ThreadSafe;
 
 void
 u_current_init(void)
 {
+    int i;
+    for (i = 0; i < GLAPI_NUM_CURRENT_ENTRIES; i++) {
+        _glapi_Current[i] = (const void *) table_noop_array;
+    }
+    ThreadSafe = 0;
 }
 
 void
-u_current_destroy(void)
+u_current_set_multithreaded(void)
+{
+    int i;
+
+    ThreadSafe = 1;
+    for (i = 0; i < GLAPI_NUM_CURRENT_ENTRIES; i++) {
+        _glapi_Current[i] = NULL;
+    }
+}
+
+void
+u_current_set(const struct _glapi_table *tbl)
+{
+   _glapi_tls_Current[GLAPI_CURRENT_DISPATCH] = (const void *) tbl;
+   _glapi_Current[GLAPI_CURRENT_DISPATCH] = (ThreadSafe) ? NULL : (const void *) tbl;
+}
+
+#else // defined(GLDISPATCH_RUNTIME_STUBS)
+
+const void *_glapi_Current[GLAPI_NUM_CURRENT_ENTRIES] = {};
+
+void
+u_current_init(void)
 {
 }
 
@@ -60,6 +99,13 @@ u_current_set(const struct _glapi_table *tbl)
    _glapi_tls_Current[GLAPI_CURRENT_DISPATCH] = (const void *) tbl;
 }
 
+#endif // defined(GLDISPATCH_RUNTIME_STUBS)
+
+void
+u_current_destroy(void)
+{
+}
+
 const struct _glapi_table *u_current_get(void)
 {
    return (const struct _glapi_table *) _glapi_tls_Current[GLAPI_CURRENT_DISPATCH];
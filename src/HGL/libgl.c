@@ -43,7 +43,8 @@ void _init(void)
 
     // Register these entrypoints with GLdispatch so they can be overwritten at
     // runtime
-    patchStubId = __glDispatchRegisterStubCallbacks(stub_get_patch_callbacks());
+    patchStubId = __glDispatchRegisterStubCallbacksSize(stub_get_patch_callbacks(),
+            sizeof(__GLdispatchStubPatchCallbacks));
 }
 
 #if defined(USE_ATTRIBUTE_CONSTRUCTOR)
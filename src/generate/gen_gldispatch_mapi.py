@@ -35,12 +35,17 @@ Generates the glapi_mapi_tmp.h header file from Khronos's XML file.
 import sys
 import xml.etree.ElementTree as etree
 import os.path
+import json
 
 import genCommon
 
 def _main():
-    target = sys.argv[1]
-    xmlFiles = sys.argv[2:]
+    args = sys.argv[1:]
+    profile = None
+    if (len(args) > 0 and args[0].startswith("--profile=")):
+        profile = args.pop(0)[len("--profile="):]
+    target = args[0]
+    xmlFiles = args[1:]
 
     roots = [ etree.parse(filename).getroot() for filename in xmlFiles ]
     allFunctions = genCommon.getFunctionsFromRoots(roots)
@@ -76,7 +81,12 @@ typedef void (APIENTRY  *GLDEBUGPROCKHR)(GLenum source,GLenum type,GLuint id,GLe
     print(generate_noop_array(functions))
     print(generate_public_stubs(functions))
     print(generate_public_entries(functions))
-    print(generate_stub_asm_gcc(functions, (target == "gldispatch")))
+
+    order = list(range(len(functions)))
+    if (profile):
+        order = order_by_profile(functions, read_profile(profile))
+    print(generate_stub_positions(order))
+    print(generate_stub_asm_gcc([functions[i] for i in order], (target == "gldispatch")))
 
 def generate_defines(functions):
     text = r"""
@@ -92,10 +102,94 @@ def generate_defines(functions):
     text += "#endif /* MAPI_TMP_DEFINES */\n"
     return text
 
+_MASK64 = 0xffffffffffffffff
+_FNV_OFFSET = 0xcbf29ce484222325
+_FNV_PRIME = 0x100000001b3
+
+def _fnv1a(data, h=_FNV_OFFSET):
+    for c in bytearray(data):
+        h ^= c
+        h = (h * _FNV_PRIME) & _MASK64
+    return h
+
+def hash_function_names(functions):
+    """
+    Returns a 64-bit FNV-1a hash of the function names, in slot order.
+
+    This identifies the layout of the static part of the dispatch table, so
+    that anything which caches slot numbers can tell when it changes.
+    """
+    h = _FNV_OFFSET
+    for func in functions:
+        h = _fnv1a(func.name.encode("ascii") + b"\0", h)
+    return h
+
+def _stub_hash_mix(h, d):
+    """
+    Mixes a displacement value into a name hash. This must match
+    stub_hash_mix in stub.c.
+    """
+    h ^= (d * 0x9e3779b97f4a7c15) & _MASK64
+    h ^= h >> 33
+    h = (h * 0xff51afd7ed558ccd) & _MASK64
+    h ^= h >> 33
+    return h & 0xffffffff
+
+def build_perfect_hash(names):
+    """
+    Builds a minimal perfect hash for a list of names, using the
+    hash-and-displace method.
+
+    Each name is hashed once with FNV-1a. The high 32 bits pick a bucket, and
+    each bucket has a displacement value that's mixed with the hash to pick a
+    slot in the table. Buckets with a single name just store the slot directly,
+    as a negative number.
+
+    Returns a tuple of (displacements, table), where table[i] is the index of
+    the name that hashes to slot i.
+    """
+    count = len(names)
+    if count == 0:
+        return ([0], [None])
+
+    numBuckets = (count + 3) // 4
+    hashes = [_fnv1a(name.encode("ascii")) for name in names]
+    buckets = [[] for i in range(numBuckets)]
+    for (i, h) in enumerate(hashes):
+        buckets[(h >> 32) % numBuckets].append(i)
+
+    displace = [0] * numBuckets
+    table = [None] * count
+    order = sorted(range(numBuckets), key=lambda b: len(buckets[b]), reverse=True)
+    for b in order:
+        bucket = buckets[b]
+        if len(bucket) <= 1:
+            break
+        d = 0
+        while True:
+            slots = [_stub_hash_mix(hashes[i], d) % count for i in bucket]
+            if len(set(slots)) == len(slots) and all(table[s] is None for s in slots):
+                break
+            d += 1
+            if d >= 0x7fffffff:
+                raise ValueError("Can't build a perfect hash for the stub names")
+        displace[b] = d
+        for (i, s) in zip(bucket, slots):
+            table[s] = i
+
+    free = [s for s in range(count) if table[s] is None]
+    for b in order:
+        if len(buckets[b]) == 1:
+            s = free.pop()
+            displace[b] = -s - 1
+            table[s] = buckets[b][0]
+    return (displace, table)
+
 def generate_table(functions, allFunctions):
     text = "#ifdef MAPI_TMP_TABLE\n"
     text += "#define MAPI_TABLE_NUM_STATIC %d\n" % (len(allFunctions))
     text += "#define MAPI_TABLE_NUM_DYNAMIC %d\n" % (genCommon.MAPI_TABLE_NUM_DYNAMIC,)
+    text += "#define MAPI_TABLE_STATIC_HASH 0x%016xULL\n" % (hash_function_names(allFunctions),)
     text += "#undef MAPI_TMP_TABLE\n"
     text += "#endif /* MAPI_TMP_TABLE */\n"
     return text
@@ -142,6 +236,19 @@ def generate_public_stubs(functions):
     text += "static const struct mapi_stub public_stubs[] = {\n"
     for func in functions:
         text += "   { \"%s\", %d },\n" % (func.name, func.slot)
+    text += "};\n\n"
+
+    (displace, table) = build_perfect_hash([func.name for func in functions])
+    text += "static const int public_stub_hash_displace[] = {\n"
+    for d in displace:
+        text += "   %d,\n" % (d,)
+    text += "};\n\n"
+    text += "static const struct mapi_stub_hash public_stub_hash[] = {\n"
+    for i in table:
+        if i is None:
+            text += "   { 0, 0xFFFF },\n"
+        else:
+            text += "   { %d, %d },\n" % (i, len(functions[i].name))
     text += "};\n"
     text += "#undef MAPI_TMP_PUBLIC_STUBS\n"
     text += "#endif /* MAPI_TMP_PUBLIC_STUBS */\n"
@@ -151,16 +258,16 @@ def generate_public_entries(functions):
     text = "#ifdef MAPI_TMP_PUBLIC_ENTRIES\n"
 
     for func in functions:
-        retStr = ("return " if func.hasReturn() else "")
+        tailCall = ("ENTRY_TAIL_RETURN" if func.hasReturn() else "ENTRY_TAIL_CALL")
         text += r"""
 GLAPI {f.rt} APIENTRY {f.name}({f.decArgs})
 {{
    const struct _glapi_table *_tbl = entry_current_get();
    mapi_func _func = ((const mapi_func *) _tbl)[{f.slot}];
-   {retStr}(({f.rt} (APIENTRY *)({f.decArgs})) _func)({f.callArgs});
+   {tailCall}((({f.rt} (APIENTRY *)({f.decArgs})) _func)({f.callArgs}));
 }}
 
-""".lstrip("\n").format(f=func, retStr=retStr)
+""".lstrip("\n").format(f=func, tailCall=tailCall)
 
     text += "\n"
     text += "static const mapi_func public_entries[] = {\n"
@@ -171,6 +278,51 @@ GLAPI {f.rt} APIENTRY {f.name}({f.decArgs})
     text += "#endif /* MAPI_TMP_PUBLIC_ENTRIES */\n"
     return text
 
+def read_profile(filename):
+    """
+    Reads a profile of call counts, and returns a dictionary of function names
+    to counts.
+
+    The file can be the JSON output from __GLVND_CALL_COUNTS_FILE, in which
+    case the counts are taken from the "total" object, or a single JSON object
+    mapping each function name to a count.
+    """
+    with open(filename) as f:
+        profile = json.load(f)
+    if (isinstance(profile.get("total"), dict)):
+        profile = profile["total"]
+    return dict((name, count) for (name, count) in profile.items()
+            if isinstance(count, (int, float)) and count > 0)
+
+def order_by_profile(functions, counts):
+    """
+    Returns the order to emit the stubs in. Every function in the profile comes
+    first, from the most calls to the fewest, followed by everything else in
+    slot order.
+
+    Only the order of the stubs changes. The dispatch table slots stay the
+    same.
+    """
+    hot = [i for i in range(len(functions)) if functions[i].name in counts]
+    hot.sort(key=lambda i: (-counts[functions[i].name], i))
+    hotSet = set(hot)
+    return hot + [i for i in range(len(functions)) if i not in hotSet]
+
+def generate_stub_positions(order):
+    text = "#ifdef MAPI_TMP_STUB_POSITIONS\n"
+    if (order != sorted(order)):
+        positions = [0] * len(order)
+        for (pos, i) in enumerate(order):
+            positions[i] = pos
+        text += "#define MAPI_STUB_POSITIONS_REORDERED 1\n"
+        text += "static const unsigned short public_stub_positions[] = {\n"
+        for pos in positions:
+            text += "   %d,\n" % (pos,)
+        text += "};\n"
+    text += "#undef MAPI_TMP_STUB_POSITIONS\n"
+    text += "#endif /* MAPI_TMP_STUB_POSITIONS */\n"
+    return text
+
 def generate_stub_asm_gcc(functions, includeDynamic):
     text = "#ifdef MAPI_TMP_STUB_ASM_GCC\n"
     text += "__asm__(\n"
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include "config_files.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "utils_misc.h"
+
+static int ScandirFilter(const struct dirent *ent)
+{
+#if defined(HAVE_DIRENT_DTYPE)
+    // Ignore the entry if we know that it's not a regular file or symlink.
+    if (ent->d_type != DT_REG && ent->d_type != DT_LNK && ent->d_type != DT_UNKNOWN) {
+        return 0;
+    }
+#endif
+
+    // Otherwise, select any JSON files.
+    if (fnmatch("*.json", ent->d_name, 0) == 0) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+static int CompareFilenames(const struct dirent **ent1, const struct dirent **ent2)
+{
+    return strcmp((*ent1)->d_name, (*ent2)->d_name);
+}
+
+void ForEachConfigFile(const char *dirName, ConfigFileCallback callback)
+{
+    struct dirent **entries = NULL;
+    size_t dirnameLen;
+    const char *pathSep;
+    int count;
+    int i;
+
+    count = scandir(dirName, &entries, ScandirFilter, CompareFilenames);
+    if (count <= 0) {
+        return;
+    }
+
+    // Check if dirName ends with a "/" character. If it doesn't, then we need
+    // to add one when we construct the full file paths below.
+    dirnameLen = strlen(dirName);
+    if (dirnameLen > 0 && dirName[dirnameLen - 1] != '/') {
+        pathSep = "/";
+    } else {
+        pathSep = "";
+    }
+
+    for (i=0; i<count; i++) {
+        char *path = NULL;
+        if (glvnd_asprintf(&path, "%s%s%s", dirName, pathSep, entries[i]->d_name) > 0) {
+            callback(path);
+            free(path);
+        } else {
+            fprintf(stderr, "ERROR: Could not allocate config file path name\n");
+        }
+        free(entries[i]);
+    }
+
+    free(entries);
+}
+
+cJSON *ReadJSONFile(const char *filename)
+{
+    FILE *in = NULL;
+    char *buf = NULL;
+    cJSON *root = NULL;
+    struct stat st;
+
+    in = fopen(filename, "r");
+    if (in == NULL) {
+        goto done;
+    }
+
+    if (fstat(fileno(in), &st) != 0) {
+        goto done;
+    }
+
+    buf = (char *) malloc(st.st_size + 1);
+    if (buf == NULL) {
+        goto done;
+    }
+
+    if (fread(buf, st.st_size, 1, in) != 1) {
+        goto done;
+    }
+    buf[st.st_size] = '\0';
+
+    root = cJSON_Parse(buf);
+
+done:
+    if (in != NULL) {
+        fclose(in);
+    }
+    free(buf);
+    return root;
+}
+
+int CheckConfigFormatVersion(const char *versionStr, int major, int minor)
+{
+    int fileMajor, fileMinor, fileRev;
+    int len;
+
+    fileMajor = fileMinor = fileRev = -1;
+    len = sscanf(versionStr, "%d.%d.%d", &fileMajor, &fileMinor, &fileRev);
+    if (len < 1) {
+        return 0;
+    }
+    if (len < 2) {
+        fileMinor = 0;
+    }
+    if (fileMajor != major || fileMinor > minor) {
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#if !defined(CONFIG_FILES_H)
+#define CONFIG_FILES_H
+
+/*!
+ * \file
+ *
+ * Functions for reading the JSON config files that libEGL uses to find vendor
+ * libraries and that libGLdispatch uses to find layers.
+ */
+
+#include "cJSON.h"
+
+/*!
+ * A callback for \c ForEachConfigFile.
+ *
+ * \param filename The path to the config file.
+ */
+typedef void (* ConfigFileCallback) (const char *filename);
+
+/*!
+ * Calls \p callback for each JSON file in a directory, sorted by filename.
+ *
+ * If the directory doesn't exist or can't be read, then this does nothing.
+ */
+void ForEachConfigFile(const char *dirName, ConfigFileCallback callback);
+
+/*!
+ * Reads and parses a JSON file.
+ *
+ * \return The parsed JSON tree, or NULL on error. The caller must free it with
+ * cJSON_Delete.
+ */
+cJSON *ReadJSONFile(const char *filename);
+
+/*!
+ * Checks the "file_format_version" value from a config file.
+ *
+ * The major version has to match exactly. The minor version will be
+ * incremented if we ever add an optional value to the JSON format that the
+ * reader has to pay attention to. That is, an older file will still work, but
+ * a file with a newer format than the reader understands should fail.
+ *
+ * \param versionStr The version string, in "major.minor.rev" format.
+ * \param major The major version that the caller supports.
+ * \param minor The highest minor version that the caller supports.
+ * \return Non-zero if the version is supported.
+ */
+int CheckConfigFormatVersion(const char *versionStr, int major, int minor);
+
+#endif // CONFIG_FILES_H
@@ -520,6 +520,39 @@ fail:
     funcs->is_singlethreaded = 1;
 }
 
+#if defined(__GLIBC__)
+/*
+ * This is what pthread_atfork uses internally. Calling it directly lets us
+ * pass in our own __dso_handle without linking against libpthread, and glibc
+ * removes the handler when the library is unloaded.
+ */
+extern int __register_atfork(void (*prepare) (void), void (*parent) (void),
+        void (*child) (void), void *dso_handle);
+extern void *__dso_handle __attribute__((visibility("hidden")));
+#endif
+
+int volatile __glvndForkGeneration = 0;
+int __glvndForkHandlerInstalled = 0;
+
+static void OnForkChild(void)
+{
+    // The child process only has one thread, so this doesn't need to be
+    // atomic.
+    __glvndForkGeneration++;
+}
+
+void glvndSetupForkHandler(void)
+{
+    if (__glvndForkHandlerInstalled) {
+        return;
+    }
+#if defined(__GLIBC__)
+    if (__register_atfork(NULL, NULL, OnForkChild, __dso_handle) == 0) {
+        __glvndForkHandlerInstalled = 1;
+    }
+#endif
+}
+
 void glvndCleanupPthreads(void)
 {
     if (dlhandle != NULL) {
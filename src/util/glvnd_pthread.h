@@ -28,6 +28,7 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <unistd.h>
 
 /*
  * pthread wrapper functions used to prevent the vendor-neutral library from
@@ -156,6 +157,46 @@ void glvndSetupPthreads(void);
 
 void glvndCleanupPthreads(void);
 
+/*!
+ * \brief Installs a fork handler that counts forks.
+ *
+ * After this, \c glvndGetForkGeneration returns a value that changes in the
+ * child process after every fork.
+ *
+ * The handler has to be removed if the library is unloaded, so this only
+ * installs one where we can tie it to the calling library (currently, glibc's
+ * __register_atfork). Otherwise, \c glvndGetForkGeneration falls back to
+ * returning the process ID.
+ */
+void glvndSetupForkHandler(void);
+
+/*!
+ * The number of forks since \c glvndSetupForkHandler was called. Use
+ * \c glvndGetForkGeneration instead of reading this directly.
+ */
+extern int volatile __glvndForkGeneration;
+
+/*!
+ * Non-zero if \c glvndSetupForkHandler installed a fork handler.
+ */
+extern int __glvndForkHandlerInstalled;
+
+/*!
+ * Returns a value that changes in the child process after a fork.
+ *
+ * If a fork handler is installed, then this is just a load of
+ * \c __glvndForkGeneration, so it's cheap enough to call from every
+ * entrypoint.
+ */
+static inline int glvndGetForkGeneration(void)
+{
+    if (__glvndForkHandlerInstalled) {
+        return __glvndForkGeneration;
+    } else {
+        return (int) getpid();
+    }
+}
+
 
 
 #endif // __GLVND_PTHREAD_H__
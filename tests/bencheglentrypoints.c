@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/**
+ * \file
+ *
+ * Measures the fixed overhead of an EGL entrypoint in libEGL.
+ *
+ * This calls eglGetError and eglGetCurrentContext over and over, which don't
+ * need a display or a vendor library, so the time is mostly the fork check
+ * and the current thread state lookup that every EGL entrypoint does. With
+ * more than one thread, every thread runs the same loop at once.
+ *
+ * To compare two versions of libEGL, run this from both builds.
+ */
+
+#include <EGL/egl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_CALL_COUNT 10000000
+#define MAX_THREADS 64
+
+typedef struct {
+    const char *name;
+    void (* func) (void);
+} BenchFunc;
+
+static void CallGetError(void)
+{
+    eglGetError();
+}
+
+static void CallGetCurrentContext(void)
+{
+    eglGetCurrentContext();
+}
+
+static const BenchFunc BENCH_FUNCS[] = {
+    { "eglGetError", CallGetError },
+    { "eglGetCurrentContext", CallGetCurrentContext },
+};
+
+static long callCount = DEFAULT_CALL_COUNT;
+static const BenchFunc *currentFunc = NULL;
+
+static double GetTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void *BenchThread(void *param)
+{
+    void (* func) (void) = currentFunc->func;
+    long i;
+
+    for (i=0; i<callCount; i++) {
+        func();
+    }
+    return NULL;
+}
+
+static int RunBench(const BenchFunc *bench, int numThreads)
+{
+    pthread_t threads[MAX_THREADS];
+    double start, elapsed;
+    int i;
+
+    currentFunc = bench;
+    start = GetTime();
+    for (i=0; i<numThreads; i++) {
+        if (pthread_create(&threads[i], NULL, BenchThread, NULL) != 0) {
+            printf("pthread_create failed\n");
+            return 0;
+        }
+    }
+    for (i=0; i<numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed = GetTime() - start;
+
+    printf("%-24s %2d threads: %6.2f ns/call\n", bench->name, numThreads,
+            elapsed * 1000000000.0 / callCount);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int numThreads = 1;
+    int i;
+
+    if (argc > 1) {
+        callCount = atol(argv[1]);
+    }
+    if (argc > 2) {
+        numThreads = atoi(argv[2]);
+    }
+    if (callCount <= 0 || numThreads <= 0 || numThreads > MAX_THREADS) {
+        printf("Usage: %s [calls] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    // Make the first call outside of the timed loop, so that it doesn't
+    // include any one-time setup.
+    eglGetError();
+
+    for (i=0; i<(int) (sizeof(BENCH_FUNCS) / sizeof(BENCH_FUNCS[0])); i++) {
+        if (!RunBench(&BENCH_FUNCS[i], numThreads)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/**
+ * \file
+ *
+ * Measures how long the first eglMakeCurrent call takes, with and without the
+ * vendor library's getProcAddresses callback.
+ *
+ * The first eglMakeCurrent for a vendor is the one that fills in that vendor's
+ * GL dispatch table, so each sample runs in a separate child process.
+ */
+
+#include <EGL/egl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "dummy/EGL_dummy.h"
+
+#define DEFAULT_SAMPLE_COUNT 20
+
+static double GetTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static int RunSample(double *result)
+{
+    EGLDisplay dpy;
+    EGLContext ctx;
+    double start;
+
+    dpy = eglGetPlatformDisplay(EGL_DUMMY_PLATFORM, "dummy0", NULL);
+    if (dpy == EGL_NO_DISPLAY) {
+        printf("eglGetPlatformDisplay failed\n");
+        return 0;
+    }
+    ctx = eglCreateContext(dpy, NULL, EGL_NO_CONTEXT, NULL);
+    if (ctx == EGL_NO_CONTEXT) {
+        printf("eglCreateContext failed\n");
+        return 0;
+    }
+
+    start = GetTime();
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        printf("eglMakeCurrent failed\n");
+        return 0;
+    }
+    *result = GetTime() - start;
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, ctx);
+    return 1;
+}
+
+static int RunChild(double *result)
+{
+    int fds[2];
+    pid_t pid;
+    int status;
+    int ok;
+
+    if (pipe(fds) != 0) {
+        return 0;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        return 0;
+    } else if (pid == 0) {
+        double value;
+        close(fds[0]);
+        if (!RunSample(&value)) {
+            _exit(1);
+        }
+        if (write(fds[1], &value, sizeof(value)) != sizeof(value)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    ok = (read(fds[0], result, sizeof(*result)) == sizeof(*result));
+    close(fds[0]);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+        ok = 0;
+    }
+    return ok;
+}
+
+static int RunMode(const char *label, const char *envValue, int samples)
+{
+    double total = 0.0;
+    double best = 0.0;
+    int i;
+
+    setenv("GLVND_TEST_GET_PROC_ADDRESSES", envValue, 1);
+    for (i=0; i<samples; i++) {
+        double value;
+        if (!RunChild(&value)) {
+            printf("Sample %d failed\n", i);
+            return 0;
+        }
+        total += value;
+        if (i == 0 || value < best) {
+            best = value;
+        }
+    }
+
+    printf("%-20s mean %8.1f us, best %8.1f us\n", label,
+            total * 1000000.0 / samples, best * 1000000.0);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int samples = DEFAULT_SAMPLE_COUNT;
+
+    if (argc > 1) {
+        samples = atoi(argv[1]);
+        if (samples <= 0) {
+            printf("Usage: %s [samples]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!RunMode("getProcAddress", "0", samples)) {
+        return 1;
+    }
+    if (!RunMode("getProcAddresses", "1", samples)) {
+        return 1;
+    }
+    return 0;
+}
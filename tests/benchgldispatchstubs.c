@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/**
+ * \file
+ *
+ * Measures the cost of calling through the static dispatch stubs.
+ *
+ * This calls a small set of stubs over and over, and then every static stub in
+ * a shuffled order, so that the stubs don't all fit in the instruction cache.
+ * Where perf events are available, it also reports the L1 instruction cache
+ * and iTLB misses for each call.
+ *
+ * To compare the compact stubs against the default layout, run this from two
+ * builds, one with and one without --enable-compact-dispatch-stubs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define BENCH_USE_PERF 1
+#endif
+
+#include <GLdispatch.h>
+
+#define DEFAULT_CALL_COUNT 50000000
+#define HOT_STUB_COUNT 16
+
+typedef void (* BenchProc) (void);
+
+static char **stubNames = NULL;
+static int stubNameCount = 0;
+static int stubNameCapacity = 0;
+
+static void BenchNoop(void)
+{
+}
+
+static void *BenchGetProcAddress(const char *procName, void *param)
+{
+    if (stubNameCount >= stubNameCapacity) {
+        int newCapacity = (stubNameCapacity > 0 ? stubNameCapacity * 2 : 1024);
+        char **newNames = realloc(stubNames, newCapacity * sizeof(char *));
+        if (newNames == NULL) {
+            return (void *) BenchNoop;
+        }
+        stubNames = newNames;
+        stubNameCapacity = newCapacity;
+    }
+    stubNames[stubNameCount] = strdup(procName);
+    if (stubNames[stubNameCount] != NULL) {
+        stubNameCount++;
+    }
+    return (void *) BenchNoop;
+}
+
+static double GetTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+#if defined(BENCH_USE_PERF)
+static int OpenCacheCounter(unsigned long long cache)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = cache
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void StartCounter(int fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static long long StopCounter(int fd)
+{
+    long long value;
+
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+#endif // defined(BENCH_USE_PERF)
+
+static void PrintMisses(const char *label, long long misses, long calls)
+{
+    if (misses >= 0) {
+        printf(", %s %.4f", label, (double) misses / calls);
+    } else {
+        printf(", %s n/a", label);
+    }
+}
+
+static void RunCalls(const char *label, BenchProc *procs, int count, long calls)
+{
+    long passes = calls / count;
+    long long icacheMisses = -1;
+    long long itlbMisses = -1;
+    double start, elapsed;
+    long i;
+    int j;
+#if defined(BENCH_USE_PERF)
+    int icacheFd = OpenCacheCounter(PERF_COUNT_HW_CACHE_L1I);
+    int itlbFd = OpenCacheCounter(PERF_COUNT_HW_CACHE_ITLB);
+#endif
+
+    if (passes <= 0) {
+        passes = 1;
+    }
+    calls = passes * count;
+
+    // Run once through first, so that the dispatch table and any lazily
+    // resolved symbols are warmed up.
+    for (j=0; j<count; j++) {
+        procs[j]();
+    }
+
+#if defined(BENCH_USE_PERF)
+    StartCounter(icacheFd);
+    StartCounter(itlbFd);
+#endif
+    start = GetTime();
+    for (i=0; i<passes; i++) {
+        for (j=0; j<count; j++) {
+            procs[j]();
+        }
+    }
+    elapsed = GetTime() - start;
+#if defined(BENCH_USE_PERF)
+    icacheMisses = StopCounter(icacheFd);
+    itlbMisses = StopCounter(itlbFd);
+    if (icacheFd >= 0) {
+        close(icacheFd);
+    }
+    if (itlbFd >= 0) {
+        close(itlbFd);
+    }
+#endif
+
+    printf("%-6s %5d stubs: %6.2f ns/call", label, count,
+            elapsed * 1000000000.0 / calls);
+    PrintMisses("L1i misses/call", icacheMisses, calls);
+    PrintMisses("iTLB misses/call", itlbMisses, calls);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    __GLdispatchThreadState threadState;
+    __GLdispatchTable *dispatch;
+    BenchProc *procs;
+    long calls = DEFAULT_CALL_COUNT;
+    int vendorID;
+    int count = 0;
+    int i;
+
+    if (argc > 1) {
+        calls = atol(argv[1]);
+        if (calls <= 0) {
+            printf("Usage: %s [calls]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    __glDispatchInit();
+    vendorID = __glDispatchNewVendorID();
+    dispatch = __glDispatchCreateTable(BenchGetProcAddress, NULL);
+    if (dispatch == NULL) {
+        printf("__glDispatchCreateTable failed\n");
+        return 1;
+    }
+
+    // Making the table current fills in all of the static slots, so that's
+    // where the names of the static stubs come from.
+    memset(&threadState, 0, sizeof(threadState));
+    if (!__glDispatchMakeCurrent(&threadState, dispatch, vendorID, NULL)) {
+        printf("__glDispatchMakeCurrent failed\n");
+        return 1;
+    }
+
+    procs = malloc(stubNameCount * sizeof(BenchProc));
+    if (procs == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (i=0; i<stubNameCount; i++) {
+        BenchProc proc = (BenchProc) __glDispatchGetProcAddress(stubNames[i]);
+        if (proc != NULL) {
+            procs[count++] = proc;
+        }
+    }
+    if (count < HOT_STUB_COUNT) {
+        printf("Only found %d stubs\n", count);
+        return 1;
+    }
+
+    RunCalls("hot", procs, HOT_STUB_COUNT, calls);
+
+    // Shuffle the stubs with a fixed seed, so that each run uses the same
+    // order, but the hardware prefetcher can't just walk through them.
+    srand(1);
+    for (i=count - 1; i>0; i--) {
+        int k = rand() % (i + 1);
+        BenchProc temp = procs[i];
+        procs[i] = procs[k];
+        procs[k] = temp;
+    }
+    RunCalls("all", procs, count, calls);
+
+    __glDispatchLoseCurrent();
+    __glDispatchDestroyTable(dispatch);
+    __glDispatchFini();
+
+    for (i=0; i<stubNameCount; i++) {
+        free(stubNames[i]);
+    }
+    free(stubNames);
+    free(procs);
+    return 0;
+}
@@ -26,12 +26,14 @@
 #include "EGL_dummy.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include "glvnd/libeglabi.h"
 #include "glvnd_list.h"
 #include "glvnd_pthread.h"
 #include "compiler.h"
+#include "patchentrypoints.h"
 
 enum
 {
@@ -84,6 +86,7 @@ static struct glvnd_list threadStateList = { &threadStateList, &threadStateList
 static struct glvnd_list displayList = { &displayList, &displayList };
 static glvnd_mutex_t displayListLock = GLVND_MUTEX_INITIALIZER;
 static EGLint failNextMakeCurrentError = EGL_NONE;
+static int glProcLookupCount = 0;
 
 static glvnd_mutex_t contextListLock = GLVND_MUTEX_INITIALIZER;
 static struct glvnd_list contextList = { &contextList, &contextList };
@@ -647,6 +650,11 @@ static const GLubyte *dummy_glGetString(GLenum name)
     return NULL;
 }
 
+static void dummy_glGetIntegerv(GLenum pname, GLint *data)
+{
+    *data = DUMMY_GL_INTEGER_VALUE;
+}
+
 static void *CommonTestDispatch(const char *funcName,
         EGLDisplay dpy, EGLDeviceEXT dev,
         EGLint command, EGLAttrib param)
@@ -666,6 +674,8 @@ static void *CommonTestDispatch(const char *funcName,
     } else if (command == DUMMY_COMMAND_FAIL_NEXT_MAKE_CURRENT) {
         failNextMakeCurrentError = (EGLint) param;
         return DUMMY_VENDOR_NAME;
+    } else if (command == DUMMY_COMMAND_GET_GL_PROC_COUNT) {
+        return (void *) (intptr_t) glProcLookupCount;
     } else {
         printf("Invalid command: %d\n", command);
         abort();
@@ -880,6 +890,7 @@ static const struct {
     PROC_ENTRY(eglLabelObjectKHR),
 
     PROC_ENTRY(glGetString),
+    PROC_ENTRY(glGetIntegerv),
 #undef PROC_ENTRY
     { NULL, NULL }
 };
@@ -887,6 +898,10 @@ static const struct {
 static void *dummyGetProcAddress(const char *procName)
 {
     int i;
+
+    if (strncmp(procName, "gl", 2) == 0) {
+        __sync_fetch_and_add(&glProcLookupCount, 1);
+    }
     for (i=0; PROC_ADDRESSES[i].name != NULL; i++) {
         if (strcmp(procName, PROC_ADDRESSES[i].name) == 0) {
             return PROC_ADDRESSES[i].addr;
@@ -901,6 +916,36 @@ static void *dummyGetProcAddress(const char *procName)
     return NULL;
 }
 
+/*
+ * The same functions as dummyGetProcAddress, for dummyGetProcAddresses.
+ */
+static DummyProcHashEntry procHash[DUMMY_PROC_HASH_SIZE];
+
+static void dummyInitProcHash(void)
+{
+    int i;
+
+    for (i=0; PROC_ADDRESSES[i].name != NULL; i++) {
+        dummyProcHashAdd(procHash, PROC_ADDRESSES[i].name, PROC_ADDRESSES[i].addr);
+    }
+    for (i=0; i < DI_COUNT; i++) {
+        dummyProcHashAdd(procHash, EGL_EXTENSION_PROCS[i].name, EGL_EXTENSION_PROCS[i].addr);
+    }
+}
+
+static EGLBoolean dummyGetProcAddresses(const char * const *procNames,
+        int first, int count, void **procs)
+{
+    int i;
+
+    // Every dispatch table slot is a GL function.
+    __sync_fetch_and_add(&glProcLookupCount, count);
+    for (i=first; i<first + count; i++) {
+        procs[i] = dummyProcHashFind(procHash, procNames[i]);
+    }
+    return EGL_TRUE;
+}
+
 static void *dummyFindDispatchFunction(const char *name)
 {
     int i;
@@ -964,6 +1009,14 @@ __egl_Main(uint32_t version, const __EGLapiExports *exports,
     imports->getDispatchAddress = dummyFindDispatchFunction;
     imports->setDispatchIndex = dummySetDispatchIndex;
 
+    if (EGL_VENDOR_ABI_GET_MINOR_VERSION(version) >= 3) {
+        const char *env = getenv("GLVND_TEST_GET_PROC_ADDRESSES");
+        if (env != NULL && atoi(env) != 0) {
+            dummyInitProcHash();
+            imports->getProcAddresses = dummyGetProcAddresses;
+        }
+    }
+
     return EGL_TRUE;
 }
 
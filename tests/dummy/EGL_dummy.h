@@ -100,8 +100,19 @@ enum
     DUMMY_COMMAND_GET_VENDOR_NAME,
     DUMMY_COMMAND_GET_CURRENT_CONTEXT,
     DUMMY_COMMAND_FAIL_NEXT_MAKE_CURRENT,
+
+    /**
+     * Returns the number of times that the vendor's getProcAddress callback
+     * has been asked for a GL function.
+     */
+    DUMMY_COMMAND_GET_GL_PROC_COUNT,
 };
 
+/**
+ * The value that the dummy vendor's glGetIntegerv returns for any parameter.
+ */
+#define DUMMY_GL_INTEGER_VALUE 0x10DD
+
 /**
  * The struct that an EGLContext points to. This is used to test
  * eglCreateContext and eglMakeCurrent.
@@ -62,6 +62,10 @@ static void dummy_glXExampleExtensionFunction2(Display *dpy, int screen, int *re
 static void dispatch_glXExampleExtensionFunction2(Display *dpy, int screen, int *retval);
 static void dummy_glXMakeCurrentTestResults(GLboolean *saw, GLContextCounts *counts);
 static void dispatch_glXMakeCurrentTestResults(GLboolean *saw, GLContextCounts *counts);
+static void dummy_glXPrefetchDrawablesVendorDUMMY(Display *dpy,
+        const GLXDrawable *drawables, int count, int *retval);
+static void dispatch_glXPrefetchDrawablesVendorDUMMY(Display *dpy,
+        const GLXDrawable *drawables, int count, int *retval);
 
 enum
 {
@@ -69,6 +73,7 @@ enum
     DI_glXExampleExtensionFunction2,
     DI_glXCreateContextVendorDUMMY,
     DI_glXMakeCurrentTestResults,
+    DI_glXPrefetchDrawablesVendorDUMMY,
     DI_COUNT,
 };
 static struct {
@@ -82,6 +87,7 @@ static struct {
     PROC_ENTRY(glXExampleExtensionFunction2),
     PROC_ENTRY(glXCreateContextVendorDUMMY),
     PROC_ENTRY(glXMakeCurrentTestResults),
+    PROC_ENTRY(glXPrefetchDrawablesVendorDUMMY),
 #undef PROC_ENTRY
 };
 
@@ -543,6 +549,38 @@ static void dispatch_glXMakeCurrentTestResults(GLboolean *saw, GLContextCounts *
     }
 }
 
+static void dummy_glXPrefetchDrawablesVendorDUMMY(Display *dpy,
+        const GLXDrawable *drawables, int count, int *retval)
+{
+    *retval = count;
+}
+
+static void dispatch_glXPrefetchDrawablesVendorDUMMY(Display *dpy,
+        const GLXDrawable *drawables, int count, int *retval)
+{
+    PFNGLXPREFETCHDRAWABLESVENDORDUMMYPROC func;
+    __GLXvendorInfo *vendor;
+    const int index = glxExtensionProcs[DI_glXPrefetchDrawablesVendorDUMMY].index;
+
+    *retval = -1;
+    if (count <= 0) {
+        return;
+    }
+
+    apiExports->prefetchDrawableVendors(dpy, drawables, count);
+
+    vendor = apiExports->vendorFromDrawable(dpy, drawables[0]);
+    if (!vendor) {
+        return;
+    }
+
+    func = (PFNGLXPREFETCHDRAWABLESVENDORDUMMYPROC)
+        apiExports->fetchDispatchEntry(vendor, index);
+    if (func) {
+        func(dpy, drawables, count, retval);
+    }
+}
+
 static void dummy_glXExampleExtensionFunction(Display *dpy, int screen, int *retval)
 {
     // Indicate that we've called the real function, and not a dispatch stub
@@ -668,6 +706,35 @@ static void         *dummyGetProcAddress         (const GLubyte *procName)
     return NULL;
 }
 
+/*
+ * The same functions as dummyGetProcAddress, for dummyGetProcAddresses.
+ */
+static DummyProcHashEntry procHash[DUMMY_PROC_HASH_SIZE];
+
+static void          dummyInitProcHash           (void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_LEN(procAddresses); i++) {
+        dummyProcHashAdd(procHash, procAddresses[i].name, procAddresses[i].addr);
+    }
+    for (i = 0; i < DI_COUNT; i++) {
+        dummyProcHashAdd(procHash, glxExtensionProcs[i].name, glxExtensionProcs[i].addr);
+    }
+}
+
+static Bool          dummyGetProcAddresses       (const GLubyte * const *procNames,
+                                                  int first, int count,
+                                                  void **procs)
+{
+    int i;
+
+    for (i = first; i < first + count; i++) {
+        procs[i] = dummyProcHashFind(procHash, (const char *) procNames[i]);
+    }
+    return True;
+}
+
 static void         *dummyGetDispatchAddress     (const GLubyte *procName)
 {
     int i;
@@ -731,6 +798,13 @@ PUBLIC Bool __glx_Main(uint32_t version,
                 imports->initiatePatch = dummyInitiatePatch;
             }
 
+            // getProcAddresses was added in version 1.1 of the ABI.
+            if (GLX_VENDOR_ABI_GET_MINOR_VERSION(version) >= 1
+                    && GetEnvFlag("GLVND_TEST_GET_PROC_ADDRESSES")) {
+                dummyInitProcHash();
+                imports->getProcAddresses = dummyGetProcAddresses;
+            }
+
             return True;
         }
     }
@@ -85,4 +85,17 @@ typedef GLXContext (* PFNGLXCREATECONTEXTVENDORDUMMYPROC) (Display *dpy,
         GLXFBConfig config, GLXContext share_list, Bool direct,
         const int *attrib_list);
 
+/**
+ * glXPrefetchDrawablesVendorDUMMY(): Dummy extension function that takes
+ * several drawables.
+ *
+ * The dispatch function calls the prefetchDrawableVendors export for all of
+ * the drawables, and then dispatches based on the first one. The vendor
+ * function sets *retval to \p count.
+ *
+ * This is used to test looking up drawable vendors in a batch.
+ */
+typedef void (* PFNGLXPREFETCHDRAWABLESVENDORDUMMYPROC) (Display *dpy,
+        const GLXDrawable *drawables, int count, int *retval);
+
 #endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/*
+ * A GL dispatch layer for testing. It counts calls to glVertex3fv and passes
+ * them on, and it provides a glDummyLayerGetCountGLVND function that returns
+ * the count and resets it.
+ */
+
+#include <string.h>
+#include <GL/gl.h>
+
+#include "glvnd/libgllayerabi.h"
+#include "compiler.h"
+
+typedef void (* pfn_glVertex3fv) (const GLfloat *v);
+
+static __thread void * const *nextTable;
+static int slot_glVertex3fv = -1;
+static int vertexCallCount;
+
+static void dummyLayer_glVertex3fv(const GLfloat *v)
+{
+    vertexCallCount++;
+    ((pfn_glVertex3fv) nextTable[slot_glVertex3fv])(v);
+}
+
+static GLint dummyLayer_glDummyLayerGetCountGLVND(void)
+{
+    GLint count = vertexCallCount;
+    vertexCallCount = 0;
+    return count;
+}
+
+static void *dummyLayerGetProcAddress(const char *procName, int slot, void *param)
+{
+    if (strcmp(procName, "glVertex3fv") == 0) {
+        slot_glVertex3fv = slot;
+        return dummyLayer_glVertex3fv;
+    } else if (strcmp(procName, "glDummyLayerGetCountGLVND") == 0) {
+        return dummyLayer_glDummyLayerGetCountGLVND;
+    } else {
+        return NULL;
+    }
+}
+
+static void dummyLayerSetNextTable(void * const *next, void *param)
+{
+    nextTable = next;
+}
+
+PUBLIC GLboolean __gl_layer_Main(uint32_t version, __GLlayerImports *imports)
+{
+    if (GL_LAYER_ABI_GET_MAJOR_VERSION(version) != GL_LAYER_ABI_MAJOR_VERSION) {
+        return GL_FALSE;
+    }
+
+    imports->getProcAddress = dummyLayerGetProcAddress;
+    imports->setNextTable = dummyLayerSetNextTable;
+    return GL_TRUE;
+}
@@ -39,21 +39,27 @@ static void patch_x86_64(char *writeEntry, const char *execEntry,
     // here uses a 64-bit address. Cast incrementPtr to a 64-bit integer so
     // that it's the right size for either build.
     uint64_t incrementAddr = (uint64_t) ((uintptr_t) incrementPtr);
-    const char tmpl[] = {
+    const char endbr[] = {
         0xf3, 0x0f, 0x1e, 0xfa,                               // endbr64
-        0xa1, 0xf0, 0xde, 0xbc, 0x9a, 0x78, 0x56, 0x34, 0x12, // movabs 0x123456789abcdef0, %eax
-        0x83, 0xc0, 0x01,                                     // add    $0x1,%eax
-        0xa3, 0xf0, 0xde, 0xbc, 0x9a, 0x78, 0x56, 0x34, 0x12, // movabs %eax,0x123456789abcdef0
-        0xc3,                                                 // ret
+    };
+    const char tmpl[] = {
+        0x48, 0xb8, 0xf0, 0xde, 0xbc, 0x9a, 0x78, 0x56, 0x34, 0x12, // movabs $0x123456789abcdef0, %rax
+        0xff, 0x00,                                                 // incl (%rax)
+        0xc3,                                                       // ret
     };
 
     if (stubSize < sizeof(tmpl)) {
         return;
     }
 
+    // The compact 16-byte stubs don't have room for the endbr64. It's only
+    // needed with IBT enabled, though, so leave it off if it doesn't fit.
+    if (stubSize >= sizeof(endbr) + sizeof(tmpl)) {
+        memcpy(writeEntry, endbr, sizeof(endbr));
+        writeEntry += sizeof(endbr);
+    }
     memcpy(writeEntry, tmpl, sizeof(tmpl));
-    memcpy(writeEntry + 5, &incrementAddr, sizeof(incrementAddr));
-    memcpy(writeEntry + 17, &incrementAddr, sizeof(incrementAddr));
+    memcpy(writeEntry + 2, &incrementAddr, sizeof(incrementAddr));
 
 #else
     assert(0); // Should not be calling this
@@ -329,3 +335,46 @@ GLboolean dummyPatchFunction(int type, int stubSize,
     return GL_TRUE;
 }
 
+static unsigned int dummyProcHashName(const char *name)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (; *name != '\0'; name++) {
+        hash = (hash ^ (unsigned char) *name) * 16777619u;
+    }
+    return hash;
+}
+
+void dummyProcHashAdd(DummyProcHashEntry *table, const char *name, void *addr)
+{
+    unsigned int i = dummyProcHashName(name);
+    int probes;
+
+    for (probes = 0; probes < DUMMY_PROC_HASH_SIZE; probes++, i++) {
+        DummyProcHashEntry *entry = &table[i & (DUMMY_PROC_HASH_SIZE - 1)];
+        if (entry->name == NULL) {
+            entry->name = name;
+            entry->addr = addr;
+            return;
+        } else if (strcmp(entry->name, name) == 0) {
+            return;
+        }
+    }
+    assert(!"The dummy function table is full");
+}
+
+void *dummyProcHashFind(const DummyProcHashEntry *table, const char *name)
+{
+    unsigned int i = dummyProcHashName(name);
+    int probes;
+
+    for (probes = 0; probes < DUMMY_PROC_HASH_SIZE; probes++, i++) {
+        const DummyProcHashEntry *entry = &table[i & (DUMMY_PROC_HASH_SIZE - 1)];
+        if (entry->name == NULL) {
+            break;
+        } else if (strcmp(entry->name, name) == 0) {
+            return entry->addr;
+        }
+    }
+    return NULL;
+}
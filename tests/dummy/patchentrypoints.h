@@ -40,4 +40,32 @@ GLboolean dummyPatchFunction(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset,
         const char *name, int *incrementPtr);
 
+/**
+ * The number of buckets in a DummyProcHashEntry table. This must be a power
+ * of two, and should be well over the number of functions in the table.
+ */
+#define DUMMY_PROC_HASH_SIZE 256
+
+/**
+ * A hash table of a dummy vendor's functions, so that its getProcAddresses
+ * callback can look up each dispatch table slot in a single pass instead of
+ * searching its function list for every name.
+ */
+typedef struct DummyProcHashEntryRec {
+    const char *name;
+    void *addr;
+} DummyProcHashEntry;
+
+/**
+ * Adds a function to a table with DUMMY_PROC_HASH_SIZE entries. If \p name is
+ * already in the table, then the first address is kept, the same as a linear
+ * search would find.
+ */
+void dummyProcHashAdd(DummyProcHashEntry *table, const char *name, void *addr);
+
+/**
+ * Looks up a function in a table that was filled in with dummyProcHashAdd.
+ */
+void *dummyProcHashFind(const DummyProcHashEntry *table, const char *name);
+
 #endif // ENTRYPOINTPATCHING_H
@@ -44,6 +44,7 @@ int main(int argc, char **argv)
     EGLDisplay dpy;
     EGLContext ctx;
     const char *result;
+    int i;
 
     pfn_eglTestDispatchDisplay ptr_eglTestDispatchDisplay;
     pfn_eglTestDispatchCurrent ptr_eglTestDispatchCurrent;
@@ -70,6 +71,16 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // A GL function that no vendor supports should also return NULL, since
+    // all of the vendors are already loaded. Check it twice, since the second
+    // lookup should come from libGLdispatch's cache of unknown names.
+    for (i=0; i<2; i++) {
+        if (eglGetProcAddress("glNonExistantFunctionGLVND") != NULL) {
+            printf("Got a pointer to a non-existant GL function.\n");
+            return 1;
+        }
+    }
+
     // Test a built-in EGL function.
     result = ptr_eglQueryString(dpy, EGL_VENDOR);
     checkResult("eglQueryString", result);
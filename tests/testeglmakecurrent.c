@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "dummy/EGL_dummy.h"
 #include "egl_test_utils.h"
@@ -45,6 +47,7 @@ void checkIsCurrent(const TestContextInfo *ci);
 void testSwitchContext(const TestContextInfo *oldCi, const TestContextInfo *ci);
 void testSwitchContextFail(const TestContextInfo *oldCi,
         const TestContextInfo *newCi, const TestContextInfo *failCi);
+void testFork(const TestContextInfo *ci);
 
 int main(int argc, char **argv)
 {
@@ -128,6 +131,9 @@ int main(int argc, char **argv)
     printf("Test failed ctx1 -> ctx3 (different vendor, new vendor fails)\n");
     testSwitchContextFail(NULL, &contexts[2], &contexts[2]);
 
+    printf("Test fork with ctx1 current\n");
+    testFork(&contexts[0]);
+
     // Cleanup.
 
     eglMakeCurrent(EGL_NO_DISPLAY, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -235,3 +241,31 @@ void testSwitchContextFail(const TestContextInfo *oldCi,
     checkIsCurrent(oldCi);
 }
 
+
+void testFork(const TestContextInfo *ci)
+{
+    pid_t pid;
+    int status;
+
+    testSwitchContext(NULL, ci);
+
+    pid = fork();
+    if (pid < 0) {
+        printf("fork failed\n");
+        exit(1);
+    } else if (pid == 0) {
+        // libEGL should notice the fork on the next call and reset its state,
+        // so the child process doesn't have a current context.
+        checkIsCurrent(NULL);
+        _exit(0);
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+            || WEXITSTATUS(status) != 0) {
+        printf("Child process failed\n");
+        exit(1);
+    }
+
+    // The parent process should be unaffected.
+    checkIsCurrent(ci);
+}
@@ -2,4 +2,8 @@
 
 . $TOP_SRCDIR/tests/eglenv.sh
 
+set -e
+
 ./testeglmakecurrent
+
+GLVND_TEST_GET_PROC_ADDRESSES=1 ./testeglmakecurrent
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "dummy/EGL_dummy.h"
+#include "egl_test_utils.h"
+
+/*
+ * This tests libGLdispatch's on-disk cache of vendor functions. It's run
+ * twice with __GLVND_PROC_CACHE_DIR set to an empty directory.
+ *
+ * With -s, there isn't a cache file yet, so libGLdispatch should look up
+ * every function from the vendor library and then write a cache file.
+ *
+ * With -l, it should load the functions from the cache file instead of
+ * asking the vendor library for them.
+ *
+ * Either way, the functions in the dispatch table should be the same ones
+ * that the vendor library's getProcAddress callback returns.
+ */
+
+/*
+ * libGLdispatch looks up one function (glGetString) to identify the vendor
+ * library, so loading a cache shouldn't need any more lookups than this.
+ * Filling in a table without the cache takes a lookup for every static
+ * stub, which is a lot more.
+ */
+#define MAX_LOAD_LOOKUPS 8
+
+static int GetLookupCount(EGLDisplay dpy)
+{
+    return (int) (intptr_t) ptr_eglTestDispatchDisplay(dpy,
+            DUMMY_COMMAND_GET_GL_PROC_COUNT, 0);
+}
+
+int main(int argc, char **argv)
+{
+    EGLDisplay dpy;
+    EGLContext ctx;
+    const char *str;
+    GLint value = 0;
+    int expectLoad = -1;
+    int lookups;
+
+    while (1) {
+        int opt = getopt(argc, argv, "sl");
+        if (opt == -1) {
+            break;
+        }
+        switch (opt) {
+        case 's':
+            expectLoad = 0;
+            break;
+        case 'l':
+            expectLoad = 1;
+            break;
+        default:
+            return 1;
+        }
+    }
+    if (expectLoad < 0) {
+        printf("Usage: %s -s|-l\n", argv[0]);
+        return 1;
+    }
+
+    loadEGLExtensions();
+
+    dpy = eglGetPlatformDisplay(EGL_DUMMY_PLATFORM,
+            (void *) DUMMY_VENDOR_NAMES[0], NULL);
+    if (dpy == EGL_NO_DISPLAY) {
+        printf("eglGetPlatformDisplay failed\n");
+        return 1;
+    }
+    ctx = eglCreateContext(dpy, NULL, EGL_NO_CONTEXT, NULL);
+    if (ctx == EGL_NO_CONTEXT) {
+        printf("eglCreateContext failed\n");
+        return 1;
+    }
+
+    // The dispatch table gets filled in the first time a context from the
+    // vendor is made current.
+    lookups = GetLookupCount(dpy);
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        printf("eglMakeCurrent failed\n");
+        return 1;
+    }
+    lookups = GetLookupCount(dpy) - lookups;
+    printf("Looked up %d GL functions\n", lookups);
+
+    if (expectLoad && lookups > MAX_LOAD_LOOKUPS) {
+        printf("Expected the dispatch table to come from the cache\n");
+        return 1;
+    } else if (!expectLoad && lookups <= MAX_LOAD_LOOKUPS) {
+        printf("Expected the dispatch table to be looked up from the vendor\n");
+        return 1;
+    }
+
+    // Make sure that the functions in the table are the ones that the vendor
+    // library returns, and that functions the vendor doesn't support still
+    // go to a no-op.
+    str = (const char *) glGetString(GL_VENDOR);
+    if (str == NULL || strcmp(str, DUMMY_VENDOR_NAMES[0]) != 0) {
+        printf("glGetString returned \"%s\", expected \"%s\"\n",
+                str ? str : "(null)", DUMMY_VENDOR_NAMES[0]);
+        return 1;
+    }
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &value);
+    if (value != DUMMY_GL_INTEGER_VALUE) {
+        printf("glGetIntegerv returned 0x%x, expected 0x%x\n",
+                value, DUMMY_GL_INTEGER_VALUE);
+        return 1;
+    }
+    glVertex3f(0.0f, 0.0f, 0.0f);
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, ctx);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+
+. $TOP_SRCDIR/tests/eglenv.sh
+
+set -e
+
+__GLVND_PROC_CACHE_DIR=$(mktemp -d)
+export __GLVND_PROC_CACHE_DIR
+trap 'rm -rf "$__GLVND_PROC_CACHE_DIR"' EXIT
+
+# The first run should look up every function and write a cache file.
+./testeglproccache -s
+ls "$__GLVND_PROC_CACHE_DIR"/*.cache > /dev/null
+before=$(ls -i "$__GLVND_PROC_CACHE_DIR"/*.cache)
+
+# The second run should load the cache file, and it shouldn't write a new
+# one. Writing the cache always replaces the file, so the inode would change.
+./testeglproccache -l
+after=$(ls -i "$__GLVND_PROC_CACHE_DIR"/*.cache)
+if test "$before" != "$after"; then
+    echo "The cache file was rewritten instead of being loaded"
+    exit 1
+fi
+
+# A cache file that someone else could have written should be ignored.
+cache=$(ls "$__GLVND_PROC_CACHE_DIR"/*.cache)
+chmod g+w "$cache"
+./testeglproccache -s
+# The file that replaced it shouldn't be writable by anyone else.
+ls -l "$cache" | grep -q '^-rw-------'
+
+chmod g+w "$__GLVND_PROC_CACHE_DIR"
+./testeglproccache -s
+chmod g-w "$__GLVND_PROC_CACHE_DIR"
+
+mv "$cache" "$__GLVND_PROC_CACHE_DIR/target"
+ln -s target "$cache"
+./testeglproccache -s
@@ -28,8 +28,34 @@
 #include <string.h>
 #include <getopt.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <GL/gl.h>
 
+#if defined(GLDISPATCH_ENABLE_PATCHING) && defined(GLDISPATCH_USE_TLS) \
+    && defined(HAVE_LINUX_MEMBARRIER_H) && !defined(GLDISPATCH_COMPACT_STUBS) \
+    && !defined(GLDISPATCH_RUNTIME_STUBS) \
+    && defined(__x86_64__) && !defined(__ILP32__)
+#define TEST_CONCURRENT_PATCH 1
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+#if defined(GLDISPATCH_ENABLE_PATCHING) && defined(HAVE_MEMFD_CREATE) \
+    && defined(__linux__)
+#include <errno.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#if defined(__NR_mmap) && defined(__NR_mprotect) && defined(SECCOMP_MODE_FILTER)
+#define TEST_WRITE_XOR_EXEC 1
+#endif
+#endif
+
 #include <GLdispatch.h>
 
 #include "dummy/patchentrypoints.h"
@@ -47,6 +73,7 @@ enum {
 };
 
 typedef void (* pfn_glVertex3fv) (const GLfloat *v);
+typedef GLint (* pfn_glDummyLayerGetCount) (void);
 
 typedef struct DummyVendorLibRec {
     pfn_glVertex3fv vertexProc;
@@ -60,6 +87,10 @@ typedef struct DummyVendorLibRec {
     __GLdispatchPatchCallbacks patchCallbacks;
 
     int callCounts[CALL_INDEX_COUNT];
+    int testProcLookupCount;
+    int initiatePatchCount;
+    int reusePatchCount;
+    int threadAttachCount;
 } DummyVendorLib;
 
 static void InitDummyVendors(void);
@@ -67,24 +98,51 @@ static void CleanupDummyVendors(void);
 
 static void *ForceMultiThreadedProc(void *param);
 
+static void ResetCallCounts(void);
+static GLboolean CheckCallCounts(int expectedVendorIndex, int expectedCallIndex, int count);
+
+static GLboolean TestProbe(void);
+static GLboolean GetGeneratedProc(void);
+static GLboolean TestGenerateWhileCurrent(int vendorIndex);
 static GLboolean TestDispatch(int vendorIndex,
         GLboolean testStatic, GLboolean testGenerated);
+static GLboolean TestReusePatch(void);
+static GLboolean TestThreadAttach(void);
+static GLboolean CheckLayerCount(int expected);
+static GLboolean CheckStubMode(const char *expected);
+
+// The first entry is the current dispatch table.
+extern const void *_glapi_Current[];
+static GLboolean ConcurrentPatchSupported(void);
+static GLboolean EnforceWriteXorExec(void);
+static GLboolean TestConcurrentPatch(void);
+static void *ConcurrentPatchProc(void *param);
 
 static void *common_getProcAddressCallback(const char *procName, void *param, int vendorIndex);
 static GLboolean common_InitiatePatch(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset, int vendorIndex);
+static GLboolean common_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset, int vendorIndex);
 
 static void *dummy0_getProcAddressCallback(const char *procName, void *param);
 static void dummy0_glVertex3fv(const GLfloat *v);
 static void dummy0_glDummyTestProc(const GLfloat *v);
 static GLboolean dummy0_InitiatePatch(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset);
+static void dummy0_ReusePatch(void);
+static void dummy0_ThreadAttach(void);
+static GLboolean dummy0_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset);
 
 static void *dummy1_getProcAddressCallback(const char *procName, void *param);
 static void dummy1_glVertex3fv(const GLfloat *v);
 static void dummy1_glDummyTestProc(const GLfloat *v);
 static GLboolean dummy1_InitiatePatch(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset);
+static void dummy1_ReusePatch(void);
+static void dummy1_ThreadAttach(void);
+static GLboolean dummy1_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset);
 
 static void *dummy2_getProcAddressCallback(const char *procName, void *param);
 static void dummy2_glVertex3fv(const GLfloat *v);
@@ -98,19 +156,37 @@ static DummyVendorLib dummyVendors[DUMMY_VENDOR_COUNT] = {
 
 static pfn_glVertex3fv ptr_glVertex3fv;
 static pfn_glVertex3fv ptr_glDummyTestProc;
+static pfn_glDummyLayerGetCount ptr_glDummyLayerGetCount;
 
 static GLboolean enableStaticTest = GL_FALSE;
 static GLboolean enableGeneratedTest = GL_FALSE;
 static GLboolean enablePatching = GL_FALSE;
 static GLboolean forceMultiThreaded = GL_FALSE;
 static GLboolean useLastGenerated = GL_FALSE;
+static GLboolean useOverflowGenerated = GL_FALSE;
+static GLboolean expectLayer = GL_FALSE;
+static GLboolean testConcurrentPatch = GL_FALSE;
+static GLboolean testReusePatch = GL_FALSE;
+static GLboolean testWriteXorExec = GL_FALSE;
+static GLboolean testDirectPatch = GL_FALSE;
+static const __GLdispatchPatchCallbacks *directPatchCallbacks;
+static const char *expectStubMode = NULL;
+static GLboolean generateWhileCurrent = GL_FALSE;
+
+enum {
+    CONCURRENT_STATE_STARTING,
+    CONCURRENT_STATE_RUNNING,
+    CONCURRENT_STATE_STOP,
+    CONCURRENT_STATE_FAILED,
+};
+static volatile int concurrentState = CONCURRENT_STATE_STARTING;
 
 int main(int argc, char **argv)
 {
     int i;
 
     while (1) {
-        int opt = getopt(argc, argv, "sgptl");
+        int opt = getopt(argc, argv, "sgptloycrwdnm:");
         if (opt == -1) {
             break;
         }
@@ -130,6 +206,30 @@ int main(int argc, char **argv)
         case 'l':
             useLastGenerated = GL_TRUE;
             break;
+        case 'o':
+            useOverflowGenerated = GL_TRUE;
+            break;
+        case 'y':
+            expectLayer = GL_TRUE;
+            break;
+        case 'c':
+            testConcurrentPatch = GL_TRUE;
+            break;
+        case 'r':
+            testReusePatch = GL_TRUE;
+            break;
+        case 'w':
+            testWriteXorExec = GL_TRUE;
+            break;
+        case 'd':
+            testDirectPatch = GL_TRUE;
+            break;
+        case 'n':
+            generateWhileCurrent = GL_TRUE;
+            break;
+        case 'm':
+            expectStubMode = optarg;
+            break;
         default:
             return 1;
         }
@@ -138,8 +238,9 @@ int main(int argc, char **argv)
 #if !defined(USE_DISPATCH_ASM)
     // If the assembly dispatch stubs aren't enabled, then generating and
     // patching entrypoints won't work. In that case, exit with 77 to tell
-    // automake to skip the test instead of failing.
-    if (enablePatching || enableGeneratedTest)
+    // automake to skip the test instead of failing. The layer test needs a
+    // generated stub for the layer's own function, too.
+    if (enablePatching || enableGeneratedTest || expectLayer)
     {
         return 77;
     }
@@ -152,6 +253,67 @@ int main(int argc, char **argv)
     }
 #endif
 
+#if !defined(HAVE_MEMFD_CREATE)
+    // Without memfd_create, libGLdispatch can't save the patched entrypoints.
+    if (testReusePatch)
+    {
+        return 77;
+    }
+#endif
+
+#if !defined(__x86_64__) && !defined(__i386__)
+    // libGLdispatch's own patching only supports x86 and x86-64.
+    if (testDirectPatch)
+    {
+        return 77;
+    }
+#endif
+
+    if (testDirectPatch && !enablePatching) {
+        printf("Testing direct patching requires -p\n");
+        return 1;
+    }
+
+    if (generateWhileCurrent && (enablePatching || !enableGeneratedTest)) {
+        // A stub that's generated after the entrypoints are patched
+        // wouldn't be patched, so the call counts wouldn't match.
+        printf("Generating a stub while current requires -g, and can't be used with -p\n");
+        return 1;
+    }
+
+    if (testReusePatch && !enablePatching) {
+        printf("Testing reused patches requires -p\n");
+        return 1;
+    }
+
+    if (testConcurrentPatch) {
+        if (!enablePatching) {
+            printf("Testing concurrent patching requires -p\n");
+            return 1;
+        }
+        if (!ConcurrentPatchSupported()) {
+            printf("Concurrent patching isn't supported, skipping\n");
+            return 77;
+        }
+    }
+
+    if (testWriteXorExec) {
+        if (!EnforceWriteXorExec()) {
+            printf("Can't enforce W^X, skipping\n");
+            return 77;
+        }
+    }
+
+    if (expectStubMode != NULL && !CheckStubMode(expectStubMode)) {
+#if defined(GLDISPATCH_RUNTIME_STUBS)
+        return 1;
+#else
+        // The stub mode can only be changed at runtime if it was enabled at
+        // build time, so just skip the test otherwise.
+        return 77;
+#endif
+    }
+
     __glDispatchInit();
     InitDummyVendors();
 
@@ -170,34 +332,58 @@ int main(int argc, char **argv)
     }
 
     if (enableGeneratedTest) {
-        if (useLastGenerated) {
+        if (useLastGenerated || useOverflowGenerated) {
             // Get enough dispatch stubs so that the one we test is at the very
-            // end of the dispatch table. On some architectures, loading from a
-            // high index can be more complicated than a low index, so make
-            // sure we got it right.
-            for (i=0; i<4095; i++) {
-                char name[32];
+            // end of the assembly dispatch stubs, or past the end of them. On
+            // some architectures, loading from a high index can be more
+            // complicated than a low index, so make sure we got it right.
+            int count = (useOverflowGenerated ? 4095 + 1500 : 4095);
+            for (i=0; i<count; i++) {
+                char name[48];
                 snprintf(name, sizeof(name), "glDummyTestPaddingGLVND_%d", i);
                 __GLdispatchProc proc = __glDispatchGetProcAddress(name);
                 if (proc == NULL) {
+                    if (i >= 4095) {
+                        // Not every architecture can generate stubs past
+                        // the end of the assembly stubs.
+                        printf("No dispatch function for %d, skipping\n", i);
+                        return 77;
+                    }
                     printf("Can't find padding dispatch function for %d\n", i);
                     return 1;
                 }
             }
         }
-        ptr_glDummyTestProc = (pfn_glVertex3fv) __glDispatchGetProcAddress(GENERATED_FUNCTION_NAME);
-        if (ptr_glDummyTestProc == NULL) {
-            printf("Can't find dispatch function for %s\n", GENERATED_FUNCTION_NAME);
+        // With -n, the stub gets generated in TestDispatch instead, after
+        // the first vendor is current.
+        if (!generateWhileCurrent && !GetGeneratedProc()) {
             return 1;
         }
-        if (useLastGenerated) {
-            // We should have reached the end of the dispatch table by now, so
-            // another __glDispatchGetProcAddress call should return NULL.
-            __GLdispatchProc proc = __glDispatchGetProcAddress("glDummyTestPaddingGLVND_last");
-            if (proc != NULL) {
-                printf("Got dispatch function past the end of the dispatch table.\n");
-                return 1;
-            }
+        if (!TestProbe()) {
+            return 1;
+        }
+    }
+
+    if (expectLayer) {
+        // This function comes from the dummy layer, so none of the vendors
+        // know about it.
+        ptr_glDummyLayerGetCount = (pfn_glDummyLayerGetCount)
+            __glDispatchGetProcAddress("glDummyLayerGetCountGLVND");
+        if (ptr_glDummyLayerGetCount == NULL) {
+            printf("Can't find dispatch function for glDummyLayerGetCountGLVND\n");
+            return 1;
+        }
+    }
+
+    if (testConcurrentPatch) {
+        if (!TestConcurrentPatch()) {
+            return 1;
+        }
+    }
+
+    if (enablePatching && !testDirectPatch) {
+        if (!TestThreadAttach()) {
+            return 1;
         }
     }
 
@@ -207,6 +393,23 @@ int main(int argc, char **argv)
         }
     }
 
+    if (testReusePatch) {
+        if (!TestReusePatch()) {
+            return 1;
+        }
+    }
+
+    if (enableGeneratedTest) {
+        // With no current context, the generated stub should go to a no-op
+        // function.
+        printf("Testing generated dispatch without a current context\n");
+        ResetCallCounts();
+        ptr_glDummyTestProc(NULL);
+        if (!CheckCallCounts(-1, -1, 0)) {
+            return 1;
+        }
+    }
+
     CleanupDummyVendors();
     __glDispatchFini();
     return 0;
@@ -236,7 +439,25 @@ static void InitDummyVendors(void)
         }
     }
 
-    if (enablePatching) {
+    if (enablePatching && testDirectPatch) {
+        // Let libGLdispatch patch the entrypoints to call the vendor's
+        // functions directly. The initiatePatch callbacks just count the
+        // calls and then pass them along.
+        directPatchCallbacks = __glDispatchGetDirectPatchCallbacks();
+
+        dummyVendors[0].patchCallbacks = *directPatchCallbacks;
+        dummyVendors[0].patchCallbacks.initiatePatch = dummy0_DirectInitiatePatch;
+        dummyVendors[0].patchCallbacksPtr = &dummyVendors[0].patchCallbacks;
+
+        dummyVendors[1].patchCallbacks = *directPatchCallbacks;
+        dummyVendors[1].patchCallbacks.initiatePatch = dummy1_DirectInitiatePatch;
+        dummyVendors[1].patchCallbacksPtr = &dummyVendors[1].patchCallbacks;
+
+        if (testReusePatch) {
+            dummyVendors[0].patchCallbacks.reusePatch = dummy0_ReusePatch;
+            dummyVendors[1].patchCallbacks.reusePatch = dummy1_ReusePatch;
+        }
+    } else if (enablePatching) {
         dummyVendors[0].patchCallbacks.isPatchSupported = dummyCheckPatchSupported;
         dummyVendors[0].patchCallbacks.initiatePatch = dummy0_InitiatePatch;
         dummyVendors[0].patchCallbacksPtr = &dummyVendors[0].patchCallbacks;
@@ -244,6 +465,18 @@ static void InitDummyVendors(void)
         dummyVendors[1].patchCallbacks.isPatchSupported = dummyCheckPatchSupported;
         dummyVendors[1].patchCallbacks.initiatePatch = dummy1_InitiatePatch;
         dummyVendors[1].patchCallbacksPtr = &dummyVendors[1].patchCallbacks;
+
+        dummyVendors[0].patchCallbacks.threadAttach = dummy0_ThreadAttach;
+        dummyVendors[1].patchCallbacks.threadAttach = dummy1_ThreadAttach;
+
+        if (testReusePatch) {
+            dummyVendors[0].patchCallbacks.reusePatch = dummy0_ReusePatch;
+            dummyVendors[1].patchCallbacks.reusePatch = dummy1_ReusePatch;
+        }
+        if (testConcurrentPatch) {
+            dummyVendors[0].patchCallbacks.initiatePatchConcurrent = dummy0_InitiatePatch;
+            dummyVendors[1].patchCallbacks.initiatePatchConcurrent = dummy1_InitiatePatch;
+        }
     }
 }
 
@@ -293,12 +526,116 @@ static GLboolean CheckCallCounts(int expectedVendorIndex, int expectedCallIndex,
     return result;
 }
 
+static int probeCount = 0;
+
+static void *ProbeCallback(const char *procName, void *param)
+{
+    probeCount++;
+    return NULL;
+}
+
+/*
+ * Checks that __glDispatchProbeProcAddress doesn't generate a stub for a name
+ * that the probe callback rejects, and that it remembers the name.
+ */
+static GLboolean TestProbe(void)
+{
+    static const char *UNKNOWN_NAME = "glDummyProbeTestGLVND";
+    int i;
+
+    printf("Testing probed lookups\n");
+    for (i=0; i<2; i++) {
+        if (__glDispatchProbeProcAddress(UNKNOWN_NAME, ProbeCallback, NULL) != NULL) {
+            printf("Got a dispatch function for %s\n", UNKNOWN_NAME);
+            return GL_FALSE;
+        }
+    }
+    if (probeCount != 1) {
+        printf("Probe callback called %d times, expected 1\n", probeCount);
+        return GL_FALSE;
+    }
+
+    __glDispatchResetProbeCache();
+    if (__glDispatchProbeProcAddress(UNKNOWN_NAME, ProbeCallback, NULL) != NULL
+            || probeCount != 2) {
+        printf("Probe cache wasn't reset\n");
+        return GL_FALSE;
+    }
+
+    // A function that already has a stub shouldn't need to be probed.
+    if (__glDispatchProbeProcAddress("glVertex3fv", ProbeCallback, NULL)
+            != (__GLdispatchProc) ptr_glVertex3fv || probeCount != 2) {
+        printf("Probe for glVertex3fv didn't return the existing stub\n");
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+static GLboolean GetGeneratedProc(void)
+{
+    ptr_glDummyTestProc = (pfn_glVertex3fv) __glDispatchGetProcAddress(GENERATED_FUNCTION_NAME);
+    if (ptr_glDummyTestProc == NULL) {
+        printf("Can't find dispatch function for %s\n", GENERATED_FUNCTION_NAME);
+        return GL_FALSE;
+    }
+    if (__glDispatchGetProcAddress(GENERATED_FUNCTION_NAME)
+            != (__GLdispatchProc) ptr_glDummyTestProc) {
+        printf("Got a different dispatch function for %s\n", GENERATED_FUNCTION_NAME);
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+/*
+ * Generates the test stub while a vendor is current.
+ *
+ * Where libGLdispatch has resolver trampolines, the current dispatch table
+ * should get one in the new slot, so the vendor shouldn't see a lookup until
+ * the stub is called.
+ */
+static GLboolean TestGenerateWhileCurrent(int vendorIndex)
+{
+    DummyVendorLib *dummyVendor = &dummyVendors[vendorIndex];
+    int i;
+
+    printf("Generating a dispatch function while current\n");
+    dummyVendor->testProcLookupCount = 0;
+    if (!GetGeneratedProc()) {
+        return GL_FALSE;
+    }
+#if defined(USE_X86_64_ASM) && !defined(__ILP32__)
+    if (!expectLayer && dummyVendor->testProcLookupCount != 0) {
+        printf("Vendor %d looked up %s %d times before it was called\n",
+                vendorIndex, GENERATED_FUNCTION_NAME,
+                dummyVendor->testProcLookupCount);
+        return GL_FALSE;
+    }
+#endif
+
+    ResetCallCounts();
+    for (i = 0; i < NUM_GLDISPATCH_CALLS; i++) {
+        ptr_glDummyTestProc(NULL);
+    }
+    if (!CheckCallCounts(vendorIndex, CALL_INDEX_GENERATED, NUM_GLDISPATCH_CALLS)) {
+        return GL_FALSE;
+    }
+    if (dummyVendor->testProcLookupCount > 1) {
+        printf("Vendor %d looked up %s %d times\n", vendorIndex,
+                GENERATED_FUNCTION_NAME, dummyVendor->testProcLookupCount);
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
 static GLboolean TestDispatch(int vendorIndex,
         GLboolean testStatic, GLboolean testGenerated)
 {
     int i;
     GLboolean result = GL_FALSE;
     GLboolean patched = (dummyVendors[vendorIndex].patchCallbacksPtr != NULL);
+    // With direct patching, the entrypoints go straight to the vendor's
+    // normal functions.
+    GLboolean usePatchCounts = (patched && !testDirectPatch);
 
     if (!__glDispatchMakeCurrent(&dummyVendors[vendorIndex].threadState,
                 dummyVendors[vendorIndex].dispatch, dummyVendors[vendorIndex].vendorID,
@@ -308,8 +645,13 @@ static GLboolean TestDispatch(int vendorIndex,
     }
 
     printf("Testing vendor %d, patched = %d\n", vendorIndex, (int) patched);
+    if (testGenerated && ptr_glDummyTestProc == NULL) {
+        if (!TestGenerateWhileCurrent(vendorIndex)) {
+            goto done;
+        }
+    }
     if (testStatic) {
-        int callIndex = (patched ? CALL_INDEX_STATIC_PATCH : CALL_INDEX_STATIC);
+        int callIndex = (usePatchCounts ? CALL_INDEX_STATIC_PATCH : CALL_INDEX_STATIC);
 
         printf("Testing static dispatch through libOpenGL\n");
         ResetCallCounts();
@@ -319,6 +661,9 @@ static GLboolean TestDispatch(int vendorIndex,
         if (!CheckCallCounts(vendorIndex, callIndex, NUM_GLDISPATCH_CALLS)) {
             goto done;
         }
+        if (!CheckLayerCount(NUM_GLDISPATCH_CALLS)) {
+            goto done;
+        }
 
         printf("Testing static dispatch through GetProcAddress\n");
         ResetCallCounts();
@@ -328,10 +673,16 @@ static GLboolean TestDispatch(int vendorIndex,
         if (!CheckCallCounts(vendorIndex, callIndex, NUM_GLDISPATCH_CALLS)) {
             goto done;
         }
+        if (!CheckLayerCount(NUM_GLDISPATCH_CALLS)) {
+            goto done;
+        }
     }
 
     if (testGenerated) {
-        int callIndex = (patched ? CALL_INDEX_GENERATED_PATCH : CALL_INDEX_GENERATED);
+        // The stubs past the end of the assembly stubs can't be patched, so
+        // those always go through the dispatch table.
+        int callIndex = ((usePatchCounts && !useOverflowGenerated)
+                ? CALL_INDEX_GENERATED_PATCH : CALL_INDEX_GENERATED);
 
         printf("Testing generated dispatch\n");
         ResetCallCounts();
@@ -345,11 +696,323 @@ static GLboolean TestDispatch(int vendorIndex,
 
     result = GL_TRUE;
 
+done:
+    __glDispatchLoseCurrent();
+
+    if (result && patched && testDirectPatch && testStatic) {
+        // The patched entrypoints should be restored, so without a current
+        // context, nothing should reach the vendor.
+        printf("Testing direct dispatch without a current context\n");
+        ResetCallCounts();
+        glVertex3fv(NULL);
+        if (!CheckCallCounts(vendorIndex, CALL_INDEX_STATIC, 0)) {
+            result = GL_FALSE;
+        }
+    }
+    return result;
+}
+
+/*
+ * Runs through each vendor again, after they've all been current once.
+ *
+ * The patched entrypoints for vendor 1 should be saved, so switching back to
+ * it shouldn't call initiatePatch again. Vendor 0 gets unloaded first, so it
+ * should have to patch the entrypoints again.
+ */
+static GLboolean TestReusePatch(void)
+{
+    int i;
+
+    __glDispatchForceUnpatch(dummyVendors[0].vendorID);
+
+    for (i=0; i<DUMMY_VENDOR_COUNT; i++) {
+        int initiateCount = dummyVendors[i].initiatePatchCount;
+        int reuseCount = dummyVendors[i].reusePatchCount;
+        int expectReuse = (i == 1);
+
+        printf("Testing reused patch for vendor %d\n", i);
+        if (!TestDispatch(i, enableStaticTest, enableGeneratedTest)) {
+            return GL_FALSE;
+        }
+        if (dummyVendors[i].patchCallbacksPtr == NULL) {
+            continue;
+        }
+        if ((dummyVendors[i].initiatePatchCount == initiateCount) != expectReuse) {
+            printf("Wrong initiatePatch count for vendor %d\n", i);
+            return GL_FALSE;
+        }
+        if (dummyVendors[i].reusePatchCount - reuseCount != expectReuse) {
+            printf("Wrong reusePatch count for vendor %d: Expected %d, got %d\n",
+                    i, expectReuse, dummyVendors[i].reusePatchCount - reuseCount);
+            return GL_FALSE;
+        }
+    }
+    return GL_TRUE;
+}
+
+/*
+ * Patches the entrypoints for vendor 0, then vendor 1, and then vendor 0
+ * again, and checks that vendor 0 gets a threadAttach call for each of its
+ * patches, even though this thread never checked in while vendor 1 owned the
+ * entrypoints.
+ */
+static GLboolean TestThreadAttach(void)
+{
+    static const int VENDOR_ORDER[] = { 0, 1, 0 };
+    int i;
+
+    printf("Testing threadAttach\n");
+    for (i=0; i<(int) (sizeof(VENDOR_ORDER) / sizeof(VENDOR_ORDER[0])); i++) {
+        DummyVendorLib *vendor = &dummyVendors[VENDOR_ORDER[i]];
+        int attachCount = vendor->threadAttachCount;
+
+        if (!__glDispatchMakeCurrent(&vendor->threadState, vendor->dispatch,
+                    vendor->vendorID, vendor->patchCallbacksPtr)) {
+            printf("__glDispatchMakeCurrent failed\n");
+            return GL_FALSE;
+        }
+        __glDispatchLoseCurrent();
+
+        if (i == 1) {
+            continue;
+        }
+
+        // The entrypoints stay patched after LoseCurrent, so the next
+        // window-system call should attach this thread, but only once.
+        __glDispatchCheckMultithreaded();
+        __glDispatchCheckMultithreaded();
+        if (vendor->threadAttachCount != attachCount + 1) {
+            printf("Expected %d threadAttach calls for vendor %d, got %d\n",
+                    attachCount + 1, VENDOR_ORDER[i], vendor->threadAttachCount);
+            return GL_FALSE;
+        }
+    }
+    return GL_TRUE;
+}
+
+/*
+ * Checks how many calls to glVertex3fv went through the dummy layer, if the
+ * layer is supposed to be loaded.
+ */
+static GLboolean CheckLayerCount(int expected)
+{
+    GLint count;
+
+    if (!expectLayer) {
+        return GL_TRUE;
+    }
+
+    count = ptr_glDummyLayerGetCount();
+    if (count != expected) {
+        printf("Wrong layer count: Expected %d, got %d\n", expected, (int) count);
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+static GLboolean CheckStubMode(const char *expected)
+{
+    static const char * const MODE_NAMES[] = {
+        [__GLDISPATCH_STUB_MODE_C] = "c",
+        [__GLDISPATCH_STUB_MODE_TSD] = "tsd",
+        [__GLDISPATCH_STUB_MODE_TLS] = "tls",
+        [__GLDISPATCH_STUB_MODE_TLSDESC] = "tlsdesc",
+    };
+    int mode = __glDispatchGetStubMode();
+    const char *name = "unknown";
+
+    if (mode >= 0 && mode < (int) (sizeof(MODE_NAMES) / sizeof(MODE_NAMES[0]))) {
+        name = MODE_NAMES[mode];
+    }
+    printf("Dispatch stub mode: %s\n", name);
+    if (strcmp(name, expected) != 0) {
+        printf("Expected dispatch stub mode %s\n", expected);
+        return GL_FALSE;
+    }
+
+    // Until the process goes multithreaded, the TSD stubs should find the
+    // dispatch table in _glapi_Current instead of calling _glapi_get_current.
+    if (mode == __GLDISPATCH_STUB_MODE_TSD && _glapi_Current[0] == NULL) {
+        printf("_glapi_Current isn't set for the TSD stubs\n");
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+}
+
+static GLboolean ConcurrentPatchSupported(void)
+{
+#if defined(TEST_CONCURRENT_PATCH)
+    long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    return (cmds >= 0 && (cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE));
+#else
+    return GL_FALSE;
+#endif
+}
+
+/*
+ * Installs a seccomp filter that makes any mmap or mprotect call fail if it
+ * asks for memory that's both writable and executable. Patching still has to
+ * work after this.
+ */
+static GLboolean EnforceWriteXorExec(void)
+{
+#if defined(TEST_WRITE_XOR_EXEC)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const unsigned int protOffset = offsetof(struct seccomp_data, args[2]);
+#else
+    const unsigned int protOffset = offsetof(struct seccomp_data, args[2]) + 4;
+#endif
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mmap, 2, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_mprotect, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, protOffset),
+        BPF_STMT(BPF_ALU | BPF_AND | BPF_K, PROT_WRITE | PROT_EXEC),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PROT_WRITE | PROT_EXEC, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | EPERM),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {
+        sizeof(filter) / sizeof(filter[0]),
+        filter
+    };
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0) {
+        return GL_FALSE;
+    }
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0) {
+        return GL_FALSE;
+    }
+    return GL_TRUE;
+#else
+    return GL_FALSE;
+#endif
+}
+
+/*
+ * Makes vendor 0 current on another thread, which keeps calling glVertex3fv,
+ * and then makes vendor 0 current on this thread with the patch callbacks.
+ * The entrypoints should get patched, and the other thread should switch over
+ * to the patched functions. Any function that the vendor doesn't patch should
+ * still work.
+ *
+ * Before that, it checks that the entrypoints don't get patched if the
+ * vendor doesn't provide initiatePatchConcurrent.
+ */
+static GLboolean TestConcurrentPatch(void)
+{
+    pthread_t thr;
+    time_t startTime;
+    pfn_glVertex3fv ptr_glColor3fv;
+    int initiateCount;
+    GLboolean result = GL_FALSE;
+
+    printf("Testing patching with a context current on another thread\n");
+
+    ResetCallCounts();
+    concurrentState = CONCURRENT_STATE_STARTING;
+    if (pthread_create(&thr, NULL, ConcurrentPatchProc, NULL) != 0) {
+        printf("pthread_create failed\n");
+        return GL_FALSE;
+    }
+
+    while (concurrentState == CONCURRENT_STATE_STARTING) {
+        sched_yield();
+    }
+    if (concurrentState == CONCURRENT_STATE_FAILED) {
+        pthread_join(thr, NULL);
+        return GL_FALSE;
+    }
+
+    initiateCount = dummyVendors[0].initiatePatchCount;
+    dummyVendors[0].patchCallbacks.initiatePatchConcurrent = NULL;
+    if (!__glDispatchMakeCurrent(&dummyVendors[0].threadState,
+                dummyVendors[0].dispatch, dummyVendors[0].vendorID,
+                dummyVendors[0].patchCallbacksPtr)) {
+        printf("__glDispatchMakeCurrent failed\n");
+        concurrentState = CONCURRENT_STATE_STOP;
+        pthread_join(thr, NULL);
+        return GL_FALSE;
+    }
+    __glDispatchLoseCurrent();
+    dummyVendors[0].patchCallbacks.initiatePatchConcurrent = dummy0_InitiatePatch;
+    if (dummyVendors[0].initiatePatchCount != initiateCount) {
+        printf("Patched the entrypoints without initiatePatchConcurrent\n");
+        concurrentState = CONCURRENT_STATE_STOP;
+        pthread_join(thr, NULL);
+        return GL_FALSE;
+    }
+
+    if (!__glDispatchMakeCurrent(&dummyVendors[0].threadState,
+                dummyVendors[0].dispatch, dummyVendors[0].vendorID,
+                dummyVendors[0].patchCallbacksPtr)) {
+        printf("__glDispatchMakeCurrent failed\n");
+        concurrentState = CONCURRENT_STATE_STOP;
+        pthread_join(thr, NULL);
+        return GL_FALSE;
+    }
+
+    // Wait for the other thread to start calling the patched function.
+    startTime = time(NULL);
+    while (((volatile int *) dummyVendors[0].callCounts)[CALL_INDEX_STATIC_PATCH] == 0
+            && time(NULL) - startTime < 10) {
+        sched_yield();
+    }
+
+    concurrentState = CONCURRENT_STATE_STOP;
+    pthread_join(thr, NULL);
+
+    if (dummyVendors[0].callCounts[CALL_INDEX_STATIC_PATCH] == 0) {
+        printf("The other thread never called the patched function\n");
+        goto done;
+    }
+
+    ResetCallCounts();
+    glVertex3fv(NULL);
+    ptr_glVertex3fv(NULL);
+    if (!CheckCallCounts(0, CALL_INDEX_STATIC_PATCH, 2)) {
+        goto done;
+    }
+
+    // The vendor doesn't support glColor3fv, so this should still go to a
+    // no-op.
+    glColor3fv(NULL);
+    ptr_glColor3fv = (pfn_glVertex3fv) __glDispatchGetProcAddress("glColor3fv");
+    if (ptr_glColor3fv == NULL) {
+        printf("Can't find dispatch function for glColor3fv\n");
+        goto done;
+    }
+    ptr_glColor3fv(NULL);
+
+    result = GL_TRUE;
+
 done:
     __glDispatchLoseCurrent();
     return result;
 }
 
+static void *ConcurrentPatchProc(void *param)
+{
+    __GLdispatchThreadState threadState;
+
+    memset(&threadState, 0, sizeof(threadState));
+    if (!__glDispatchMakeCurrent(&threadState, dummyVendors[0].dispatch,
+                dummyVendors[0].vendorID, NULL)) {
+        printf("__glDispatchMakeCurrent failed on the other thread\n");
+        concurrentState = CONCURRENT_STATE_FAILED;
+        return NULL;
+    }
+
+    concurrentState = CONCURRENT_STATE_RUNNING;
+    while (concurrentState == CONCURRENT_STATE_RUNNING) {
+        glVertex3fv(NULL);
+    }
+
+    __glDispatchLoseCurrent();
+    return NULL;
+}
+
 static void *common_getProcAddressCallback(const char *procName, void *param, int vendorIndex)
 {
     DummyVendorLib *dummyVendor = (DummyVendorLib *) param;
@@ -361,6 +1024,7 @@ static void *common_getProcAddressCallback(const char *procName, void *param, in
     if (strcmp(procName, "glVertex3fv") == 0) {
         return dummyVendor->vertexProc;
     } else if (strcmp(procName, GENERATED_FUNCTION_NAME) == 0) {
+        dummyVendor->testProcLookupCount++;
         return dummyVendor->testProc;
     } else {
         return NULL;
@@ -415,6 +1079,8 @@ static void dummy2_glDummyTestProc(const GLfloat *v)
 static GLboolean common_InitiatePatch(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset, int vendorIndex)
 {
+    dummyVendors[vendorIndex].initiatePatchCount++;
+
     if (!dummyPatchFunction(type, stubSize, lookupStubOffset, "Vertex3fv",
                 &dummyVendors[vendorIndex].callCounts[CALL_INDEX_STATIC_PATCH])) {
         return GL_FALSE;
@@ -426,9 +1092,37 @@ static GLboolean common_InitiatePatch(int type, int stubSize,
             return GL_FALSE;
         }
     }
+
+    if (testConcurrentPatch) {
+        void *writePtr;
+        const void *execPtr;
+
+        // Look up a stub without writing anything to it. It has to keep
+        // going through the dispatch table like any other unpatched stub.
+        lookupStubOffset("Color3fv", &writePtr, &execPtr);
+    }
     return GL_TRUE;
 }
 
+static GLboolean common_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset, int vendorIndex)
+{
+    dummyVendors[vendorIndex].initiatePatchCount++;
+    return directPatchCallbacks->initiatePatch(type, stubSize, lookupStubOffset);
+}
+
+static GLboolean dummy0_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset)
+{
+    return common_DirectInitiatePatch(type, stubSize, lookupStubOffset, 0);
+}
+
+static GLboolean dummy1_DirectInitiatePatch(int type, int stubSize,
+        DispatchPatchLookupStubOffset lookupStubOffset)
+{
+    return common_DirectInitiatePatch(type, stubSize, lookupStubOffset, 1);
+}
+
 static GLboolean dummy0_InitiatePatch(int type, int stubSize,
         DispatchPatchLookupStubOffset lookupStubOffset)
 {
@@ -441,3 +1135,23 @@ static GLboolean dummy1_InitiatePatch(int type, int stubSize,
     return common_InitiatePatch(type, stubSize, lookupStubOffset, 1);
 }
 
+
+static void dummy0_ReusePatch(void)
+{
+    dummyVendors[0].reusePatchCount++;
+}
+
+static void dummy1_ReusePatch(void)
+{
+    dummyVendors[1].reusePatchCount++;
+}
+
+static void dummy0_ThreadAttach(void)
+{
+    dummyVendors[0].threadAttachCount++;
+}
+
+static void dummy1_ThreadAttach(void)
+{
+    dummyVendors[1].threadAttachCount++;
+}
@@ -0,0 +1,19 @@
+#!/bin/sh
+
+set -e
+
+__GLVND_CALL_COUNTS_FILE=$(mktemp)
+export __GLVND_CALL_COUNTS_FILE
+trap 'rm -f "$__GLVND_CALL_COUNTS_FILE"' EXIT
+
+# Call counting uses the dispatch trampolines, which are only available on
+# x86-64.
+case "$(uname -m)" in
+    x86_64) ;;
+    *) exit 77 ;;
+esac
+
+./testgldispatch -s -g
+grep -q '"glVertex3fv"' "$__GLVND_CALL_COUNTS_FILE"
+./testgldispatch -g -t
+grep -q '"glDummyTestGLVND"' "$__GLVND_CALL_COUNTS_FILE"
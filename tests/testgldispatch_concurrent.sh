@@ -0,0 +1,6 @@
+#!/bin/sh
+
+set -e
+
+./testgldispatch -s -g -p -c
+./testgldispatch -s -g -p -c -w
@@ -0,0 +1,7 @@
+#!/bin/sh
+
+set -e
+
+./testgldispatch -s -g -p -d
+./testgldispatch -s -g -p -d -t
+./testgldispatch -s -g -p -d -r
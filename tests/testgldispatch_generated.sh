@@ -4,4 +4,4 @@ set -e
 
 ./testgldispatch -g
 ./testgldispatch -g -l
-
+./testgldispatch -g -n
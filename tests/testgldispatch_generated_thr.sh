@@ -4,4 +4,4 @@ set -e
 
 ./testgldispatch -g -t
 ./testgldispatch -g -t -l
-
+./testgldispatch -g -t -n
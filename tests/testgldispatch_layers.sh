@@ -0,0 +1,13 @@
+#!/bin/sh
+
+set -e
+
+__GLVND_LAYER_DIRS=$TOP_SRCDIR/tests/layers
+export __GLVND_LAYER_DIRS
+
+LD_LIBRARY_PATH=$LD_LIBRARY_PATH:$TOP_BUILDDIR/tests/dummy/.libs
+export LD_LIBRARY_PATH
+
+./testgldispatch -s -y
+./testgldispatch -s -g -t -y
+__GLVND_LAZY_DISPATCH_TABLE=1 ./testgldispatch -s -g -y
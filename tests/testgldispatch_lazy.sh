@@ -0,0 +1,10 @@
+#!/bin/sh
+
+set -e
+
+export __GLVND_LAZY_DISPATCH_TABLE=1
+
+./testgldispatch -s
+./testgldispatch -g -l
+./testgldispatch -g -t
+./testgldispatch -s -g -p -t
@@ -0,0 +1,8 @@
+#!/bin/sh
+
+set -e
+
+./testgldispatch -g -o
+./testgldispatch -g -t -o
+./testgldispatch -s -g -p -o
+__GLVND_LAZY_DISPATCH_TABLE=1 ./testgldispatch -g -o
@@ -0,0 +1,6 @@
+#!/bin/sh
+
+set -e
+
+./testgldispatch -s -g -p -r
+./testgldispatch -s -g -p -t -r
@@ -0,0 +1,13 @@
+#!/bin/sh
+
+set -e
+
+# Unless something else is requested, the stubs should read the dispatch
+# table from the static TLS block. The other modes are only available if
+# libglvnd was built with runtime stub selection, so the test is skipped
+# otherwise.
+./testgldispatch -s -g -p -m tls
+__GLVND_DISPATCH_STUBS=tlsdesc ./testgldispatch -s -g -p -m tlsdesc
+__GLVND_DISPATCH_STUBS=tlsdesc ./testgldispatch -s -g -t -m tlsdesc
+__GLVND_DISPATCH_STUBS=tsd ./testgldispatch -s -g -p -m tsd
+__GLVND_DISPATCH_STUBS=tsd ./testgldispatch -s -g -t -m tsd
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/*
+ * Stress test for the lock-free GLXContext map in libGLX.
+ *
+ * One thread keeps adding and removing contexts, which makes the map replace
+ * its table over and over, while several other threads look up contexts. A
+ * lookup must never return the wrong vendor, and a context that stays in the
+ * map the whole time must always be found.
+ *
+ * Before that, it pauses a single lookup and makes the map replace its table
+ * twice during that lookup, to check that the second replacement still waits
+ * for the lookup before freeing the table that the lookup is using.
+ *
+ * The map doesn't look at the contexts or vendors, so this uses made-up
+ * pointers for both, and it doesn't need an X server.
+ *
+ * This includes the map's source file directly, since its functions aren't
+ * exported from libGLX.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+static void TestHook(int point);
+#define CONTEXT_MAP_TEST_HOOK(point) TestHook(point)
+
+#include "libglxcontextmap.c"
+
+#define DEFAULT_THREAD_COUNT 4
+#define DEFAULT_ITERATIONS 2000
+
+/// The number of contexts that stay in the map for the whole test.
+#define STABLE_COUNT 64
+
+/// The number of contexts that the writer adds and then removes each time.
+#define TRANSIENT_COUNT 200
+
+/// How long a paused lookup waits for the writer before it gives up, in ms.
+#define HOOK_TIMEOUT_MS 500
+
+#if GLX_USE_CONTEXT_MAP
+
+static pthread_mutex_t writerMutex = PTHREAD_MUTEX_INITIALIZER;
+static int writerDone = 0;
+
+/// Set in the thread whose lookup TestHook should pause.
+static __thread int isHookThread = 0;
+static int hookPausedAtEpoch = 0;
+static int hookInLookup = 0;
+static int hookWriterDone = 0;
+static sem_t hookReached;
+static sem_t hookResume;
+
+static void TestHook(int point)
+{
+    int i;
+
+    if (!isHookThread) {
+        return;
+    }
+
+    if (point == CONTEXT_MAP_HOOK_LOADED_EPOCH) {
+        // Pause the first time, so that the main thread can replace the
+        // table after this lookup has picked a set of counts, but before it
+        // has incremented one.
+        if (!hookPausedAtEpoch) {
+            hookPausedAtEpoch = 1;
+            sem_post(&hookReached);
+            sem_wait(&hookResume);
+        }
+    } else if (point == CONTEXT_MAP_HOOK_LOADED_TABLE) {
+        // Now the lookup has a table pointer. Wait to see if the main thread
+        // can replace and free that table before the lookup finishes. If the
+        // map works, then it can't, so give up after a while.
+        __atomic_store_n(&hookInLookup, 1, __ATOMIC_SEQ_CST);
+        sem_post(&hookReached);
+        for (i=0; i<HOOK_TIMEOUT_MS; i++) {
+            if (__atomic_load_n(&hookWriterDone, __ATOMIC_SEQ_CST)) {
+                break;
+            }
+            usleep(1000);
+        }
+        __atomic_store_n(&hookInLookup, 0, __ATOMIC_SEQ_CST);
+        isHookThread = 0;
+    }
+}
+
+static GLXContext MakeContext(int index)
+{
+    return (GLXContext) (uintptr_t) ((index + 1) * 16);
+}
+
+static __GLXvendorInfo *ExpectedVendor(GLXContext context)
+{
+    return (__GLXvendorInfo *) ((uintptr_t) context + 8);
+}
+
+static void *ReaderThread(void *param)
+{
+    intptr_t failures = 0;
+    int pass = 0;
+
+    while (!__atomic_load_n(&writerDone, __ATOMIC_ACQUIRE)) {
+        int i;
+        for (i=0; i<STABLE_COUNT; i++) {
+            GLXContext context = MakeContext(i);
+            if (__glXContextMapLookup(context) != ExpectedVendor(context)) {
+                failures++;
+            }
+        }
+        for (i=0; i<TRANSIENT_COUNT; i++) {
+            GLXContext context = MakeContext(STABLE_COUNT + i);
+            __GLXvendorInfo *vendor = __glXContextMapLookup(context);
+            if (vendor != NULL && vendor != ExpectedVendor(context)) {
+                failures++;
+            }
+        }
+        pass++;
+    }
+
+    if (failures != 0) {
+        printf("Reader thread found %d wrong vendors in %d passes\n",
+                (int) failures, pass);
+    }
+    return (void *) failures;
+}
+
+static void *HookThread(void *param)
+{
+    GLXContext context = (GLXContext) param;
+
+    isHookThread = 1;
+    if (__glXContextMapLookup(context) != ExpectedVendor(context)) {
+        return (void *) 1;
+    }
+    return NULL;
+}
+
+static void ReplaceTable(void)
+{
+    pthread_mutex_lock(&writerMutex);
+    ResizeTable(contextMapTable->count);
+    pthread_mutex_unlock(&writerMutex);
+}
+
+/**
+ * Replaces the table twice while another thread is in the middle of a
+ * lookup.
+ */
+static int TestTwoResizes(void)
+{
+    pthread_t thread;
+    void *result = NULL;
+    int failed = 0;
+
+    sem_init(&hookReached, 0, 0);
+    sem_init(&hookResume, 0, 0);
+
+    if (pthread_create(&thread, NULL, HookThread, MakeContext(0)) != 0) {
+        printf("Failed to create thread\n");
+        return 0;
+    }
+
+    // Wait until the lookup has loaded the epoch, and then replace the
+    // table. That switches the epoch, and then frees the table before the
+    // lookup has a pointer to it.
+    sem_wait(&hookReached);
+    ReplaceTable();
+    sem_post(&hookResume);
+
+    // Wait until the lookup has a pointer to the new table, and then
+    // replace that one too. This has to wait for the lookup to finish
+    // before it frees the table.
+    sem_wait(&hookReached);
+    ReplaceTable();
+    if (__atomic_load_n(&hookInLookup, __ATOMIC_SEQ_CST)) {
+        printf("The table was freed while a lookup was still using it\n");
+        failed = 1;
+    }
+    __atomic_store_n(&hookWriterDone, 1, __ATOMIC_SEQ_CST);
+
+    pthread_join(thread, &result);
+    if (result != NULL) {
+        printf("The paused lookup found the wrong vendor\n");
+        failed = 1;
+    }
+
+    sem_destroy(&hookReached);
+    sem_destroy(&hookResume);
+    return !failed;
+}
+
+static int AddContext(GLXContext context)
+{
+    int ret;
+    pthread_mutex_lock(&writerMutex);
+    ret = __glXContextMapAdd(context, ExpectedVendor(context));
+    pthread_mutex_unlock(&writerMutex);
+    return ret;
+}
+
+static void RemoveContext(GLXContext context)
+{
+    pthread_mutex_lock(&writerMutex);
+    __glXContextMapRemove(context);
+    pthread_mutex_unlock(&writerMutex);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t *threads;
+    int threadCount = DEFAULT_THREAD_COUNT;
+    int iterations = DEFAULT_ITERATIONS;
+    int failed = 0;
+    int i, j;
+
+    while (1) {
+        int opt = getopt(argc, argv, "t:i:");
+        if (opt == -1) {
+            break;
+        }
+        switch (opt) {
+        case 't':
+            threadCount = atoi(optarg);
+            break;
+        case 'i':
+            iterations = atoi(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+    if (threadCount <= 0 || iterations <= 0) {
+        printf("Usage: %s [-t threads] [-i iterations]\n", argv[0]);
+        return 1;
+    }
+
+    for (i=0; i<STABLE_COUNT; i++) {
+        if (AddContext(MakeContext(i)) != 0) {
+            printf("Failed to add context %d\n", i);
+            return 1;
+        }
+    }
+
+    if (!TestTwoResizes()) {
+        return 1;
+    }
+
+    threads = malloc(threadCount * sizeof(pthread_t));
+    if (threads == NULL) {
+        return 1;
+    }
+    for (i=0; i<threadCount; i++) {
+        if (pthread_create(&threads[i], NULL, ReaderThread, NULL) != 0) {
+            printf("Failed to create thread %d\n", i);
+            return 1;
+        }
+    }
+
+    // Removed contexts leave deleted slots behind, so adding and removing
+    // the same contexts keeps filling up the table and making the map
+    // replace it.
+    for (i=0; i<iterations && !failed; i++) {
+        for (j=0; j<TRANSIENT_COUNT; j++) {
+            if (AddContext(MakeContext(STABLE_COUNT + j)) != 0) {
+                printf("Failed to add context %d\n", STABLE_COUNT + j);
+                failed = 1;
+                break;
+            }
+        }
+        for (j=0; j<TRANSIENT_COUNT; j++) {
+            RemoveContext(MakeContext(STABLE_COUNT + j));
+        }
+    }
+
+    __atomic_store_n(&writerDone, 1, __ATOMIC_RELEASE);
+    for (i=0; i<threadCount; i++) {
+        void *result = NULL;
+        pthread_join(threads[i], &result);
+        if (result != NULL) {
+            failed = 1;
+        }
+    }
+    free(threads);
+
+    for (i=0; i<STABLE_COUNT; i++) {
+        GLXContext context = MakeContext(i);
+        if (__glXContextMapLookup(context) != ExpectedVendor(context)) {
+            printf("Lost context %d\n", i);
+            failed = 1;
+        }
+    }
+    for (i=0; i<TRANSIENT_COUNT; i++) {
+        if (__glXContextMapLookup(MakeContext(STABLE_COUNT + i)) != NULL) {
+            printf("Context %d is still in the map after removing it\n",
+                    STABLE_COUNT + i);
+            failed = 1;
+        }
+    }
+
+    __glXContextMapTeardown(False);
+    return (failed ? 1 : 0);
+}
+
+#else // GLX_USE_CONTEXT_MAP
+
+static void TestHook(int point)
+{
+}
+
+int main(int argc, char **argv)
+{
+    // Without atomic intrinsics, libGLX doesn't use the context map.
+    return 77;
+}
+
+#endif // GLX_USE_CONTEXT_MAP
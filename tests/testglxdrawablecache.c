@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+#include <X11/Xlib.h>
+#include <GL/glx.h>
+#include <stdio.h>
+
+#include "dummy/GLX_dummy.h"
+
+/*
+ * This tests libGLX's cache of drawable-to-vendor mappings.
+ *
+ * Looking up the vendor for a drawable that libGLX hasn't seen takes a
+ * GLXGetDrawableAttributes request. Once libGLX knows the answer -- including
+ * when the drawable is invalid -- it shouldn't send another request for the
+ * same drawable. This counts requests using XNextRequest to check that.
+ */
+
+#define printError(...) fprintf(stderr, __VA_ARGS__)
+
+#define WINDOW_COUNT 8
+
+static int errorCount = 0;
+
+static int CountErrorHandler(Display *dpy, XErrorEvent *ev)
+{
+    errorCount++;
+    return 0;
+}
+
+static Window CreateDestroyedWindow(Display *dpy)
+{
+    Window win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+            0, 0, 10, 10, 0, 0, 0);
+    XDestroyWindow(dpy, win);
+    XSync(dpy, False);
+    return win;
+}
+
+/**
+ * Calls glXQueryDrawable and returns the number of requests that it sent.
+ */
+static unsigned long QueryDrawableRequests(Display *dpy, GLXDrawable draw)
+{
+    unsigned long start = XNextRequest(dpy);
+    unsigned int value = 0;
+
+    glXQueryDrawable(dpy, draw, GLX_WIDTH, &value);
+    return XNextRequest(dpy) - start;
+}
+
+int main(int argc, char **argv)
+{
+    PFNGLXPREFETCHDRAWABLESVENDORDUMMYPROC ptr_glXPrefetchDrawablesVendorDUMMY;
+    Display *dpy = XOpenDisplay(NULL);
+    GLXDrawable drawables[WINDOW_COUNT + 1];
+    GLXDrawable badDrawable;
+    unsigned long start;
+    int retval = 0;
+    int errors;
+    int i;
+
+    if (!dpy) {
+        printError("No display!\n");
+        return 1;
+    }
+
+    XSetErrorHandler(CountErrorHandler);
+
+    // Use a window that's already been destroyed, so that the server will
+    // reject it.
+    badDrawable = CreateDestroyedWindow(dpy);
+
+    if (QueryDrawableRequests(dpy, badDrawable) == 0) {
+        printError("Skipping test: The server does not support GLX_EXT_libglvnd.\n");
+        XCloseDisplay(dpy);
+        return 77;
+    }
+    if (errorCount != 1) {
+        printError("Expected 1 error for a bad drawable, got %d\n", errorCount);
+        return 1;
+    }
+
+    // A second lookup should use the cache, but it still needs to report an
+    // error.
+    if (QueryDrawableRequests(dpy, badDrawable) != 0) {
+        printError("Looking up a bad drawable again sent a request\n");
+        return 1;
+    }
+    if (errorCount != 2) {
+        printError("Expected 2 errors for a bad drawable, got %d\n", errorCount);
+        return 1;
+    }
+
+    // Now look up a batch of drawables at once, including one invalid one.
+    for (i=0; i<WINDOW_COUNT; i++) {
+        drawables[i] = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy),
+                0, 0, 10, 10, 0, 0, 0);
+    }
+    drawables[WINDOW_COUNT] = CreateDestroyedWindow(dpy);
+
+    // Call glXGetClientString to force libGLX to load the vendor library.
+    glXGetClientString(dpy, GLX_EXTENSIONS);
+
+    ptr_glXPrefetchDrawablesVendorDUMMY = (PFNGLXPREFETCHDRAWABLESVENDORDUMMYPROC)
+        glXGetProcAddress((const GLubyte *) "glXPrefetchDrawablesVendorDUMMY");
+    if (ptr_glXPrefetchDrawablesVendorDUMMY == NULL) {
+        printError("Can't find glXPrefetchDrawablesVendorDUMMY\n");
+        return 1;
+    }
+
+    errors = errorCount;
+    start = XNextRequest(dpy);
+    ptr_glXPrefetchDrawablesVendorDUMMY(dpy, drawables, WINDOW_COUNT + 1, &retval);
+    if (retval != WINDOW_COUNT + 1) {
+        printError("glXPrefetchDrawablesVendorDUMMY returned %d, expected %d\n",
+                retval, WINDOW_COUNT + 1);
+        return 1;
+    }
+    if (XNextRequest(dpy) == start) {
+        printError("Prefetching drawables didn't send any requests\n");
+        return 1;
+    }
+    if (errorCount != errors) {
+        printError("Prefetching drawables generated an X error\n");
+        return 1;
+    }
+
+    // Every drawable in the batch should be cached now, including the
+    // invalid one.
+    for (i=0; i<WINDOW_COUNT + 1; i++) {
+        if (QueryDrawableRequests(dpy, drawables[i]) != 0) {
+            printError("Drawable %d wasn't cached by the prefetch\n", i);
+            return 1;
+        }
+    }
+    if (errorCount != errors + 1) {
+        printError("Expected 1 error for the invalid drawable, got %d\n",
+                errorCount - errors);
+        return 1;
+    }
+
+    for (i=0; i<WINDOW_COUNT; i++) {
+        XDestroyWindow(dpy, drawables[i]);
+    }
+    XCloseDisplay(dpy);
+    return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+. $TOP_SRCDIR/tests/glxenv.sh
+
+./testglxdrawablecache
@@ -2,5 +2,9 @@
 
 . $TOP_SRCDIR/tests/glxenv.sh
 
+set -e
+
 # Run the make current test exactly once.
 ./testglxmakecurrent -t 1 -i 1
+
+GLVND_TEST_GET_PROC_ADDRESSES=1 ./testglxmakecurrent -t 1 -i 1
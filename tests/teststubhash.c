@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and/or associated documentation files (the
+ * "Materials"), to deal in the Materials without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Materials, and to
+ * permit persons to whom the Materials are furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * unaltered in all copies or substantial portions of the Materials.
+ * Any additions, deletions, or changes to the original source files
+ * must be clearly indicated in accompanying documentation.
+ *
+ * THE MATERIALS ARE PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * MATERIALS OR THE USE OR OTHER DEALINGS IN THE MATERIALS.
+ */
+
+/**
+ * \file
+ *
+ * Checks the perfect hash lookup for the public stub names against the
+ * binary search that it replaced.
+ *
+ * With the -b option, this also measures how long each lookup takes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stub.h"
+
+#define DEFAULT_ITERATION_COUNT 200
+
+typedef int (* FindPublicFunc) (const char *name);
+
+static const char *MISSING_NAMES[] = {
+    "",
+    "g",
+    "gl",
+    "glBegi",
+    "glBeginX",
+    "glbegin",
+    "glNotAnEntrypoint",
+    "glXGetProcAddress",
+    "eglGetProcAddress",
+};
+
+static double GetTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static int CheckNames(int count)
+{
+    int i;
+
+    for (i=0; i<count; i++) {
+        const char *name = stub_get_name(i);
+        int index = stub_find_public(name);
+
+        if (index != i) {
+            printf("Lookup for %s returned %d, expected %d\n", name, index, i);
+            return 0;
+        }
+        if (stub_find_public_sorted(name) != i) {
+            printf("Sorted lookup for %s failed\n", name);
+            return 0;
+        }
+
+        // Names without the "gl" prefix are still supposed to work.
+        index = stub_find_public(name + 2);
+        if (index != i) {
+            printf("Lookup for %s returned %d, expected %d\n", name + 2, index, i);
+            return 0;
+        }
+    }
+
+    for (i=0; i<(int) (sizeof(MISSING_NAMES) / sizeof(MISSING_NAMES[0])); i++) {
+        const char *name = MISSING_NAMES[i];
+        if (stub_find_public(name) != stub_find_public_sorted(name)) {
+            printf("Mismatched lookups for \"%s\"\n", name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static double TimeLookups(FindPublicFunc func, const char **names, int count,
+        int iterations)
+{
+    double start;
+    int sum = 0;
+    int i, j;
+
+    start = GetTime();
+    for (i=0; i<iterations; i++) {
+        for (j=0; j<count; j++) {
+            sum += func(names[j]);
+        }
+    }
+    if (sum == -1) {
+        // Just make sure the compiler can't skip the calls.
+        printf("\n");
+    }
+    return (GetTime() - start) * 1000000000.0 / ((double) iterations * count);
+}
+
+static int RunBenchmark(int count, int iterations)
+{
+    const char **names;
+    int i;
+
+    // Look up the names in a shuffled order, so that the binary search doesn't
+    // get any help from the branch predictor.
+    names = malloc(count * sizeof(const char *));
+    if (names == NULL) {
+        return 0;
+    }
+    for (i=0; i<count; i++) {
+        names[i] = stub_get_name(i);
+    }
+    srand(1);
+    for (i=count - 1; i>0; i--) {
+        int j = rand() % (i + 1);
+        const char *tmp = names[i];
+        names[i] = names[j];
+        names[j] = tmp;
+    }
+
+    printf("%d names, %d iterations\n", count, iterations);
+    printf("%-12s %8.1f ns/lookup\n", "bsearch",
+            TimeLookups(stub_find_public_sorted, names, count, iterations));
+    printf("%-12s %8.1f ns/lookup\n", "hash",
+            TimeLookups(stub_find_public, names, count, iterations));
+
+    free(names);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int count = stub_get_count();
+
+    if (count <= 0) {
+        printf("No public stubs\n");
+        return 1;
+    }
+    if (!CheckNames(count)) {
+        return 1;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        int iterations = DEFAULT_ITERATION_COUNT;
+        if (argc > 2) {
+            iterations = atoi(argv[2]);
+            if (iterations <= 0) {
+                printf("Usage: %s [-b [iterations]]\n", argv[0]);
+                return 1;
+            }
+        }
+        if (!RunBenchmark(count, iterations)) {
+            return 1;
+        }
+    }
+    return 0;
+}